@@ -0,0 +1,51 @@
+// Bulk compilation throughput: tsexpr::compile in a loop vs compile_many.
+//
+//   tsexpr_bench_compile [expressions]
+
+#include <tsexpr/parser.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200'000;
+
+    // A catalog of mixed-shape statements over a few hundred instruments.
+    std::vector<std::string> src;
+    src.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::string inst = "`inst " + std::to_string(i % 500) + "`";
+        switch (i % 4) {
+            case 0: src.push_back("r" + std::to_string(i) + " = " + inst + " * 2 + carry / 3"); break;
+            case 1: src.push_back("r" + std::to_string(i) + " = sumproduct(" + inst + ", weights) - fees"); break;
+            case 2: src.push_back("r" + std::to_string(i) + " = -(" + inst + " - benchmark) / (vol + 1e-9)"); break;
+            default: src.push_back("r" + std::to_string(i) + " = (" + inst + " + carry) * (" + inst + " - carry)"); break;
+        }
+    }
+    const std::vector<std::string_view> views(src.begin(), src.end());
+
+    using clock = std::chrono::steady_clock;
+    // Baseline: what start-up does today, keeping every program.
+    auto t0 = clock::now();
+    std::vector<tsexpr::Program> loop;
+    loop.reserve(n);
+    for (auto v : views) loop.push_back(tsexpr::compile(v));
+    const double serial = std::chrono::duration<double>(clock::now() - t0).count();
+    std::size_t instrs = 0;
+    for (const auto& p : loop) instrs += p.code.size();
+    loop = {};
+
+    t0 = clock::now();
+    const tsexpr::CompiledCatalog cat = tsexpr::compile_many(views);
+    const double bulk = std::chrono::duration<double>(clock::now() - t0).count();
+
+    std::printf("expressions      %zu (%zu instructions, %zu distinct names)\n", n, instrs,
+                cat.names->names.size());
+    std::printf("compile loop     %.0f expr/s\n", double(n) / serial);
+    std::printf("compile_many     %.0f expr/s (%.2fx, %zu threads + caller)\n", double(n) / bulk, serial / bulk,
+                tsexpr::default_thread_pool().size());
+    return cat.failed() == 0 ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+// Compression ratio and streaming decode throughput of CompressedSeries.
+//
+//   tsexpr_bench_compressed [rows]
+
+#include <tsexpr/compressed_series.hpp>
+
+#include "tick_data.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using ts::expr::CompressedSeries;
+using ts::expr::TimeSeries;
+using tsexpr::bench::make_ticks;
+
+int main(int argc, char** argv) {
+    const std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+    TimeSeries raw = make_ticks(rows, 42);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    CompressedSeries c = CompressedSeries::encode(raw);
+    const auto t1 = std::chrono::steady_clock::now();
+    const double enc_s = std::chrono::duration<double>(t1 - t0).count();
+
+    std::printf("rows               %zu\n", c.size());
+    std::printf("raw bytes          %zu\n", c.raw_bytes());
+    std::printf("compressed bytes   %zu\n", c.compressed_bytes());
+    std::printf("compression ratio  %.2fx\n", c.compression_ratio());
+    std::printf("encode             %.1f Mrows/s\n", double(rows) / enc_s / 1e6);
+
+    auto st = c.measure_decode();
+    std::printf("decode             %.1f Mrows/s (%.0f MB/s raw)\n",
+                st.rows_per_second() / 1e6, st.raw_bytes_per_second(c.has_index()) / 1e6);
+
+    const auto t2 = std::chrono::steady_clock::now();
+    double s = ts::expr::sumproduct(c, c);
+    const auto t3 = std::chrono::steady_clock::now();
+    std::printf("sumproduct         %.1f Mrows/s (result %.6g)\n",
+                double(rows) / std::chrono::duration<double>(t3 - t2).count() / 1e6, s);
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Thread scaling of the stub's elementwise operators and sumproduct.
+//
+//   tsexpr_bench_parallel [rows] [max_threads]
+//
+// Runs each kernel with the default pool resized to 1..max_threads workers
+// (doubling) and prints throughput and speedup over one thread.
+
+#include <tsexpr/thread_pool.hpp>
+#include <tsexpr/timeseries_stub.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using ts::expr::TimeSeries;
+
+template <class F>
+static double best_seconds(F&& f, int reps = 5) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    const std::size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50'000'000;
+    const std::size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                             : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<double> x(rows), y(rows);
+    for (std::size_t i = 0; i < rows; ++i) { x[i] = double(i % 1000) * 0.001; y[i] = 1.0 + double(i % 7); }
+    TimeSeries a{std::move(x)}, b{std::move(y)};
+
+    std::printf("%-8s %14s %10s %14s %10s\n", "threads", "add Mrows/s", "speedup", "sumprod Mrows/s", "speedup");
+    double add1 = 0, sp1 = 0;
+    for (std::size_t t = 1; t <= max_threads; t = (t == max_threads ? t + 1 : std::min(max_threads, t * 2))) {
+        // The pool's workers plus the calling thread share the work.
+        tsexpr::set_default_thread_count(t > 1 ? t - 1 : 1);
+        ts::expr::set_parallel_policy({t > 1 ? ts::expr::ParallelPolicy{}.min_rows : rows + 1,
+                                       ts::expr::ParallelPolicy{}.grain});
+        volatile double sink = 0;
+        const double add_s = best_seconds([&] { TimeSeries c = a + b; sink = c[rows / 2]; });
+        const double sp_s = best_seconds([&] { sink = ts::expr::sumproduct(a, b); });
+        (void)sink;
+        const double add_r = double(rows) / add_s / 1e6;
+        const double sp_r = double(rows) / sp_s / 1e6;
+        if (t == 1) { add1 = add_r; sp1 = sp_r; }
+        std::printf("%-8zu %14.1f %9.2fx %14.1f %9.2fx\n", t, add_r, add_r / add1, sp_r, sp_r / sp1);
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Per-tick latency of one formula: Program::execute over length-1 series vs
+// a RowKernel over scalar slots.
+//
+//   tsexpr_bench_row_kernel [ticks]
+//
+// Every tick updates the inputs, evaluates once and is timed on its own;
+// prints p50/p99/p999 and the cost of the clock reads themselves.
+
+#include <tsexpr/parser.hpp>
+#include <tsexpr/row_kernel.hpp>
+#include <tsexpr/timeseries_stub.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+using ts::expr::TimeSeries;
+
+// Backend over length-1 series: what evaluating one row costs today.
+struct SeriesBackend {
+    std::map<std::string, TimeSeries, std::less<>> vars;
+
+    TimeSeries load_var(std::string_view name) const { return vars.find(name)->second; }
+    void store_var(std::string_view name, TimeSeries v) { vars.insert_or_assign(std::string(name), std::move(v)); }
+    TimeSeries make_number(double x) const { return TimeSeries::from_scalar(x); }
+    TimeSeries neg(const TimeSeries& a) const { return -a; }
+    TimeSeries binary(tsexpr::Op op, const TimeSeries& a, const TimeSeries& b) const {
+        switch (op) {
+            case tsexpr::Op::Add: return a + b;
+            case tsexpr::Op::Sub: return a - b;
+            case tsexpr::Op::Mul: return a * b;
+            default: return a / b;
+        }
+    }
+    TimeSeries call(std::string_view, const std::vector<TimeSeries>& args) const { return args.at(0); }
+};
+
+template <class F>
+static void report(const char* name, std::size_t ticks, double overhead_ns, F&& tick) {
+    std::vector<double> ns(ticks);
+    for (std::size_t i = 0; i < ticks; ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        tick(i);
+        const auto t1 = std::chrono::steady_clock::now();
+        ns[i] = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    }
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[std::min(ticks - 1, std::size_t(q * double(ticks)))]; };
+    std::printf("%-16s %10.1f %10.1f %10.1f   (clock read %.1f ns included)\n", name, at(0.5), at(0.99), at(0.999),
+                overhead_ns);
+}
+
+int main(int argc, char** argv) {
+    const std::size_t ticks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    const char* stmt = "signal = (bid + ask) / 2 - fair * (1 + skew) + (ask - bid) * 0.25 / vol";
+    const tsexpr::Program program = tsexpr::compile(stmt);
+    const tsexpr::RowKernel kernel(program);
+
+    auto row = [](std::size_t i, std::size_t k) { return 100.0 + double((i * 7 + k * 13) % 97) * 0.01; };
+
+    // Median cost of two back-to-back clock reads, to read the others against.
+    std::vector<double> empty(10'000);
+    for (auto& e : empty) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const auto t1 = std::chrono::steady_clock::now();
+        e = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    }
+    std::nth_element(empty.begin(), empty.begin() + empty.size() / 2, empty.end());
+    const double overhead = empty[empty.size() / 2];
+
+    std::printf("%s\n%zu ticks\n%-16s %10s %10s %10s\n", stmt, ticks, "ns per tick", "p50", "p99", "p999");
+
+    SeriesBackend be;
+    volatile double sink = 0;
+    report("Program::execute", ticks, overhead, [&](std::size_t i) {
+        for (std::size_t k = 0; k < kernel.inputs().size(); ++k)
+            be.store_var(kernel.inputs()[k], TimeSeries::from_scalar(row(i, k)));
+        program.execute(be);
+        sink = be.vars.find(kernel.target())->second[0];
+    });
+
+    std::vector<double> slots(kernel.inputs().size());
+    report("RowKernel", ticks, overhead, [&](std::size_t i) {
+        for (std::size_t k = 0; k < slots.size(); ++k) slots[k] = row(i, k);
+        sink = kernel(slots.data());
+    });
+    (void)sink;
+    return 0;
+}
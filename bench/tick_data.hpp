@@ -0,0 +1,31 @@
+#pragma once
+// Synthetic tick data shared by the compression benchmark and tests.
+
+#include <tsexpr/timeseries_stub.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace tsexpr::bench {
+
+// Tick-like data: mostly regular 1s timestamps with jitter, random-walk prices
+// on a 0.01 grid (repeats are common, which XOR encoding exploits).
+inline ts::expr::TimeSeries make_ticks(std::size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    ts::expr::TimeIndex t(n);
+    std::vector<double> v(n);
+    std::int64_t now = 1'700'000'000'000'000'000;
+    double px = 100.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        now += 1'000'000'000 + (rng() % 4 == 0 ? std::int64_t(rng() % 5000) : 0);
+        if (rng() % 3 == 0) px += (int(rng() % 3) - 1) * 0.01;
+        t[i] = now;
+        v[i] = std::round(px * 100.0) / 100.0;
+    }
+    return ts::expr::TimeSeries{std::move(t), std::move(v)};
+}
+
+} // namespace tsexpr::bench
@@ -1,38 +1,81 @@
+#include <tsexpr/ewm.hpp>
 #include <tsexpr/parser.hpp>
+#include <tsexpr/reduce.hpp>
+#include <tsexpr/rolling.hpp>
 
+#include <cmath>
 #include <iostream>
 #include <map>
 #include <numeric>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
 namespace toy {
 
-// Toy "time series": vector of doubles.
-struct Series { std::vector<double> v; };
+// Toy "time series": vector of doubles (or floats, for single-precision inputs).
+template <class T> struct BasicSeries { std::vector<T> v; };
+using Series   = BasicSeries<double>;
+using Series32 = BasicSeries<float>;
 
-// Values are either series or scalar.
-using Value = std::variant<Series, double>;
+// Values are either series (of either width) or scalar.
+// Mixed precision: f32 op f32 stays f32, anything with f64 promotes to f64,
+// scalars adopt the series' width, and reductions accumulate in double.
+using Value = std::variant<Series, Series32, double>;
 
-static Series elementwise(const Series& a, const Series& b, double (*op)(double,double)) {
+template <class A, class B, class F>
+static auto elementwise(const BasicSeries<A>& a, const BasicSeries<B>& b, F op) {
+    using R = decltype(A{} + B{});
     if (a.v.size() != b.v.size()) throw std::runtime_error("Series length mismatch");
-    Series out; out.v.resize(a.v.size());
-    for (std::size_t i = 0; i < a.v.size(); ++i) out.v[i] = op(a.v[i], b.v[i]);
+    BasicSeries<R> out; out.v.resize(a.v.size());
+    for (std::size_t i = 0; i < a.v.size(); ++i) out.v[i] = op(R(a.v[i]), R(b.v[i]));
     return out;
 }
 
-static Series elementwise_scalar(const Series& a, double s, double (*op)(double,double)) {
-    Series out; out.v.resize(a.v.size());
-    for (std::size_t i = 0; i < a.v.size(); ++i) out.v[i] = op(a.v[i], s);
+template <class A, class F>
+static BasicSeries<A> elementwise_scalar(const BasicSeries<A>& a, double s, F op) {
+    BasicSeries<A> out; out.v.resize(a.v.size());
+    const A k = static_cast<A>(s);
+    for (std::size_t i = 0; i < a.v.size(); ++i) out.v[i] = op(a.v[i], k);
     return out;
 }
 
-static double sumproduct_series(const Series& a, const Series& b) {
+template <class A, class F>
+static BasicSeries<A> scalar_elementwise(double s, const BasicSeries<A>& b, F op) {
+    BasicSeries<A> out; out.v.resize(b.v.size());
+    const A k = static_cast<A>(s);
+    for (std::size_t i = 0; i < b.v.size(); ++i) out.v[i] = op(k, b.v[i]);
+    return out;
+}
+
+template <class F>
+static Value apply(const Value& a, const Value& b, F op) {
+    return std::visit([&](const auto& x, const auto& y) -> Value {
+        using X = std::decay_t<decltype(x)>;
+        using Y = std::decay_t<decltype(y)>;
+        if constexpr (std::is_same_v<X, double> && std::is_same_v<Y, double>) return op(x, y);
+        else if constexpr (std::is_same_v<Y, double>) return elementwise_scalar(x, y, op);
+        else if constexpr (std::is_same_v<X, double>) return scalar_elementwise(x, y, op);
+        else return elementwise(x, y, op);
+    }, a, b);
+}
+
+template <class A, class B>
+static double sumproduct_series(const BasicSeries<A>& a, const BasicSeries<B>& b) {
     if (a.v.size() != b.v.size()) throw std::runtime_error("Series length mismatch");
-    double acc = 0.0;
-    for (std::size_t i = 0; i < a.v.size(); ++i) acc += a.v[i] * b.v[i];
-    return acc;
+    return tsexpr::deterministic_sum(a.v.size(), [&](std::size_t i, std::size_t e) {
+        double acc = 0.0;
+        for (; i < e; ++i) acc += double(a.v[i]) * double(b.v[i]);
+        return acc;
+    });
+}
+
+template <class A>
+static double sum_series(const BasicSeries<A>& a) {
+    return tsexpr::deterministic_sum(a.v.size(), [&](std::size_t i, std::size_t e) {
+        return std::accumulate(a.v.begin() + i, a.v.begin() + e, 0.0);
+    });
 }
 
 // Backend required by Program::execute
@@ -45,76 +88,94 @@ struct Backend {
         return it->second;
     }
 
-    void store_var(std::string_view name, const Value& v) {
-        vars[std::string(name)] = v;
+    void store_var(std::string_view name, Value v) {
+        vars[std::string(name)] = std::move(v);
     }
 
     Value make_number(double x) const { return x; }
 
     Value neg(const Value& a) const {
-        if (std::holds_alternative<double>(a)) return -std::get<double>(a);
-        const auto& s = std::get<Series>(a);
-        Series out; out.v.resize(s.v.size());
-        for (std::size_t i = 0; i < s.v.size(); ++i) out.v[i] = -s.v[i];
-        return out;
+        return std::visit([](const auto& x) -> Value {
+            using X = std::decay_t<decltype(x)>;
+            if constexpr (std::is_same_v<X, double>) return -x;
+            else {
+                X out; out.v.resize(x.v.size());
+                for (std::size_t i = 0; i < x.v.size(); ++i) out.v[i] = -x.v[i];
+                return out;
+            }
+        }, a);
     }
 
     Value binary(tsexpr::Op op, const Value& a, const Value& b) const {
-        auto add = [](double x,double y){ return x+y; };
-        auto sub = [](double x,double y){ return x-y; };
-        auto mul = [](double x,double y){ return x*y; };
-        auto div = [](double x,double y){ return x/y; };
-
-        auto pick = [&](tsexpr::Op o)->double(*)(double,double){
-            switch (o) {
-                case tsexpr::Op::Add: return add;
-                case tsexpr::Op::Sub: return sub;
-                case tsexpr::Op::Mul: return mul;
-                case tsexpr::Op::Div: return div;
-                default: throw std::runtime_error("Unsupported binary op");
-            }
-        };
-        auto f = pick(op);
-
-        const bool aS = std::holds_alternative<Series>(a);
-        const bool bS = std::holds_alternative<Series>(b);
-
-        if (!aS && !bS) return f(std::get<double>(a), std::get<double>(b));
-        if (aS && bS)   return elementwise(std::get<Series>(a), std::get<Series>(b), f);
-        if (aS && !bS)  return elementwise_scalar(std::get<Series>(a), std::get<double>(b), f);
-
-        // scalar op series
-        double s = std::get<double>(a);
-        const auto& x = std::get<Series>(b);
-        Series out; out.v.resize(x.v.size());
-        for (std::size_t i = 0; i < x.v.size(); ++i) out.v[i] = f(s, x.v[i]);
-        return out;
+        switch (op) {
+            case tsexpr::Op::Add: return apply(a, b, [](auto x, auto y){ return x + y; });
+            case tsexpr::Op::Sub: return apply(a, b, [](auto x, auto y){ return x - y; });
+            case tsexpr::Op::Mul: return apply(a, b, [](auto x, auto y){ return x * y; });
+            case tsexpr::Op::Div: return apply(a, b, [](auto x, auto y){ return x / y; });
+            default: throw std::runtime_error("Unsupported binary op");
+        }
     }
 
     Value call(std::string_view fn, const std::vector<Value>& args) const {
         if (fn == "sumproduct") {
             if (args.size() != 2) throw std::runtime_error("sumproduct expects 2 args");
-            const auto& a = args[0];
-            const auto& b = args[1];
-
-            const bool aS = std::holds_alternative<Series>(a);
-            const bool bS = std::holds_alternative<Series>(b);
-
-            if (aS && bS) return sumproduct_series(std::get<Series>(a), std::get<Series>(b));
+            return std::visit([](const auto& x, const auto& y) -> Value {
+                using X = std::decay_t<decltype(x)>;
+                using Y = std::decay_t<decltype(y)>;
+                if constexpr (std::is_same_v<X, double> && std::is_same_v<Y, double>) return x * y;
+                else if constexpr (std::is_same_v<Y, double>) return y * sum_series(x);
+                else if constexpr (std::is_same_v<X, double>) return x * sum_series(y);
+                else return sumproduct_series(x, y);
+            }, args[0], args[1]);
+        }
 
-            if (aS && !bS) {
-                const auto& s = std::get<Series>(a);
-                double k = std::get<double>(b);
-                return k * std::accumulate(s.v.begin(), s.v.end(), 0.0);
-            }
+        // Trailing windows: rolling_mean(x, 20) etc. The toy series has no
+        // nulls, so rows without a defined value are NaN.
+        if (const auto kind = tsexpr::rolling_kind(fn)) {
+            if (args.size() != 2) throw std::runtime_error(std::string(fn) + " expects 2 args");
+            const double* w = std::get_if<double>(&args[1]);
+            if (!w || *w < 1) throw std::runtime_error(std::string(fn) + " expects a window of at least 1");
+            return std::visit([&](const auto& x) -> Value {
+                using X = std::decay_t<decltype(x)>;
+                if constexpr (std::is_same_v<X, double>) {
+                    throw std::runtime_error(std::string(fn) + " expects a series");
+                } else {
+                    tsexpr::RollingWindow win(*kind, static_cast<std::size_t>(*w));
+                    Series out; out.v.reserve(x.v.size());
+                    for (auto e : x.v) out.v.push_back(win.push(double(e)).value_or(NAN));
+                    return out;
+                }
+            }, args[0]);
+        }
 
-            if (!aS && bS) {
-                double k = std::get<double>(a);
-                const auto& s = std::get<Series>(b);
-                return k * std::accumulate(s.v.begin(), s.v.end(), 0.0);
-            }
+        // Recursive filters: ewma(x, halflife), ewvar(x, halflife), filter(x, alpha).
+        if (const auto kind = tsexpr::ewm_kind(fn)) {
+            if (args.size() != 2) throw std::runtime_error(std::string(fn) + " expects 2 args");
+            const double* p = std::get_if<double>(&args[1]);
+            if (!p) throw std::runtime_error(std::string(fn) + " expects a scalar parameter");
+            tsexpr::EwmFilter f(*kind, *p);
+            return std::visit([&](const auto& x) -> Value {
+                using X = std::decay_t<decltype(x)>;
+                if constexpr (std::is_same_v<X, double>) {
+                    throw std::runtime_error(std::string(fn) + " expects a series");
+                } else {
+                    Series out; out.v.resize(x.v.size());
+                    f.run(x.v.data(), x.v.size(), out.v.data());
+                    return out;
+                }
+            }, args[0]);
+        }
 
-            return std::get<double>(a) * std::get<double>(b);
+        // Storage casts: choose the element type a variable is stored with.
+        if (fn == "float32" || fn == "float64") {
+            if (args.size() != 1) throw std::runtime_error(std::string(fn) + " expects 1 arg");
+            const bool to32 = fn == "float32";
+            return std::visit([to32](const auto& x) -> Value {
+                using X = std::decay_t<decltype(x)>;
+                if constexpr (std::is_same_v<X, double>) return x;
+                else if (to32) return Series32{{x.v.begin(), x.v.end()}};
+                else return Series{{x.v.begin(), x.v.end()}};
+            }, args[0]);
         }
 
         throw std::runtime_error("Unknown function: " + std::string(fn));
@@ -124,17 +185,19 @@ struct Backend {
 } // namespace toy
 
 static void print_value(const toy::Value& v) {
-    if (std::holds_alternative<double>(v)) {
-        std::cout << std::get<double>(v) << "\n";
-        return;
-    }
-    const auto& s = std::get<toy::Series>(v).v;
-    std::cout << "[";
-    for (std::size_t i = 0; i < s.size(); ++i) {
-        if (i) std::cout << ", ";
-        std::cout << s[i];
-    }
-    std::cout << "]\n";
+    std::visit([](const auto& x) {
+        using X = std::decay_t<decltype(x)>;
+        if constexpr (std::is_same_v<X, double>) {
+            std::cout << x << "\n";
+        } else {
+            std::cout << (std::is_same_v<X, toy::Series32> ? "f32[" : "[");
+            for (std::size_t i = 0; i < x.v.size(); ++i) {
+                if (i) std::cout << ", ";
+                std::cout << x.v[i];
+            }
+            std::cout << "]\n";
+        }
+    }, v);
 }
 
 int main() {
@@ -164,5 +227,23 @@ int main() {
     std::cout << "y = ";
     print_value(backend.vars["y"]); // 26
 
+    // 4) single-precision input: f32 op f32 stays f32, reductions use double
+    backend.vars["p"] = toy::Series32{{1.5f, 2.5f, 3.5f}};
+    auto p4 = tsexpr::compile("q = p * 2 + float32(a)");
+    p4.execute(backend);
+    std::cout << "q = ";
+    print_value(backend.vars["q"]); // f32[4, 7, 10]
+
+    // 5) trailing window through the same function-call path
+    auto p5 = tsexpr::compile("m = rolling_mean(b, 2)");
+    p5.execute(backend);
+    std::cout << "m = ";
+    print_value(backend.vars["m"]); // [nan, 15, 25]
+
+    auto p6 = tsexpr::compile("e = ewma(b, 1)");
+    p6.execute(backend);
+    std::cout << "e = ";
+    print_value(backend.vars["e"]); // [10, 15, 22.5]
+
     return 0;
 }
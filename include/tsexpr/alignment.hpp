@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace ts::expr {
+
+/// Timestamps in nanoseconds, strictly increasing. Shared so series derived
+/// from one another can point at the same index buffer, and never changed
+/// except by TimeSeries::append growing a buffer no other series holds.
+using TimeIndex    = std::vector<std::int64_t>;
+using TimeIndexPtr = std::shared_ptr<const TimeIndex>;
+
+enum class JoinKind {
+    Inner, // timestamps present in both inputs
+    Outer, // union of timestamps; the missing side has no row
+    AsOf,  // left timestamps; right row is the last one at or before
+};
+
+/// Result of joining two indices: for every output row, the row to read
+/// from each input (or npos when that input has no matching row).
+struct AlignmentPlan {
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    TimeIndexPtr index;             // output timestamps
+    std::vector<std::size_t> left;  // empty when left_identity
+    std::vector<std::size_t> right; // empty when right_identity
+    bool left_identity{false};      // output row i == left row i
+    bool right_identity{false};     // output row i == right row i
+
+    std::size_t size() const noexcept { return index ? index->size() : 0; }
+};
+
+using AlignmentPlanPtr = std::shared_ptr<const AlignmentPlan>;
+
+/// Build a plan with a galloping-search merge join (no caching).
+AlignmentPlanPtr build_alignment(const TimeIndexPtr& a, const TimeIndexPtr& b, JoinKind kind);
+
+/// Bounded LRU cache of alignment plans keyed by the pair of index buffers.
+/// Repeated operations over the same pair of inputs reuse the plan and skip
+/// the join. Entries hold weak references so a freed index buffer whose
+/// address is reused is never mistaken for the original, and are keyed by
+/// the buffers' lengths too, since appends grow a buffer in place.
+/// Thread-safe.
+class AlignmentCache {
+public:
+    struct Stats {
+        std::size_t hits{0};
+        std::size_t misses{0};
+        std::size_t evictions{0};
+    };
+
+    explicit AlignmentCache(std::size_t capacity = 256) : capacity_(capacity) {}
+
+    AlignmentPlanPtr get(const TimeIndexPtr& a, const TimeIndexPtr& b, JoinKind kind);
+
+    Stats stats() const;
+    void clear();
+
+private:
+    using Key = std::tuple<const TimeIndex*, std::size_t, const TimeIndex*, std::size_t, JoinKind>;
+    struct Entry {
+        std::weak_ptr<const TimeIndex> a;
+        std::weak_ptr<const TimeIndex> b;
+        AlignmentPlanPtr plan;
+        std::list<Key>::iterator lru;
+    };
+
+    mutable std::mutex mu_;
+    std::size_t capacity_;
+    std::map<Key, Entry> entries_;
+    std::list<Key> lru_; // front = most recently used
+    Stats stats_{};
+};
+
+/// Process-wide cache used by the TimeSeries operators.
+AlignmentCache& alignment_cache();
+
+} // namespace ts::expr
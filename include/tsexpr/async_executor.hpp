@@ -0,0 +1,231 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+#include "tsexpr/thread_pool.hpp"
+
+namespace tsexpr {
+
+// One-shot result callback for an asynchronous backend call. Exactly one of
+// operator() or fail() must be called, from any thread.
+template <class Value>
+struct Completion {
+    std::function<void(Value)> on_value;
+    std::function<void(std::exception_ptr)> on_error;
+
+    void operator()(Value v) const { on_value(std::move(v)); }
+    void fail(std::exception_ptr e) const { on_error(std::move(e)); }
+};
+
+namespace detail {
+
+// backend.call_async(fn, args, Completion<Value>): continuation style.
+template <class B, class V, class = void>
+struct has_call_async_cb : std::false_type {};
+template <class B, class V>
+struct has_call_async_cb<B, V, std::void_t<decltype(std::declval<B&>().call_async(
+    std::string_view{}, std::declval<std::vector<V>>(), std::declval<Completion<V>>()))>> : std::true_type {};
+
+// backend.call_async(fn, args) -> future-like (get() and wait_for()).
+template <class B, class V, class = void>
+struct has_call_async_future : std::false_type {};
+template <class B, class V>
+struct has_call_async_future<B, V, std::void_t<decltype(std::declval<B&>().call_async(
+    std::string_view{}, std::declval<std::vector<V>>()).wait_for(std::chrono::seconds(0)))>> : std::true_type {};
+
+// Single thread that watches pending futures and fires their callbacks once
+// ready, so waiting on N futures costs one thread rather than N.
+class FutureWatcher {
+public:
+    // poll() returns true once it has handled its future.
+    void watch(std::function<bool()> poll) {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            if (!thread_.joinable()) thread_ = std::thread([this] { loop(); });
+            polls_.push_back(std::move(poll));
+        }
+        cv_.notify_one();
+    }
+
+    ~FutureWatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) thread_.join();
+    }
+
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (!stop_) {
+            if (polls_.empty()) {
+                cv_.wait(lock, [&] { return stop_ || !polls_.empty(); });
+                continue;
+            }
+            std::vector<std::function<bool()>> batch;
+            batch.swap(polls_);
+            lock.unlock();
+            std::vector<std::function<bool()>> still;
+            for (auto& p : batch)
+                if (!p()) still.push_back(std::move(p));
+            lock.lock();
+            for (auto& p : still) polls_.push_back(std::move(p));
+            if (!still.empty() && !stop_) cv_.wait_for(lock, std::chrono::microseconds(100));
+        }
+    }
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<std::function<bool()>> polls_;
+    bool stop_{false};
+    std::thread thread_;
+};
+
+} // namespace detail
+
+// Keeps many Programs in flight on a few pool threads when the backend's
+// function calls are asynchronous.
+//
+// A backend opts in per call by providing either
+//     void call_async(std::string_view fn, std::vector<Value> args, Completion<Value> done);
+// or  Future call_async(std::string_view fn, std::vector<Value> args);  // std::future-like
+// Without either, calls run synchronously as in Program::execute. When a
+// program reaches an asynchronous call it is parked and its thread returns
+// to the pool; the completion re-queues it. Futures are watched by one
+// helper thread.
+//
+// Programs run concurrently, so the backend must accept concurrent calls
+// (see SynchronizedBackend for loads and stores). Fork/Join points run
+// inline. Programs must outlive their execution.
+template <class Backend>
+class AsyncExecutor {
+public:
+    using Value = decltype(std::declval<Backend&>().load_var(std::string_view{}));
+
+    explicit AsyncExecutor(Backend& backend, ThreadPool& pool = default_thread_pool())
+        : backend_(backend), pool_(pool) {}
+    ~AsyncExecutor() { wait_all(); }
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    // Start `program`; the future becomes ready when it has stored its
+    // result, or holds the exception that stopped it.
+    std::future<void> submit(const Program& program) {
+        auto f = std::make_shared<Flight>();
+        f->program = &program;
+        std::future<void> done = f->done.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            ++in_flight_;
+        }
+        pool_.submit([this, f] { run(f); });
+        return done;
+    }
+
+    // Block until every submitted program has finished.
+    void wait_all() {
+        std::unique_lock<std::mutex> lock(mu_);
+        idle_.wait(lock, [&] { return in_flight_ == 0; });
+    }
+
+    std::size_t in_flight() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return in_flight_;
+    }
+
+private:
+    struct Flight {
+        const Program* program{nullptr};
+        std::size_t pc{0};
+        ExecutionContext<Value> ctx;
+        std::promise<void> done;
+    };
+    using FlightPtr = std::shared_ptr<Flight>;
+
+    static constexpr bool async_cb = detail::has_call_async_cb<Backend, Value>::value;
+    static constexpr bool async_future = detail::has_call_async_future<Backend, Value>::value;
+
+    void finish(const FlightPtr& f, std::exception_ptr err) {
+        if (err) f->done.set_exception(err);
+        else f->done.set_value();
+        std::lock_guard<std::mutex> lock(mu_);
+        if (--in_flight_ == 0) idle_.notify_all();
+    }
+
+    void resume_with(const FlightPtr& f, Value v) {
+        f->ctx.stack.push_back(std::move(v));
+        pool_.submit([this, f] { run(f); });
+    }
+
+    // Step `f` until it finishes or parks on an asynchronous call.
+    void run(const FlightPtr& f) {
+        const auto& code = f->program->code;
+        try {
+            while (f->pc < code.size()) {
+                const Instr& ins = code[f->pc++];
+                if (ins.op == Op::Fork || ins.op == Op::Join) continue; // inline, see class comment
+                if constexpr (async_cb || async_future) {
+                    if (ins.op == Op::Call) {
+                        call_async(f, ins);
+                        return;
+                    }
+                }
+                Program::step(ins, backend_, f->ctx);
+            }
+        } catch (...) {
+            finish(f, std::current_exception());
+            return;
+        }
+        finish(f, nullptr);
+    }
+
+    void call_async(const FlightPtr& f, const Instr& ins) {
+        auto& st = f->ctx.stack;
+        if (ins.argc < 0 || static_cast<std::size_t>(ins.argc) > st.size())
+            throw EvalError("Not enough args for CALL");
+        std::vector<Value> args(std::make_move_iterator(st.end() - ins.argc), std::make_move_iterator(st.end()));
+        st.resize(st.size() - static_cast<std::size_t>(ins.argc));
+
+        if constexpr (async_cb) {
+            Completion<Value> done{[this, f](Value v) { resume_with(f, std::move(v)); },
+                                   [this, f](std::exception_ptr e) { finish(f, std::move(e)); }};
+            backend_.call_async(ins.text, std::move(args), std::move(done));
+        } else {
+            using Future = decltype(backend_.call_async(ins.text, std::move(args)));
+            auto fut = std::make_shared<Future>(backend_.call_async(ins.text, std::move(args)));
+            watcher_.watch([this, f, fut] {
+                if (fut->wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+                try {
+                    resume_with(f, fut->get());
+                } catch (...) {
+                    finish(f, std::current_exception());
+                }
+                return true;
+            });
+        }
+    }
+
+    Backend& backend_;
+    ThreadPool& pool_;
+    mutable std::mutex mu_;
+    std::condition_variable idle_;
+    std::size_t in_flight_{0};
+    detail::FutureWatcher watcher_; // last: stopped before the rest goes away
+};
+
+} // namespace tsexpr
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ts::expr {
+
+/// Arrow-style validity bitmap: bit i set means row i holds a value, clear
+/// means the observation is missing. Bits past size() are always zero so
+/// word-wide operations never need to mask the tail.
+class ValidityBitmap {
+public:
+    ValidityBitmap() = default;
+    explicit ValidityBitmap(std::size_t n, bool valid = true);
+
+    static ValidityBitmap from_bools(const std::vector<bool>& valid);
+
+    std::size_t size() const noexcept { return n_; }
+    std::size_t word_count() const noexcept { return words_.size(); }
+    const std::uint64_t* words() const noexcept { return words_.data(); }
+    std::uint64_t* words() noexcept { return words_.data(); }
+
+    bool get(std::size_t i) const noexcept { return (words_[i >> 6] >> (i & 63)) & 1u; }
+    void set(std::size_t i, bool valid) noexcept {
+        const std::uint64_t bit = std::uint64_t{1} << (i & 63);
+        if (valid) words_[i >> 6] |= bit;
+        else       words_[i >> 6] &= ~bit;
+    }
+
+    /// Number of valid rows.
+    std::size_t count() const noexcept;
+    /// True if no row is missing. Stops at the first word with a clear bit.
+    bool all_set() const noexcept;
+
+    /// Word-wide AND of two bitmaps of equal size.
+    static ValidityBitmap combine(const ValidityBitmap& a, const ValidityBitmap& b);
+
+    /// Bits [b, e) as a new bitmap, shifted word-wise.
+    ValidityBitmap slice(std::size_t b, std::size_t e) const;
+
+    /// Grow or shrink to n bits; new bits are `valid`. Amortized O(1) per
+    /// added word.
+    void resize(std::size_t n, bool valid = true);
+
+private:
+    void clear_tail() noexcept;
+
+    std::vector<std::uint64_t> words_;
+    std::size_t n_{0};
+};
+
+using ValidityPtr = std::shared_ptr<const ValidityBitmap>;
+
+/// Validity of an elementwise result: null inputs mean "all valid", so this
+/// only allocates when both sides carry a bitmap.
+ValidityPtr combine_validity(const ValidityPtr& a, const ValidityPtr& b);
+
+} // namespace ts::expr
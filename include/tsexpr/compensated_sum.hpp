@@ -0,0 +1,50 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <optional>
+
+namespace tsexpr {
+
+// Neumaier-compensated running sum, shared by the rolling and resample
+// aggregators: the low-order bits lost by each add go to a separate
+// compensation term. Callers keep NaN and infinities out of it (see
+// NonFiniteCount); one inf would make the sum NaN once it is removed or an
+// inf of the other sign arrives.
+struct CompensatedSum {
+    double sum{0.0};
+    double compensation{0.0};
+
+    void add(double x) noexcept {
+        const double t = sum + x;
+        compensation += std::fabs(sum) >= std::fabs(x) ? (sum - t) + x : (x - t) + sum;
+        sum = t;
+    }
+    double value() const noexcept { return sum + compensation; }
+};
+
+// The NaN and infinite values among the rows of a window or bucket, counted
+// apart from its running sums.
+struct NonFiniteCount {
+    std::size_t nan{0}, pos_inf{0}, neg_inf{0};
+
+    // Count `x` in (entering) or out; false, and nothing counted, if finite.
+    bool count(double x, bool entering) noexcept {
+        if (std::isfinite(x)) return false;
+        std::size_t& n = std::isnan(x) ? nan : x > 0 ? pos_inf : neg_inf;
+        entering ? ++n : --n;
+        return true;
+    }
+    std::size_t total() const noexcept { return nan + pos_inf + neg_inf; }
+
+    // The sum of the counted rows plus any finite ones, if these decide it:
+    // NaN for a NaN or for infinities of both signs, else the infinity.
+    std::optional<double> sum() const noexcept {
+        if (nan || (pos_inf && neg_inf)) return std::numeric_limits<double>::quiet_NaN();
+        if (pos_inf || neg_inf) return pos_inf ? std::numeric_limits<double>::infinity()
+                                               : -std::numeric_limits<double>::infinity();
+        return std::nullopt;
+    }
+};
+
+} // namespace tsexpr
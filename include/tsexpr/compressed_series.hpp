@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <tsexpr/timeseries_stub.hpp>
+
+namespace ts::expr {
+
+/// Immutable compressed series for data that does not fit in RAM as raw
+/// doubles. Values use Gorilla-style XOR encoding against the previous value;
+/// timestamps (when present) use delta-of-delta encoding. Rows are cut into
+/// independently decodable blocks so kernels can stream block by block with
+/// a buffer of one block per input, never materializing the whole series.
+///
+/// Values are stored as double (f32 input is widened). Null rows are kept as
+/// run-length spans per block and cost one value bit each (they repeat the
+/// previous value); decode() and the kernels restore them as nulls. Copies
+/// share the encoded data.
+class CompressedSeries {
+public:
+    static constexpr std::size_t default_block_rows = 4096;
+
+    CompressedSeries() = default;
+
+    static CompressedSeries encode(const TimeSeries& s, std::size_t block_rows = default_block_rows);
+
+    /// Streaming encoder: append rows in any number of calls, then finish().
+    class Builder {
+    public:
+        explicit Builder(bool timestamped, std::size_t block_rows = default_block_rows);
+        ~Builder();
+        Builder(Builder&&) noexcept;
+        Builder& operator=(Builder&&) noexcept;
+
+        /// `ts` may be null for an untimestamped builder. Row i is null when
+        /// `valid` is given and bit i is clear; null means every row is valid.
+        void append(const std::int64_t* ts, const double* values, std::size_t n,
+                    const ValidityBitmap* valid = nullptr);
+        /// Leaves the builder empty, ready for another series with the same
+        /// timestamping and block size.
+        CompressedSeries finish();
+
+    private:
+        struct State;
+        std::unique_ptr<State> st_;
+    };
+
+    /// Decodes one block at a time into an internal buffer.
+    class BlockReader {
+    public:
+        explicit BlockReader(const CompressedSeries& s);
+
+        /// Decode the next block; false at the end.
+        bool next();
+        std::size_t rows() const noexcept { return rows_; }
+        /// Null rows hold NaN.
+        const double* values() const noexcept { return values_.data(); }
+        /// Null for untimestamped series.
+        const std::int64_t* timestamps() const noexcept { return ts_.empty() ? nullptr : ts_.data(); }
+        /// The block's validity, or null if it has no null rows.
+        const ValidityBitmap* validity() const noexcept { return has_nulls_ ? &valid_ : nullptr; }
+
+    private:
+        const CompressedSeries* s_;
+        std::size_t block_{0};
+        std::size_t rows_{0};
+        std::vector<double> values_;
+        std::vector<std::int64_t> ts_;
+        ValidityBitmap valid_;
+        bool has_nulls_{false};
+    };
+
+    std::size_t size() const noexcept;
+    std::size_t block_rows() const noexcept;
+    std::size_t block_count() const noexcept;
+    bool has_index() const noexcept;
+
+    /// Number of null rows.
+    std::size_t null_count() const noexcept;
+
+    /// Encoded size in bytes (bit streams, block headers and null spans).
+    std::size_t compressed_bytes() const noexcept;
+    /// Size the same rows take uncompressed: 8 bytes per value and per timestamp.
+    std::size_t raw_bytes() const noexcept;
+    /// raw_bytes() / compressed_bytes().
+    double compression_ratio() const noexcept;
+
+    struct DecodeStats {
+        std::size_t rows{0};
+        std::size_t blocks{0};
+        double seconds{0.0};
+
+        double rows_per_second() const noexcept { return seconds > 0 ? double(rows) / seconds : 0.0; }
+        /// Decoded (raw) bytes produced per second.
+        double raw_bytes_per_second(bool timestamped) const noexcept {
+            return rows_per_second() * (timestamped ? 16.0 : 8.0);
+        }
+    };
+
+    /// Time one full streaming decode pass over every block.
+    DecodeStats measure_decode() const;
+
+    /// Materialize the whole series. Convenience for tests and small data.
+    TimeSeries decode() const;
+
+private:
+    struct Data;
+    friend class Builder;
+    friend class BlockReader;
+
+    std::shared_ptr<const Data> data_;
+};
+
+/// Streaming kernels: inputs are decoded one block at a time and outputs are
+/// re-encoded as they are produced. TS op TS requires equal lengths, and equal
+/// timestamps when both sides are timestamped. Nulls follow the TimeSeries
+/// ops: sumproduct skips rows null on either side, and elementwise results
+/// are null where an operand is.
+double sumproduct(const CompressedSeries& a, const CompressedSeries& b);
+double sumproduct(const CompressedSeries& a, double b);
+
+CompressedSeries operator+(const CompressedSeries& a, const CompressedSeries& b);
+CompressedSeries operator-(const CompressedSeries& a, const CompressedSeries& b);
+CompressedSeries operator*(const CompressedSeries& a, const CompressedSeries& b);
+CompressedSeries operator/(const CompressedSeries& a, const CompressedSeries& b);
+
+CompressedSeries operator+(const CompressedSeries& a, double b);
+CompressedSeries operator-(const CompressedSeries& a, double b);
+CompressedSeries operator*(const CompressedSeries& a, double b);
+CompressedSeries operator/(const CompressedSeries& a, double b);
+
+} // namespace ts::expr
@@ -0,0 +1,114 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+namespace tsexpr {
+
+// First-order recursive filters, shared by backends that implement ewma,
+// ewvar and filter behind Op::Call.
+enum class EwmKind {
+    Mean,   // ewma(x, halflife): exponentially weighted mean
+    Var,    // ewvar(x, halflife): exponentially weighted variance
+    Filter, // filter(x, alpha): y = alpha * x + (1 - alpha) * y[-1], y starts at 0
+};
+
+inline std::optional<EwmKind> ewm_kind(std::string_view fn) noexcept {
+    if (fn == "ewma") return EwmKind::Mean;
+    if (fn == "ewvar") return EwmKind::Var;
+    if (fn == "filter") return EwmKind::Filter;
+    return std::nullopt;
+}
+
+// Smoothing factor with which a row's weight halves every `halflife` rows.
+inline double ewm_alpha(double halflife) { return -std::expm1(-std::log(2.0) / halflife); }
+
+// Carried state of one recursive filter. Pushing rows one at a time (a live
+// feed) or in slices through run() gives the same results as one pass over
+// the whole series, so a streaming update costs O(new rows).
+//
+// ewma and ewvar start from the first present row (mean = x, variance 0) and
+// then update recursively with alpha = ewm_alpha(halflife); ewvar is the
+// biased incremental variance y = (1 - alpha) * (y + alpha * d * d), d being
+// the row's distance from the previous mean. Missing rows leave the state
+// alone and have no value; so do rows before the first present one.
+class EwmFilter {
+public:
+    // `param` is the halflife in rows (> 0) for Mean and Var, alpha in
+    // (0, 1] for Filter. Throws std::invalid_argument otherwise.
+    EwmFilter(EwmKind kind, double param) : kind_(kind) {
+        if (kind == EwmKind::Filter) {
+            if (!(param > 0.0 && param <= 1.0)) throw std::invalid_argument("filter alpha must be in (0, 1]");
+            alpha_ = param;
+        } else {
+            if (!(param > 0.0) || std::isinf(param)) throw std::invalid_argument("ewm halflife must be positive");
+            alpha_ = ewm_alpha(param);
+        }
+    }
+
+    EwmKind kind() const noexcept { return kind_; }
+    double alpha() const noexcept { return alpha_; }
+    // True once a present row has been pushed.
+    bool started() const noexcept { return started_; }
+    void clear() noexcept { started_ = false; mean_ = var_ = 0.0; }
+
+    std::optional<double> push(double x, bool present = true) {
+        if (!present) return std::nullopt;
+        step(x);
+        return value();
+    }
+
+    // Push n present rows and write each row's value to out[i]: the
+    // single-pass kernel, with the state held in locals.
+    template <class T>
+    void run(const T* x, std::size_t n, double* out) {
+        std::size_t i = 0;
+        if (!started_ && n) {
+            step(double(x[0]));
+            out[i++] = value();
+        }
+        const double a = alpha_;
+        double m = mean_, v = var_;
+        switch (kind_) {
+            case EwmKind::Mean:
+            case EwmKind::Filter:
+                for (; i < n; ++i) out[i] = m += a * (double(x[i]) - m);
+                break;
+            case EwmKind::Var:
+                for (; i < n; ++i) {
+                    const double d = double(x[i]) - m;
+                    m += a * d;
+                    out[i] = v = (1.0 - a) * (v + a * d * d);
+                }
+                break;
+        }
+        mean_ = m;
+        var_ = v;
+    }
+
+private:
+    void step(double x) {
+        if (!started_) {
+            started_ = true;
+            if (kind_ != EwmKind::Filter) {
+                mean_ = x;
+                var_ = 0.0;
+                return;
+            }
+        }
+        const double d = x - mean_;
+        mean_ += alpha_ * d;
+        if (kind_ == EwmKind::Var) var_ = (1.0 - alpha_) * (var_ + alpha_ * d * d);
+    }
+    double value() const noexcept { return kind_ == EwmKind::Var ? var_ : mean_; }
+
+    EwmKind kind_;
+    double alpha_{1.0};
+    bool started_{false};
+    double mean_{0.0}; // the output for Mean and Filter
+    double var_{0.0};
+};
+
+} // namespace tsexpr
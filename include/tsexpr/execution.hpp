@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+
+namespace tsexpr {
+
+// How much work one Execution::resume() may do before suspending.
+struct SliceBudget {
+    std::size_t instructions{std::numeric_limits<std::size_t>::max()};
+    // Charged per instruction with backend.rows(result) when the backend has
+    // it (e.g. the length of the series an operation produced), else 1.
+    // The charge is only known once an instruction has finished, so a slice
+    // may overrun this by up to one instruction's rows: it is a trigger to
+    // suspend, not a cap on the work done.
+    std::size_t rows{std::numeric_limits<std::size_t>::max()};
+};
+
+namespace detail {
+template <class B, class V, class = void>
+struct has_rows : std::false_type {};
+template <class B, class V>
+struct has_rows<B, V, std::void_t<decltype(std::size_t(std::declval<B&>().rows(std::declval<const V&>())))>>
+    : std::true_type {};
+} // namespace detail
+
+// A Program run that can stop part-way and continue later, so a scheduler
+// can interleave many programs on few threads and keep an expensive one
+// from holding a thread for its whole run. Suspension happens between
+// instructions; the evaluation stack is kept in the object.
+//
+// Fork/Join points run inline: a time slice never spans threads.
+// The program and backend must outlive the Execution.
+template <class Backend>
+class Execution {
+public:
+    using Value = decltype(std::declval<Backend&>().load_var(std::string_view{}));
+
+    Execution(const Program& program, Backend& backend) : program_(&program), backend_(&backend) {}
+
+    // Run until the program finishes (true) or the budget is spent (false).
+    // At least one instruction runs per call, so repeated calls always make
+    // progress. An exception from the backend ends the execution and is
+    // rethrown; resuming it afterwards throws EvalError.
+    bool resume(const SliceBudget& budget = {}) {
+        if (failed_) throw EvalError("Resumed an execution that failed");
+        const auto& code = program_->code;
+        std::size_t instrs = 0, rows = 0;
+        while (pc_ < code.size()) {
+            if (instrs > 0 && (instrs >= budget.instructions || rows >= budget.rows)) return false;
+            const Instr& ins = code[pc_++];
+            ++instrs;
+            ++instructions_;
+            // Forked operands sit in operand order in the code stream, so
+            // run inline they need no reordering at the Join.
+            if (ins.op == Op::Fork || ins.op == Op::Join) continue;
+            try {
+                Program::step(ins, *backend_, ctx_);
+            } catch (...) {
+                failed_ = true;
+                throw;
+            }
+            std::size_t cost = 1;
+            if constexpr (detail::has_rows<Backend, Value>::value) {
+                if (ins.op != Op::Store) cost = std::size_t(backend_->rows(ctx_.stack.back()));
+            }
+            rows += cost;
+            rows_ += cost;
+        }
+        return true;
+    }
+
+    bool done() const noexcept { return pc_ >= program_->code.size(); }
+    bool failed() const noexcept { return failed_; }
+    // Totals over all slices so far.
+    std::size_t instructions_executed() const noexcept { return instructions_; }
+    std::size_t rows_processed() const noexcept { return rows_; }
+
+private:
+    const Program* program_;
+    Backend* backend_;
+    ExecutionContext<Value> ctx_;
+    std::size_t pc_{0};
+    std::size_t instructions_{0};
+    std::size_t rows_{0};
+    bool failed_{false};
+};
+
+// Outcome of run_round_robin().
+struct RoundRobinReport {
+    std::size_t slices{0};
+    std::vector<std::exception_ptr> errors; // per execution; null unless it failed in this run
+
+    std::size_t failed() const noexcept {
+        std::size_t n = 0;
+        for (const auto& e : errors) n += e != nullptr;
+        return n;
+    }
+};
+
+// Round-robin `budget`-sized slices over a range of Executions on the
+// calling thread until each is done or failed. Cheap programs finish in
+// their first slices instead of queueing behind expensive ones. A failing
+// execution does not stop the others: its exception is kept in
+// RoundRobinReport::errors and it gets no further slices. Executions that
+// had already failed are skipped.
+template <class It>
+RoundRobinReport run_round_robin(It first, It last, const SliceBudget& budget) {
+    RoundRobinReport report;
+    report.errors.assign(std::size_t(std::distance(first, last)), nullptr);
+    for (bool pending = true; pending;) {
+        pending = false;
+        std::size_t i = 0;
+        for (It it = first; it != last; ++it, ++i) {
+            if (it->done() || it->failed()) continue;
+            ++report.slices;
+            try {
+                if (!it->resume(budget)) pending = true;
+            } catch (...) {
+                report.errors[i] = std::current_exception();
+            }
+        }
+    }
+    return report;
+}
+
+} // namespace tsexpr
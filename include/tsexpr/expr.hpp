@@ -4,9 +4,11 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
+#include <tsexpr/snapshot_store.hpp>
 #include <tsexpr/timeseries_stub.hpp>
 
 namespace ts::expr {
@@ -15,6 +17,9 @@ struct ParseError : std::runtime_error { using std::runtime_error::runtime_error
 struct EvalError  : std::runtime_error { using std::runtime_error::runtime_error; };
 
 using Env   = std::map<std::string, TimeSeries>;
+/// Env that readers can evaluate against while writers publish new series.
+using VariableStore = tsexpr::SnapshotStore<TimeSeries>;
+static_assert(std::is_same_v<VariableStore::Map, Env>);
 using Value = std::variant<TimeSeries, double>;
 
 enum class TokKind {
@@ -57,4 +62,19 @@ Value eval_rpn(const std::vector<Token>& rpn, const Env& env);
 /// Assignment currently requires the expression to reduce to TimeSeries.
 void execute_assignment(std::string_view input, Env& env);
 
+/// Execute a batch of assignments with the same results as running them in
+/// order, evaluating independent statements concurrently on
+/// tsexpr::default_thread_pool() (see tsexpr::DependencyGraph).
+/// Batches that would fail part-way through serially (a statement that does
+/// not parse, or reads a variable defined neither in env nor by an earlier
+/// statement) run serially, so they fail at the same statement. Other
+/// evaluation errors rethrow the earliest failing statement's exception and
+/// undo any later statements that already ran, leaving env as the serial
+/// run would.
+void execute_assignments(const std::vector<std::string>& statements, Env& env);
+
+/// Evaluate against one snapshot of `store` (a consistent version, whatever
+/// is published meanwhile) and publish the result as a new version.
+void execute_assignment(std::string_view input, VariableStore& store);
+
 } // namespace ts::expr
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+#include "tsexpr/scheduler.hpp"
+#include "tsexpr/thread_pool.hpp"
+
+namespace tsexpr {
+
+// Version counter per variable. Every bump hands out a number larger than
+// any before it, so "changed since I last looked" is a comparison.
+// Thread-safe.
+class VersionTable {
+public:
+    // 0 for a variable that was never bumped.
+    std::uint64_t get(std::string_view name) const;
+    std::uint64_t bump(std::string_view name);
+    // Restore a version an earlier bump() handed out, for a value known to
+    // equal the one it was handed out for (see ResultCache).
+    void set(std::string_view name, std::uint64_t version);
+
+private:
+    mutable std::mutex mu_;
+    std::map<std::string, std::uint64_t, std::less<>> versions_;
+    std::uint64_t clock_{0};
+};
+
+// Forwards to `backend` and bumps a variable's version on every store_var.
+template <class Backend>
+class VersionedBackend {
+public:
+    VersionedBackend(Backend& backend, VersionTable& versions) : b_(backend), versions_(versions) {}
+
+    decltype(auto) load_var(std::string_view name) { return b_.load_var(name); }
+
+    template <class V>
+    void store_var(std::string_view name, V&& v) {
+        b_.store_var(name, std::forward<V>(v));
+        versions_.bump(name);
+    }
+
+    template <class... A> decltype(auto) make_number(A&&... a) { return b_.make_number(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) neg(A&&... a) { return b_.neg(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) binary(A&&... a) { return b_.binary(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) call(A&&... a) { return b_.call(std::forward<A>(a)...); }
+
+private:
+    Backend& b_;
+    VersionTable& versions_;
+};
+
+// Re-executes only the statements of a batch whose inputs changed.
+//
+// Each statement remembers the versions of the variables it read (PushVar)
+// and wrote (Store) when it last ran. recompute() runs, in batch order, the
+// statements that never ran, read a variable whose version moved, hold the
+// final write of a variable that was overwritten since, or read or write a
+// variable that an earlier re-run statement writes. Re-running a statement
+// bumps its targets, so changes propagate to everything downstream and the
+// results match re-running the whole batch.
+//
+// A read is loop-carried when the reader writes the variable itself (acc =
+// acc + x), or precedes a writer of it that depends on the reader's output
+// (a cycle): the batch's own write to it then does not make the reader
+// stale, only a touch() after recompute() does. Any other read of a
+// variable written only later in the batch (y = a + 1; a = b * 2) goes stale
+// when that write changes it, so the next recompute() re-runs the reader,
+// as re-running the whole batch would.
+//
+// Stores made through recompute() are versioned automatically. Changes made
+// to the backend directly (new input data) must be reported with touch().
+class IncrementalRunner {
+public:
+    explicit IncrementalRunner(std::vector<Program> programs);
+
+    const std::vector<Program>& programs() const noexcept { return programs_; }
+    VersionTable& versions() noexcept { return versions_; }
+    const VersionTable& versions() const noexcept { return versions_; }
+
+    // Record that `name` changed outside the batch.
+    void touch(std::string_view name) { versions_.bump(name); }
+
+    // Forget what has run; the next recompute() runs every statement.
+    void invalidate() noexcept;
+
+    // Statements the next recompute() would run, in batch order.
+    std::vector<std::size_t> stale() const;
+
+    // Run the stale statements in order. Returns how many ran. If one
+    // throws, it and the statements after it stay stale and the exception
+    // propagates.
+    template <class Backend>
+    std::size_t recompute(Backend& backend);
+
+    // Same, running independent stale statements concurrently on `pool`
+    // (see execute_parallel for what the backend must allow).
+    template <class Backend>
+    std::size_t recompute(Backend& backend, ThreadPool& pool);
+
+private:
+    struct Statement {
+        std::vector<std::string> reads, writes;
+        std::vector<std::uint64_t> read_versions, write_versions; // as of its last run
+        std::vector<bool> last_writer; // per write: no later statement writes it
+        std::vector<bool> carried;     // per read: loop-carried (see above)
+        bool ran{false};
+    };
+
+    template <class Backend>
+    void run_one(std::size_t i, Backend& backend);
+    // After a pass: accept the batch's own writes to loop-carried reads.
+    void settle();
+    bool writes(std::size_t i, std::string_view name) const;
+    bool reads_output_of(std::size_t k, std::size_t i) const;
+    bool loop_carried(std::size_t i, std::string_view name) const;
+
+    std::vector<Program> programs_;
+    std::vector<Statement> statements_;
+    VersionTable versions_;
+};
+
+template <class Backend>
+void IncrementalRunner::run_one(std::size_t i, Backend& backend) {
+    Statement& st = statements_[i];
+    st.ran = false;
+    for (std::size_t k = 0; k < st.reads.size(); ++k) st.read_versions[k] = versions_.get(st.reads[k]);
+    programs_[i].execute(backend);
+    for (std::size_t k = 0; k < st.writes.size(); ++k) st.write_versions[k] = versions_.get(st.writes[k]);
+    st.ran = true;
+}
+
+template <class Backend>
+std::size_t IncrementalRunner::recompute(Backend& backend) {
+    const std::vector<std::size_t> todo = stale();
+    VersionedBackend<Backend> versioned(backend, versions_);
+    for (std::size_t i : todo) run_one(i, versioned);
+    settle();
+    return todo.size();
+}
+
+template <class Backend>
+std::size_t IncrementalRunner::recompute(Backend& backend, ThreadPool& pool) {
+    const std::vector<std::size_t> todo = stale();
+    DependencyGraph graph;
+    for (std::size_t i : todo) graph.add(statements_[i].reads, statements_[i].writes);
+    SynchronizedBackend<Backend> sync(backend);
+    VersionedBackend<SynchronizedBackend<Backend>> versioned(sync, versions_);
+    graph.run(pool, [&](std::size_t j) { run_one(todo[j], versioned); });
+    settle();
+    return todo.size();
+}
+
+} // namespace tsexpr
@@ -0,0 +1,114 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+#include "tsexpr/thread_pool.hpp"
+
+namespace tsexpr {
+
+// Outcome of running one Program over a panel of instruments.
+struct PanelReport {
+    std::size_t instruments{0};
+    double wall_seconds{0.0};
+    std::vector<double> seconds;            // execution time per instrument
+    std::vector<std::exception_ptr> errors; // per instrument; null on success
+
+    std::size_t failed() const noexcept {
+        std::size_t n = 0;
+        for (const auto& e : errors) n += e != nullptr;
+        return n;
+    }
+    // Completed instruments per wall-clock second.
+    double instruments_per_second() const noexcept {
+        return wall_seconds > 0 ? double(instruments) / wall_seconds : 0.0;
+    }
+    // Average time one instrument took to execute (on whichever thread ran it).
+    double mean_seconds() const noexcept {
+        double total = 0.0;
+        for (double s : seconds) total += s;
+        return instruments ? total / double(instruments) : 0.0;
+    }
+};
+
+// Run `program` once per instrument i in [0, n) against backend_at(i), which
+// returns the instrument's backend (by reference, or by value to build one
+// from a binding set on the fly). Instruments are spread over the pool's
+// workers and the calling thread, which pull them from a shared counter
+// `grain` at a time, so fast threads take more. Each thread reuses one
+// ExecutionContext for all its instruments.
+//
+// A failing instrument does not stop the others: its exception is recorded
+// in PanelReport::errors.
+template <class BackendAt>
+PanelReport execute_panel(const Program& program, std::size_t n, BackendAt&& backend_at,
+                          ThreadPool& pool = default_thread_pool(), std::size_t grain = 1) {
+    using Backend = std::remove_reference_t<decltype(backend_at(std::size_t{0}))>;
+    using Value = decltype(std::declval<Backend&>().load_var(std::string_view{}));
+    using clock = std::chrono::steady_clock;
+
+    PanelReport report;
+    report.instruments = n;
+    report.seconds.assign(n, 0.0);
+    report.errors.assign(n, nullptr);
+
+    // Slot per pool worker plus one for the calling thread. A slot is only
+    // touched by its own thread; `busy` covers re-entry when a backend
+    // operation waits on the same pool and picks up another instrument.
+    // Any other thread (e.g. one waiting on its own panel over this pool,
+    // which may pick up our chunks) uses a context of its own per chunk.
+    struct Slot {
+        ExecutionContext<Value> ctx;
+        bool busy{false};
+    };
+    std::vector<std::unique_ptr<Slot>> slots(pool.size() + 1);
+    for (auto& s : slots) s = std::make_unique<Slot>();
+    const std::thread::id caller = std::this_thread::get_id();
+
+    const auto start = clock::now();
+    pool.parallel_for(n, grain, [&](std::size_t b, std::size_t e) {
+        const std::size_t w = pool.worker_index();
+        Slot* slot = w != ThreadPool::npos                      ? slots[w].get()
+                     : std::this_thread::get_id() == caller ? slots[pool.size()].get()
+                                                            : nullptr;
+        ExecutionContext<Value> spare;
+        const bool owns = slot && !slot->busy;
+        ExecutionContext<Value>& ctx = owns ? slot->ctx : spare;
+        if (owns) slot->busy = true;
+        for (std::size_t i = b; i < e; ++i) {
+            const auto t0 = clock::now();
+            try {
+                decltype(auto) backend = backend_at(i);
+                program.execute(backend, ctx);
+            } catch (...) {
+                report.errors[i] = std::current_exception();
+            }
+            report.seconds[i] = std::chrono::duration<double>(clock::now() - t0).count();
+        }
+        if (owns) slot->busy = false;
+    });
+    report.wall_seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return report;
+}
+
+// Same, over a random-access range of backends.
+template <class It>
+PanelReport execute_panel(const Program& program, It first, It last,
+                          ThreadPool& pool = default_thread_pool(), std::size_t grain = 1) {
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                                    typename std::iterator_traits<It>::iterator_category>,
+                  "execute_panel needs random-access iterators");
+    const auto n = static_cast<std::size_t>(std::distance(first, last));
+    return execute_panel(program, n, [first](std::size_t i) -> decltype(auto) { return first[i]; },
+                         pool, grain);
+}
+
+} // namespace tsexpr
@@ -1,10 +1,62 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "tsexpr/lexer.hpp"
 #include "tsexpr/program.hpp"
+#include "tsexpr/thread_pool.hpp"
 
 namespace tsexpr {
 
+struct CompileOptions {
+    // Evaluate independent operand subtrees concurrently (Op::Fork/Op::Join)
+    // when at least two operands of one operator have an estimated cost of
+    // at least fork_threshold. 0 disables forking.
+    double fork_threshold{0.0};
+    // Cost model: 1 per arithmetic op, call_cost per function call, 0 for
+    // loads and literals.
+    double call_cost{8.0};
+};
+
 // Compile a single statement: IDENT '=' EXPR
 Program compile(std::string_view input);
+Program compile(std::string_view input, const CompileOptions& options);
+
+// Distinct variable and function names of a compiled catalog. Instr::name_id
+// indexes `names`, so backends can resolve each name once and then look
+// values up by id.
+struct NameTable {
+    std::vector<std::string> names;
+
+    // Id of `name`, adding it if new.
+    std::uint32_t intern(const std::string& name);
+    void reserve(std::size_t n);
+    // Id of `name`, or Instr::no_name.
+    std::uint32_t find(const std::string& name) const;
+
+private:
+    std::unordered_map<std::string, std::uint32_t> ids_;
+};
+
+struct CompiledCatalog {
+    std::vector<Program> programs;                 // one per input; empty code on error
+    std::vector<std::optional<ParseError>> errors; // one per input; set on error
+    std::shared_ptr<const NameTable> names;        // shared by every program
+
+    std::size_t failed() const noexcept;
+};
+
+// Compile many statements in parallel on `pool`. Parse errors are collected
+// per input instead of thrown. Name ids are assigned in order of first
+// appearance, so they do not depend on scheduling.
+CompiledCatalog compile_many(const std::string_view* inputs, std::size_t count,
+                             const CompileOptions& options = {}, ThreadPool& pool = default_thread_pool());
+CompiledCatalog compile_many(const std::vector<std::string_view>& inputs,
+                             const CompileOptions& options = {}, ThreadPool& pool = default_thread_pool());
 
 } // namespace tsexpr
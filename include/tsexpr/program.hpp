@@ -1,9 +1,17 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "tsexpr/thread_pool.hpp"
+
 namespace tsexpr {
 
 struct EvalError : std::runtime_error { using std::runtime_error::runtime_error; };
@@ -18,70 +26,286 @@ enum class Op {
     Neg,
     Call,   // fn name + argc
     Store,  // var name
+    Fork,   // evaluate the next argc instructions on another thread
+    Join,   // wait for forked operands and restore operand order
 };
 
 struct Instr {
     Op op{Op::PushNum};
     std::string text{}; // var name / function name
     double number{0.0}; // literal
-    int argc{0};        // Call arg count
+    int argc{0};        // Call arg count / Fork span length / Join operand count
+    std::uint32_t forked{0}; // Join: bit i set = operand i was forked
+    std::uint32_t name_id{no_name}; // PushVar/Store/Call: id in a shared NameTable (compile_many)
+
+    static constexpr std::uint32_t no_name = static_cast<std::uint32_t>(-1);
+};
+
+// Scratch buffers for Program::execute. Reusing one context across calls
+// (e.g. one per worker thread) avoids reallocating the evaluation stack and
+// call-argument vector for every run. A context must not be used by two
+// executions at once.
+template <class Value>
+struct ExecutionContext {
+    std::vector<Value> stack;
+    std::vector<Value> args;
+};
+
+namespace detail {
+
+template <class B, class = void>
+struct has_prefetch : std::false_type {};
+template <class B>
+struct has_prefetch<B, std::void_t<decltype(std::declval<B&>().prefetch(std::declval<const std::vector<std::string>&>()))>>
+    : std::true_type {};
+
+template <class B, class = void>
+struct has_load_var_async : std::false_type {};
+template <class B>
+struct has_load_var_async<B, std::void_t<decltype(std::declval<B&>().load_var_async(std::string_view{}).get())>>
+    : std::true_type {};
+
+// Serves a program's loads from values resolved up front; everything else
+// goes to the wrapped backend. A value is moved out on its last use unless
+// loads may run concurrently (forked programs), in which case it is copied.
+template <class Backend, class Value>
+class ResolvedBackend {
+public:
+    ResolvedBackend(Backend& b, std::vector<std::string> names, std::vector<Value> values,
+                    std::vector<int> uses, bool move_last)
+        : b_(b), names_(std::move(names)), values_(std::move(values)), uses_(std::move(uses)),
+          move_last_(move_last) {}
+
+    Value load_var(std::string_view name) {
+        // Programs have a handful of inputs: a linear scan beats a map.
+        for (std::size_t i = 0; i < names_.size(); ++i) {
+            if (names_[i] != name) continue;
+            if (move_last_ && --uses_[i] == 0) return std::move(values_[i]);
+            return values_[i];
+        }
+        return b_.load_var(name);
+    }
+
+    template <class V>
+    void store_var(std::string_view name, V&& v) { b_.store_var(name, std::forward<V>(v)); }
+
+    template <class... A> decltype(auto) make_number(A&&... a) { return b_.make_number(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) neg(A&&... a) { return b_.neg(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) binary(A&&... a) { return b_.binary(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) call(A&&... a) { return b_.call(std::forward<A>(a)...); }
+
+private:
+    Backend& b_;
+    std::vector<std::string> names_;
+    std::vector<Value> values_;
+    std::vector<int> uses_;
+    bool move_last_;
 };
 
+} // namespace detail
+
+template <class Backend>
+class Execution;
+template <class Backend>
+class AsyncExecutor;
+
 struct Program {
     std::vector<Instr> code;
 
+    // Distinct variables the program loads, in order of first use.
+    std::vector<std::string> inputs() const {
+        std::vector<std::string> out;
+        for (const auto& ins : code) {
+            if (ins.op == Op::PushVar && std::find(out.begin(), out.end(), ins.text) == out.end())
+                out.push_back(ins.text);
+        }
+        return out;
+    }
+
+    // Execute with all input loads issued up front so their latency overlaps:
+    //  - backend.prefetch(inputs()) if the backend has it, then a normal run
+    //    (the backend is expected to serve the loads from what it fetched);
+    //  - otherwise backend.load_var_async(name) for every input, whose
+    //    results (anything with get(), e.g. std::future) are collected before
+    //    the program runs on them; the first failed load, in order of first
+    //    use, is rethrown;
+    //  - otherwise a plain execute().
+    template <class Backend>
+    void execute_prefetched(Backend& backend) const {
+        using Value = decltype(backend.load_var(std::string_view{}));
+        if constexpr (detail::has_prefetch<Backend>::value) {
+            backend.prefetch(inputs());
+            execute(backend);
+        } else if constexpr (detail::has_load_var_async<Backend>::value) {
+            std::vector<std::string> names = inputs();
+            std::vector<decltype(backend.load_var_async(std::string_view{}))> pending;
+            pending.reserve(names.size());
+            for (const auto& n : names) pending.push_back(backend.load_var_async(n));
+
+            std::vector<Value> values;
+            values.reserve(names.size());
+            for (auto& f : pending) values.push_back(f.get());
+
+            std::vector<int> uses(names.size(), 0);
+            bool forks = false;
+            for (const auto& ins : code) {
+                forks |= ins.op == Op::Fork;
+                if (ins.op != Op::PushVar) continue;
+                const auto at = std::find(names.begin(), names.end(), ins.text) - names.begin();
+                ++uses[static_cast<std::size_t>(at)];
+            }
+            detail::ResolvedBackend<Backend, Value> resolved(backend, std::move(names), std::move(values),
+                                                             std::move(uses), !forks);
+            execute(resolved);
+        } else {
+            execute(backend);
+        }
+    }
+
     template <class Backend>
     void execute(Backend& backend) const {
         using Value = decltype(backend.load_var(std::string_view{}));
+        ExecutionContext<Value> ctx;
+        execute(backend, ctx);
+    }
 
-        std::vector<Value> st;
-        st.reserve(code.size());
+    template <class Backend, class Value>
+    void execute(Backend& backend, ExecutionContext<Value>& ctx) const {
+        static_assert(std::is_same_v<Value, decltype(backend.load_var(std::string_view{}))>,
+                      "ExecutionContext value type must match the backend's");
+        run(backend, ctx, 0, code.size());
+    }
 
-        auto pop = [&]() -> Value {
-            if (st.empty()) throw EvalError("Stack underflow (bad program)");
-            Value v = std::move(st.back());
-            st.pop_back();
-            return v;
-        };
+private:
+    template <class Backend>
+    friend class Execution;
+    template <class Backend>
+    friend class AsyncExecutor;
 
-        for (const auto& ins : code) {
-            switch (ins.op) {
-                case Op::PushVar:
-                    st.emplace_back(backend.load_var(ins.text));
-                    break;
+    // Result slot of one forked operand.
+    template <class Value>
+    struct Forked {
+        explicit Forked(ThreadPool& pool) : group(pool) {}
+        std::optional<Value> value;
+        TaskGroup group;
+    };
 
-                case Op::PushNum:
-                    st.emplace_back(backend.make_number(ins.number));
-                    break;
+    template <class Value>
+    static Value pop(std::vector<Value>& st) {
+        if (st.empty()) throw EvalError("Stack underflow (bad program)");
+        Value v = std::move(st.back());
+        st.pop_back();
+        return v;
+    }
 
-                case Op::Neg: {
-                    Value a = pop();
-                    st.emplace_back(backend.neg(a));
-                } break;
+    // Execute one value instruction (anything but Fork/Join) on ctx.stack.
+    template <class Backend, class Value>
+    static void step(const Instr& ins, Backend& backend, ExecutionContext<Value>& ctx) {
+        std::vector<Value>& st = ctx.stack;
+        switch (ins.op) {
+            case Op::PushVar:
+                st.emplace_back(backend.load_var(ins.text));
+                break;
 
-                case Op::Add:
-                case Op::Sub:
-                case Op::Mul:
-                case Op::Div: {
-                    Value b = pop();
-                    Value a = pop();
-                    st.emplace_back(backend.binary(ins.op, a, b));
-                } break;
+            case Op::PushNum:
+                st.emplace_back(backend.make_number(ins.number));
+                break;
+
+            case Op::Neg: {
+                Value a = pop(st);
+                st.emplace_back(backend.neg(a));
+            } break;
+
+            case Op::Add:
+            case Op::Sub:
+            case Op::Mul:
+            case Op::Div: {
+                Value b = pop(st);
+                Value a = pop(st);
+                st.emplace_back(backend.binary(ins.op, a, b));
+            } break;
+
+            case Op::Call: {
+                if (ins.argc < 0) throw EvalError("Invalid CALL argc");
+                if (static_cast<std::size_t>(ins.argc) > st.size())
+                    throw EvalError("Not enough args for CALL");
+                std::vector<Value>& args = ctx.args;
+                args.resize(static_cast<std::size_t>(ins.argc));
+                for (int i = ins.argc - 1; i >= 0; --i)
+                    args[static_cast<std::size_t>(i)] = pop(st);
+                Value r = backend.call(ins.text, args);
+                args.clear(); // keep the capacity, drop the operands
+                st.emplace_back(std::move(r));
+            } break;
+
+            case Op::Store: {
+                // Hand the result over as an rvalue so backends taking
+                // Value by value can move it into place.
+                Value v = pop(st);
+                backend.store_var(ins.text, std::move(v));
+            } break;
+
+            case Op::Fork:
+            case Op::Join:
+                throw EvalError("Internal error: FORK/JOIN reached step()");
+        }
+    }
+
+    // Execute code[begin, end). Fork spans run on default_thread_pool();
+    // their backend calls may overlap with this thread's, which is safe as
+    // long as the backend's loads and value operations are (no Store runs
+    // before every fork of the statement has joined).
+    template <class Backend, class Value>
+    void run(Backend& backend, ExecutionContext<Value>& ctx, std::size_t begin, std::size_t end) const {
+        std::vector<Value>& st = ctx.stack;
+        st.clear(); // may hold leftovers of a run that threw
+        st.reserve(end - begin);
+        // On unwind each pending fork waits for its task before going away.
+        std::vector<std::unique_ptr<Forked<Value>>> forks;
 
-                case Op::Call: {
-                    if (ins.argc < 0) throw EvalError("Invalid CALL argc");
-                    if (static_cast<std::size_t>(ins.argc) > st.size())
-                        throw EvalError("Not enough args for CALL");
-                    std::vector<Value> args(static_cast<std::size_t>(ins.argc));
-                    for (int i = ins.argc - 1; i >= 0; --i)
-                        args[static_cast<std::size_t>(i)] = pop();
-                    st.emplace_back(backend.call(ins.text, args));
+        for (std::size_t pc = begin; pc < end; ++pc) {
+            const Instr& ins = code[pc];
+            switch (ins.op) {
+                case Op::Fork: {
+                    const std::size_t b = pc + 1;
+                    const std::size_t e = b + static_cast<std::size_t>(ins.argc);
+                    if (ins.argc <= 0 || e > end) throw EvalError("Invalid FORK span");
+                    ThreadPool& pool = default_thread_pool();
+                    forks.push_back(std::make_unique<Forked<Value>>(pool));
+                    Forked<Value>* f = forks.back().get();
+                    f->group.run([this, &backend, f, b, e] {
+                        ExecutionContext<Value> sub;
+                        run(backend, sub, b, e);
+                        if (sub.stack.size() != 1) throw EvalError("FORK span must produce one value");
+                        f->value.emplace(std::move(sub.stack.back()));
+                    });
+                    pc = e - 1;
                 } break;
 
-                case Op::Store: {
-                    Value v = pop();
-                    backend.store_var(ins.text, v);
+                case Op::Join: {
+                    const std::size_t m = static_cast<std::size_t>(ins.argc);
+                    std::size_t nforked = 0;
+                    for (std::uint32_t bits = ins.forked; bits; bits &= bits - 1) ++nforked;
+                    if (m > 32 || nforked > forks.size() || m - nforked > st.size() || nforked > m)
+                        throw EvalError("Invalid JOIN");
+                    // Inline operands are on top of the stack, forked ones are the
+                    // newest forks; interleave them back into operand order.
+                    std::vector<Value>& inl = ctx.args;
+                    inl.clear();
+                    for (std::size_t k = 0; k < m - nforked; ++k) inl.push_back(pop(st));
+                    const std::size_t first = forks.size() - nforked;
+                    for (std::size_t k = first; k < forks.size(); ++k) forks[k]->group.wait();
+                    std::size_t next_fork = first;
+                    for (std::size_t i = 0; i < m; ++i) {
+                        if (ins.forked & (std::uint32_t{1} << i)) st.emplace_back(std::move(*forks[next_fork++]->value));
+                        else { st.emplace_back(std::move(inl.back())); inl.pop_back(); }
+                    }
+                    forks.resize(first);
                 } break;
+
+                default:
+                    step(ins, backend, ctx);
+                    break;
             }
         }
     }
@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <tsexpr/thread_pool.hpp>
+
+namespace tsexpr {
+
+// Deterministic reductions.
+//
+// [0, n) is cut into fixed leaves of reduce_leaf_rows rows. Each leaf is
+// reduced on its own, then leaf results are combined pairwise in a fixed
+// binary tree (leaf 0 with 1, 2 with 3, ..., then those pairs, ...). The
+// tree depends only on n, so a reduction gives bit-identical results
+// whether it runs serially or on a pool, with any thread count or grain.
+// Pairwise combination also keeps rounding error at O(log n) leaf sums.
+
+// A multiple of 64 so leaves start on a validity-bitmap word boundary.
+inline constexpr std::size_t reduce_leaf_rows = 4096;
+
+// Combine leaf(begin, end) results over [0, n) with `combine`; `identity`
+// is returned for n == 0. With a pool, leaves are computed in parallel,
+// `task_rows` rows (rounded to whole leaves) per scheduling chunk; a null
+// pool computes the same leaves on the calling thread.
+template <class T, class Leaf, class Combine>
+T deterministic_reduce(std::size_t n, T identity, Leaf&& leaf, Combine&& combine,
+                       ThreadPool* pool = nullptr, std::size_t task_rows = std::size_t{1} << 15) {
+    if (n == 0) return identity;
+    const std::size_t leaves = (n + reduce_leaf_rows - 1) / reduce_leaf_rows;
+    if (leaves == 1) return leaf(std::size_t{0}, n);
+
+    std::vector<T> partial(leaves, identity);
+    auto run = [&](std::size_t lb, std::size_t le) {
+        for (std::size_t l = lb; l < le; ++l)
+            partial[l] = leaf(l * reduce_leaf_rows, std::min(n, (l + 1) * reduce_leaf_rows));
+    };
+    if (pool) pool->parallel_for(leaves, std::max<std::size_t>(1, task_rows / reduce_leaf_rows), run);
+    else run(0, leaves);
+
+    for (std::size_t stride = 1; stride < leaves; stride *= 2) {
+        for (std::size_t l = 0; l + stride < leaves; l += 2 * stride)
+            partial[l] = combine(std::move(partial[l]), std::move(partial[l + stride]));
+    }
+    return std::move(partial[0]);
+}
+
+// Deterministic sum of leaf(begin, end) over [0, n).
+template <class Leaf>
+double deterministic_sum(std::size_t n, Leaf&& leaf, ThreadPool* pool = nullptr,
+                         std::size_t task_rows = std::size_t{1} << 15) {
+    return deterministic_reduce(n, 0.0, std::forward<Leaf>(leaf),
+                                [](double a, double b) { return a + b; }, pool, task_rows);
+}
+
+// deterministic_sum over rows that arrive in order, for running reductions.
+// Feed the sum of every completed reduce_leaf_rows-row leaf to add_leaf();
+// total() then returns what deterministic_sum gives over those leaves plus
+// an optional trailing partial leaf. The fixed tree over leaves [0, L) is a
+// right-nested sum of its aligned power-of-two blocks, largest first, so
+// only those block sums are kept: O(log L) memory and work.
+class LeafTree {
+public:
+    void add_leaf(double sum) {
+        blocks_.push_back({1, sum});
+        merge();
+    }
+
+    double total() const { return fold(blocks_); }
+    double total(double trailing) const {
+        std::vector<Block> b = blocks_;
+        b.push_back({1, trailing});
+        merge(b);
+        return fold(b);
+    }
+
+    // Completed leaves.
+    std::size_t leaves() const noexcept {
+        std::size_t n = 0;
+        for (const Block& b : blocks_) n += b.leaves;
+        return n;
+    }
+    void clear() noexcept { blocks_.clear(); }
+
+private:
+    struct Block {
+        std::size_t leaves;
+        double sum;
+    };
+
+    static void merge(std::vector<Block>& b) {
+        while (b.size() >= 2 && b[b.size() - 2].leaves == b.back().leaves) {
+            const Block right = b.back();
+            b.pop_back();
+            b.back().leaves *= 2;
+            b.back().sum = b.back().sum + right.sum;
+        }
+    }
+    void merge() { merge(blocks_); }
+
+    static double fold(const std::vector<Block>& b) {
+        if (b.empty()) return 0.0;
+        double acc = b.back().sum;
+        for (std::size_t k = b.size() - 1; k-- > 0;) acc = b[k].sum + acc;
+        return acc;
+    }
+
+    std::vector<Block> blocks_; // leaf counts strictly decreasing
+};
+
+} // namespace tsexpr
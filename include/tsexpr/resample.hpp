@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "tsexpr/compensated_sum.hpp"
+
+namespace tsexpr {
+
+// Per-bucket aggregates of a timestamped series, shared by backends that
+// implement the resample_* functions behind Op::Call.
+enum class ResampleKind {
+    First, // resample_first, resample_open
+    Last,  // resample_last, resample_close
+    Sum,   // resample_sum
+    Mean,  // resample_mean
+    Min,   // resample_min, resample_low
+    Max,   // resample_max, resample_high
+    Count, // resample_count: present rows
+};
+
+// The kind behind a function name, or nullopt for anything else.
+std::optional<ResampleKind> resample_kind(std::string_view fn) noexcept;
+
+// Start of the bucket of `width` time units holding `t`: buckets are
+// [k * width, (k + 1) * width), also for negative timestamps.
+inline std::int64_t bucket_start(std::int64_t t, std::int64_t width) noexcept {
+    const std::int64_t q = t / width;
+    return (q - (t % width < 0)) * width;
+}
+
+// One bucket's aggregate. `present` is false for a bucket whose rows were
+// all missing (Count is then 0 and present).
+struct Bar {
+    std::int64_t start{0};
+    double value{0.0};
+    bool present{false};
+};
+
+// Aggregation state of the bucket being filled, one row pushed at a time
+// with O(1) work. The same object serves a one-pass kernel over a whole
+// series and a live feed, which reads the incomplete trailing bar from
+// current() after every tick.
+//
+// Rows must come in non-decreasing timestamp order. Buckets without any row
+// produce no bar; missing rows open their bucket but are not aggregated.
+// Sums are Neumaier-compensated.
+//
+// NaN and infinities are counted apart from the running sum, as in
+// RollingWindow: a NaN makes Sum and Mean NaN, an infinity makes them
+// infinite (NaN with both signs present). As with rolling_min and
+// rolling_max, a NaN anywhere in the bucket makes Min and Max NaN, and
+// infinities take part in them like any other value.
+class BucketAggregator {
+public:
+    // Throws std::invalid_argument for width <= 0.
+    BucketAggregator(ResampleKind kind, std::int64_t width);
+
+    // Fold row (t, x). Returns the previous bar if the row opened a new
+    // bucket. Throws std::invalid_argument if t is before the last row.
+    std::optional<Bar> push(std::int64_t t, double x, bool present = true);
+
+    // The bucket being filled, or nullopt before the first row.
+    std::optional<Bar> current() const;
+
+    ResampleKind kind() const noexcept { return kind_; }
+    std::int64_t width() const noexcept { return width_; }
+    void clear() noexcept;
+
+private:
+    ResampleKind kind_;
+    std::int64_t width_;
+    bool open_{false};
+    std::int64_t start_{0}; // current bucket
+    std::int64_t last_t_{0};
+    std::size_t count_{0};  // present rows in the bucket
+    NonFiniteCount non_finite_; // of which non-finite
+    double value_{0.0};     // First, Last, Min, Max
+    CompensatedSum sum_;    // Sum, Mean
+};
+
+} // namespace tsexpr
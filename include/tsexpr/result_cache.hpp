@@ -0,0 +1,217 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/incremental.hpp"
+#include "tsexpr/program.hpp"
+
+namespace tsexpr {
+
+// Canonical encoding of what a program computes: opcodes, names, literal
+// bits and call arities. Fork/Join and shared name ids only affect how it
+// runs, so a program compiled with or without forking encodes the same.
+std::string program_canonical(const Program& program);
+
+// 64-bit hash of program_canonical().
+std::uint64_t program_hash(std::string_view canonical) noexcept;
+std::uint64_t program_hash(const Program& program);
+
+// Bounded, memory-budgeted memo of program results.
+//
+// An entry is keyed by program_hash() plus one 64-bit key per input, in
+// inputs() order: the input's version in a VersionTable, or a content hash
+// the caller computed. A miss runs the program and records every value it
+// stores; a hit replays those stores into the backend without evaluating
+// anything. A hit also compares the entry's program_canonical() with the
+// program's, so a 64-bit hash collision is a miss, not a wrong answer.
+// Entries are charged `cost(value)` bytes each and the least
+// recently used ones are evicted once the total exceeds the budget; an
+// entry larger than the whole budget is not kept. Failed runs are not
+// cached. Thread-safe: programs run outside the lock, so concurrent misses
+// on one key may both evaluate.
+//
+// Values are copied into the cache and out of it on every hit, so it suits
+// values that share their buffers (copy-on-write series, scalars).
+template <class Value>
+class ResultCache {
+public:
+    using Cost = std::function<std::size_t(const Value&)>;
+
+    struct Stats {
+        std::size_t hits{0};
+        std::size_t misses{0};
+        std::size_t evictions{0};
+        std::size_t evicted_bytes{0};
+        std::size_t entries{0};
+        std::size_t bytes{0}; // charged to the entries currently held
+
+        double hit_rate() const noexcept {
+            const std::size_t n = hits + misses;
+            return n ? double(hits) / double(n) : 0.0;
+        }
+    };
+
+    // `cost` defaults to sizeof(Value) per stored value.
+    explicit ResultCache(std::size_t budget_bytes, Cost cost = {})
+        : budget_(budget_bytes), cost_(cost ? std::move(cost) : Cost([](const Value&) { return sizeof(Value); })) {}
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Run `program` on `backend`, or replay its cached stores. `input_keys`
+    // holds one key per program.inputs() entry; throws std::invalid_argument
+    // for any other count. Returns true on a hit.
+    template <class Backend>
+    bool execute(const Program& program, Backend& backend, std::vector<std::uint64_t> input_keys) {
+        return run(program, backend, std::move(input_keys), nullptr);
+    }
+
+    // Same, keyed by the inputs' current versions in `versions`, which also
+    // versions the outputs: a miss bumps every variable the program stores
+    // and the entry keeps the versions it got, a hit restores them. Equal
+    // inputs thus give equal output versions, and programs downstream of a
+    // hit can hit too. Pass the plain backend, not a VersionedBackend.
+    template <class Backend>
+    bool execute(const Program& program, Backend& backend, VersionTable& versions) {
+        std::vector<std::uint64_t> keys;
+        for (const auto& name : program.inputs()) keys.push_back(versions.get(name));
+        return run(program, backend, std::move(keys), &versions);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mu_);
+        return stats_;
+    }
+    std::size_t budget() const noexcept { return budget_; }
+
+    // Drop every entry and reset the statistics.
+    void clear() {
+        std::lock_guard<std::mutex> lock(mu_);
+        entries_.clear();
+        lru_.clear();
+        stats_ = Stats{};
+    }
+
+private:
+    using Key = std::pair<std::uint64_t, std::vector<std::uint64_t>>;
+    using Stores = std::vector<std::pair<std::string, Value>>;
+    struct Entry {
+        std::string program; // program_canonical()
+        Stores stores;
+        std::vector<std::uint64_t> versions; // per store, when run with a VersionTable
+        std::size_t bytes;
+        typename std::list<const Key*>::iterator lru;
+    };
+
+    // Forwards to the backend and keeps a copy of every stored value.
+    template <class Backend>
+    class Recorder {
+    public:
+        Recorder(Backend& b, Stores& out) : b_(b), out_(out) {}
+
+        decltype(auto) load_var(std::string_view name) { return b_.load_var(name); }
+        template <class V>
+        void store_var(std::string_view name, V&& v) {
+            out_.emplace_back(std::string(name), v);
+            b_.store_var(name, std::forward<V>(v));
+        }
+        template <class... A> decltype(auto) make_number(A&&... a) { return b_.make_number(std::forward<A>(a)...); }
+        template <class... A> decltype(auto) neg(A&&... a) { return b_.neg(std::forward<A>(a)...); }
+        template <class... A> decltype(auto) binary(A&&... a) { return b_.binary(std::forward<A>(a)...); }
+        template <class... A> decltype(auto) call(A&&... a) { return b_.call(std::forward<A>(a)...); }
+
+    private:
+        Backend& b_;
+        Stores& out_;
+    };
+
+    template <class Backend>
+    bool run(const Program& program, Backend& backend, std::vector<std::uint64_t> input_keys, VersionTable* versions);
+    void insert(Key key, Entry entry);
+
+    mutable std::mutex mu_;
+    std::size_t budget_;
+    Cost cost_;
+    std::map<Key, Entry> entries_;
+    std::list<const Key*> lru_; // front = most recently used
+    Stats stats_{};
+};
+
+template <class Value>
+template <class Backend>
+bool ResultCache<Value>::run(const Program& program, Backend& backend, std::vector<std::uint64_t> input_keys,
+                             VersionTable* versions) {
+    if (input_keys.size() != program.inputs().size())
+        throw std::invalid_argument("ResultCache: expected one input key per program input");
+    std::string canonical = program_canonical(program);
+    Key key{program_hash(canonical), std::move(input_keys)};
+    Entry replay;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.program == canonical) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            ++stats_.hits;
+            replay.stores = it->second.stores;
+            replay.versions = it->second.versions;
+            hit = true;
+        } else {
+            ++stats_.misses;
+        }
+    }
+    if (hit) {
+        for (std::size_t i = 0; i < replay.stores.size(); ++i) {
+            auto& [name, value] = replay.stores[i];
+            backend.store_var(name, std::move(value));
+            if (versions) versions->set(name, replay.versions[i]);
+        }
+        return true;
+    }
+
+    Entry entry;
+    entry.program = std::move(canonical);
+    Recorder<Backend> recorder(backend, entry.stores);
+    program.execute(recorder);
+    if (versions) {
+        for (const auto& kv : entry.stores) entry.versions.push_back(versions->bump(kv.first));
+    }
+    insert(std::move(key), std::move(entry));
+    return false;
+}
+
+template <class Value>
+void ResultCache<Value>::insert(Key key, Entry entry) {
+    std::size_t bytes = 0;
+    for (const auto& kv : entry.stores) bytes += kv.first.size() + cost_(kv.second);
+    entry.bytes = bytes;
+
+    std::lock_guard<std::mutex> lock(mu_);
+    // A colliding key keeps the entry it has.
+    if (bytes > budget_ || entries_.count(key)) return;
+    while (stats_.bytes + bytes > budget_) {
+        auto victim = entries_.find(*lru_.back());
+        stats_.bytes -= victim->second.bytes;
+        stats_.evicted_bytes += victim->second.bytes;
+        ++stats_.evictions;
+        lru_.pop_back();
+        entries_.erase(victim);
+    }
+    auto [it, inserted] = entries_.emplace(std::move(key), std::move(entry));
+    (void)inserted;
+    lru_.push_front(&it->first);
+    it->second.lru = lru_.begin();
+    stats_.bytes += bytes;
+    stats_.entries = entries_.size();
+}
+
+} // namespace tsexpr
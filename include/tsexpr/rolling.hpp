@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/compensated_sum.hpp"
+
+namespace tsexpr {
+
+// Trailing-window statistics, shared by backends that implement the
+// rolling_* functions behind Op::Call.
+enum class RollingKind {
+    Sum,  // rolling_sum
+    Mean, // rolling_mean
+    Std,  // rolling_std (sample, n - 1)
+    Min,  // rolling_min
+    Max,  // rolling_max
+};
+
+// The kind behind a function name, or nullopt for anything else.
+std::optional<RollingKind> rolling_kind(std::string_view fn) noexcept;
+
+// Sliding state over the last `window` rows, one row pushed at a time with
+// O(1) amortized work: sums use Neumaier-compensated add/remove, the
+// standard deviation a sliding Welford update, and min/max a monotonic
+// deque. The same object serves a one-pass kernel over a whole series and a
+// live feed that pushes rows as they arrive.
+//
+// Missing rows take their slot in the window but are not counted. A value is
+// defined once `window` rows have been pushed and the window holds at least
+// one present row (two for Std).
+//
+// NaN and infinities are counted apart from the running state, so they only
+// affect the windows that hold them, as in a from-scratch pass: a NaN makes
+// every statistic NaN; an infinity makes Sum and Mean infinite (NaN with
+// both signs present) and Std NaN, and takes part in Min and Max.
+class RollingWindow {
+public:
+    // Throws std::invalid_argument for window == 0.
+    RollingWindow(RollingKind kind, std::size_t window);
+
+    // Slide row `x` (missing if !present) into the window. Returns the
+    // statistic over the window ending at it, or nullopt if undefined.
+    std::optional<double> push(double x, bool present = true);
+
+    RollingKind kind() const noexcept { return kind_; }
+    std::size_t window() const noexcept { return window_; }
+    // Rows pushed since construction or clear().
+    std::size_t rows() const noexcept { return rows_; }
+    void clear();
+
+private:
+    void add(double x);
+    void remove(double x);
+    std::size_t finite() const noexcept { return count_ - non_finite_.total(); }
+
+    RollingKind kind_;
+    std::size_t window_;
+    std::vector<double> ring_;           // last `window` rows
+    std::vector<unsigned char> present_; // and whether each one is present
+    std::size_t rows_{0};
+    std::size_t count_{0}; // present rows in the window
+    NonFiniteCount non_finite_; // of which non-finite
+
+    CompensatedSum sum_;                  // Sum, Mean
+    double mean_{0.0}, m2_{0.0};          // Std
+    std::deque<std::pair<std::size_t, double>> extrema_; // Min, Max: (row, value), monotonic
+};
+
+} // namespace tsexpr
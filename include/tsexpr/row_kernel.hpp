@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+
+namespace tsexpr {
+
+// A one-statement Program compiled for evaluation one row at a time.
+//
+// Inputs become slots: the row's value of inputs()[i] is read from
+// slots[i], and operator() returns the value the statement would store in
+// target(). Evaluation is a switch over a flat array of steps on a
+// fixed-size stack: no allocation, no variant and no virtual dispatch, so a
+// tick costs tens of nanoseconds. A literal or load feeding the right-hand
+// side of an arithmetic op is folded into it.
+//
+// Only what is defined row by row compiles: loads, literals, + - * /, unary
+// minus and float32/float64. Other calls, programs deeper than max_depth,
+// and anything but exactly one Store at the end throw EvalError. Missing
+// values are the caller's to encode (NaN propagates).
+//
+// Slots are float64 series rows, and precision follows the TimeSeries
+// rules: float32() of a series rounds it to single precision, and F32 op
+// F32 or F32 op literal is computed in float; anything with an F64 operand
+// widens to double. Casting a literal leaves it unchanged. Each step's
+// precision is fixed when the kernel is compiled, so a row returns exactly
+// what execute_assignment stores for it.
+class RowKernel {
+public:
+    static constexpr std::size_t max_depth = 64;
+
+    explicit RowKernel(const Program& program);
+
+    const std::vector<std::string>& inputs() const noexcept { return inputs_; }
+    const std::string& target() const noexcept { return target_; }
+
+    // Evaluate one row; slots[i] holds inputs()[i]. Thread-safe.
+    double operator()(const double* slots) const noexcept;
+
+private:
+    enum class Kind : std::uint8_t { Load, Const, Add, Sub, Mul, Div, Neg, Float32 };
+    // Where a binary step's right operand comes from.
+    enum class Rhs : std::uint8_t { Stack, Slot, Const };
+    struct Step {
+        Kind kind;
+        Rhs rhs;
+        bool single;        // Add/Sub/Mul/Div: computed in float
+        std::uint32_t slot; // Load, or Rhs::Slot
+        double number;      // Const, or Rhs::Const
+    };
+
+    template <class T>
+    static T arith(Kind kind, T a, T b) noexcept {
+        switch (kind) {
+            case Kind::Add: return a + b;
+            case Kind::Sub: return a - b;
+            case Kind::Mul: return a * b;
+            default: return a / b;
+        }
+    }
+
+    std::vector<Step> steps_;
+    std::vector<std::string> inputs_;
+    std::string target_;
+};
+
+inline double RowKernel::operator()(const double* slots) const noexcept {
+    double st[max_depth];
+    std::size_t top = 0; // st[top - 1] is the top of the stack
+    for (const Step& s : steps_) {
+        double b = 0.0;
+        switch (s.kind) {
+            case Kind::Load: st[top++] = slots[s.slot]; continue;
+            case Kind::Const: st[top++] = s.number; continue;
+            case Kind::Neg: st[top - 1] = -st[top - 1]; continue;
+            case Kind::Float32: st[top - 1] = double(float(st[top - 1])); continue;
+            default: break;
+        }
+        switch (s.rhs) {
+            case Rhs::Stack: b = st[--top]; break;
+            case Rhs::Slot: b = slots[s.slot]; break;
+            case Rhs::Const: b = s.number; break;
+        }
+        double& a = st[top - 1];
+        a = s.single ? double(arith<float>(s.kind, float(a), float(b))) : arith<double>(s.kind, a, b);
+    }
+    return st[0];
+}
+
+} // namespace tsexpr
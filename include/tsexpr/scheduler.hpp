@@ -0,0 +1,144 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+#include "tsexpr/thread_pool.hpp"
+
+namespace tsexpr {
+
+// Read/write dependency DAG over a batch of statements.
+//
+// Statement j depends on an earlier statement i when j reads a variable i
+// writes (read-after-write), writes a variable i reads (write-after-read),
+// or writes a variable i writes (write-after-write). Any topological order
+// of this DAG therefore computes the same values as running the statements
+// in batch order.
+class DependencyGraph {
+public:
+    // Append a statement that reads `reads` and writes `writes`.
+    void add(const std::vector<std::string>& reads, const std::vector<std::string>& writes);
+
+    // One statement per program: PushVar operands are reads, Store targets writes.
+    static DependencyGraph from_programs(const std::vector<Program>& programs);
+
+    std::size_t size() const noexcept { return nodes_.size(); }
+    const std::vector<std::size_t>& successors(std::size_t i) const { return nodes_.at(i).succ; }
+    std::size_t predecessor_count(std::size_t i) const { return nodes_.at(i).preds; }
+
+    // Call fn(i) for every statement, starting each as soon as all of its
+    // predecessors have finished, on `pool` (the caller helps). fn must be
+    // safe to call concurrently for independent statements.
+    //
+    // If a statement throws, statements after it in batch order are no
+    // longer started (those already running finish) and the exception of
+    // the earliest failing statement is rethrown: the one a serial run
+    // would have stopped at.
+    template <class Fn>
+    void run(ThreadPool& pool, Fn&& fn) const;
+
+private:
+    struct Node {
+        std::vector<std::size_t> succ;
+        std::size_t preds{0};
+    };
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+    struct VarState {
+        std::size_t writer{npos};         // last writer
+        std::vector<std::size_t> readers; // readers since that write
+    };
+
+    void add_edge(std::size_t from, std::size_t to);
+
+    std::vector<Node> nodes_;
+    std::map<std::string, VarState, std::less<>> vars_;
+};
+
+// Serializes variable access on a backend so independent programs can run on
+// several threads: load_var takes a shared lock, store_var an exclusive one.
+// The value operations (make_number, neg, binary, call) are forwarded
+// unlocked and must themselves be thread-safe.
+template <class Backend>
+class SynchronizedBackend {
+public:
+    explicit SynchronizedBackend(Backend& backend) : b_(backend) {}
+
+    decltype(auto) load_var(std::string_view name) {
+        std::shared_lock<std::shared_mutex> lock(mu_);
+        return b_.load_var(name);
+    }
+
+    template <class V>
+    void store_var(std::string_view name, V&& v) {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        b_.store_var(name, std::forward<V>(v));
+    }
+
+    template <class... A> decltype(auto) make_number(A&&... a) { return b_.make_number(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) neg(A&&... a) { return b_.neg(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) binary(A&&... a) { return b_.binary(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) call(A&&... a) { return b_.call(std::forward<A>(a)...); }
+
+private:
+    Backend& b_;
+    std::shared_mutex mu_;
+};
+
+// Execute a batch of programs with the same results as running them in
+// order, but with independent programs running concurrently on `pool`.
+template <class Backend>
+void execute_parallel(const std::vector<Program>& programs, Backend& backend,
+                      ThreadPool& pool = default_thread_pool()) {
+    const DependencyGraph graph = DependencyGraph::from_programs(programs);
+    SynchronizedBackend<Backend> sync(backend);
+    graph.run(pool, [&](std::size_t i) { programs[i].execute(sync); });
+}
+
+template <class Fn>
+void DependencyGraph::run(ThreadPool& pool, Fn&& fn) const {
+    const std::size_t n = nodes_.size();
+    if (n == 0) return;
+
+    std::unique_ptr<std::atomic<std::size_t>[]> waiting(new std::atomic<std::size_t>[n]);
+    for (std::size_t i = 0; i < n; ++i) waiting[i].store(nodes_[i].preds);
+
+    // Once a statement fails, only earlier statements are still started:
+    // they would have run before it serially and may fail first.
+    std::atomic<std::size_t> err_at{n};
+    std::mutex err_mu;
+    std::exception_ptr err;
+
+    TaskGroup group(pool);
+    // Each task schedules the successors it makes ready, so the group stays
+    // non-empty until the last reachable statement has finished.
+    auto launch = [&](std::size_t i, auto& self) -> void {
+        group.run([&, i] {
+            if (i > err_at.load()) return;
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(err_mu);
+                if (i < err_at.load()) { err_at.store(i); err = std::current_exception(); }
+                return;
+            }
+            for (std::size_t s : nodes_[i].succ)
+                if (waiting[s].fetch_sub(1) == 1) self(s, self);
+        });
+    };
+    for (std::size_t i = 0; i < n; ++i)
+        if (nodes_[i].preds == 0) launch(i, launch);
+    group.wait();
+    if (err) std::rethrow_exception(err);
+}
+
+} // namespace tsexpr
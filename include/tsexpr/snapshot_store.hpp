@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tsexpr/program.hpp"
+
+namespace tsexpr {
+
+// Variable store that readers can evaluate against while a writer publishes.
+//
+// The variables live in an immutable map held by shared_ptr. snapshot()
+// grabs the current map, so one execution sees a single consistent version
+// however many writes land meanwhile. Writers copy the map, apply their
+// changes, and swap the new version in atomically. Readers never wait for
+// that copy. Old versions are freed when their last snapshot is dropped,
+// which is the read-copy-update scheme with reference counts as the grace
+// period.
+//
+// Each publish copies the map (values are copied, so cheap-to-copy values
+// such as shared-buffer series keep it O(variables)). Batch related updates
+// into one publish(): they become visible together.
+template <class Value>
+class SnapshotStore {
+public:
+    using Map = std::map<std::string, Value>;
+
+    class Snapshot {
+    public:
+        Snapshot() = default;
+        Snapshot(std::shared_ptr<const Map> vars, std::uint64_t version)
+            : vars_(std::move(vars)), version_(version) {}
+
+        const Map& vars() const noexcept { return *vars_; }
+        std::uint64_t version() const noexcept { return version_; }
+
+        // Null when the variable does not exist in this version.
+        const Value* find(std::string_view name) const {
+            auto it = vars_->find(std::string(name));
+            return it == vars_->end() ? nullptr : &it->second;
+        }
+
+    private:
+        std::shared_ptr<const Map> vars_ = std::make_shared<const Map>();
+        std::uint64_t version_{0};
+    };
+
+    SnapshotStore() = default;
+    explicit SnapshotStore(Map initial) : current_(std::make_shared<const Version>(Version{std::move(initial), 0})) {}
+
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    Snapshot snapshot() const {
+        std::shared_ptr<const Version> v = std::atomic_load(&current_);
+        return Snapshot(std::shared_ptr<const Map>(v, &v->vars), v->version);
+    }
+
+    std::uint64_t version() const { return std::atomic_load(&current_)->version; }
+
+    void store(std::string_view name, Value value) {
+        std::vector<std::pair<std::string, Value>> one;
+        one.emplace_back(std::string(name), std::move(value));
+        publish(std::move(one));
+    }
+
+    // Apply every update in one new version. Returns its number.
+    std::uint64_t publish(std::vector<std::pair<std::string, Value>> updates) {
+        std::lock_guard<std::mutex> lock(write_mu_); // writers queue; readers do not
+        const std::shared_ptr<const Version> old = std::atomic_load(&current_);
+        auto next = std::make_shared<Version>(Version{old->vars, old->version + 1});
+        for (auto& [name, value] : updates) next->vars.insert_or_assign(std::move(name), std::move(value));
+        std::atomic_store(&current_, std::shared_ptr<const Version>(std::move(next)));
+        return old->version + 1;
+    }
+
+    // Remove a variable (no-op if missing). Returns the new version.
+    std::uint64_t erase(std::string_view name) {
+        std::lock_guard<std::mutex> lock(write_mu_);
+        const std::shared_ptr<const Version> old = std::atomic_load(&current_);
+        auto next = std::make_shared<Version>(Version{old->vars, old->version + 1});
+        next->vars.erase(std::string(name));
+        std::atomic_store(&current_, std::shared_ptr<const Version>(std::move(next)));
+        return old->version + 1;
+    }
+
+private:
+    struct Version {
+        Map vars;
+        std::uint64_t version;
+    };
+
+    std::shared_ptr<const Version> current_ = std::make_shared<const Version>(Version{Map{}, 0});
+    std::mutex write_mu_;
+};
+
+// Backend adapter for Program::execute against one snapshot: loads come from
+// the snapshot, stores are published to the store. Value operations go to
+// `ops`, any object with the backend's make_number/neg/binary/call.
+template <class Value, class Ops>
+class SnapshotBackend {
+public:
+    SnapshotBackend(SnapshotStore<Value>& store, Ops& ops) : store_(store), ops_(ops), snap_(store.snapshot()) {}
+
+    const typename SnapshotStore<Value>::Snapshot& snapshot() const noexcept { return snap_; }
+
+    Value load_var(std::string_view name) const {
+        const Value* v = snap_.find(name);
+        if (!v) throw EvalError("Unknown variable: " + std::string(name));
+        return *v;
+    }
+    void store_var(std::string_view name, Value v) { store_.store(name, std::move(v)); }
+
+    template <class... A> decltype(auto) make_number(A&&... a) { return ops_.make_number(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) neg(A&&... a) { return ops_.neg(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) binary(A&&... a) { return ops_.binary(std::forward<A>(a)...); }
+    template <class... A> decltype(auto) call(A&&... a) { return ops_.call(std::forward<A>(a)...); }
+
+private:
+    SnapshotStore<Value>& store_;
+    Ops& ops_;
+    typename SnapshotStore<Value>::Snapshot snap_;
+};
+
+} // namespace tsexpr
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tsexpr/ewm.hpp>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/reduce.hpp>
+#include <tsexpr/resample.hpp>
+
+namespace ts::expr {
+
+/// Append-mode evaluation of one row-local assignment, e.g.
+/// `z = a + b - c / 2`. Each update() evaluates only the input rows that
+/// arrived since the previous update (the high-water mark) and appends them
+/// to the target in the Env, so a tick costs O(new rows) rather than
+/// O(history).
+///
+/// Row-local means built from +, -, *, /, unary minus, literals and the
+/// float32/float64 casts. rolling_* calls with a literal window are allowed
+/// too: the new rows are then evaluated together with the window - 1 rows
+/// before them (summed over nested calls). So are ewma/ewvar/filter calls
+/// with a literal parameter and a row-local argument: each keeps its
+/// tsexpr::EwmFilter state between updates, so a tick costs O(1) per filter
+/// rather than a replay of the history. Compiling anything else (e.g.
+/// sumproduct, or a rolling window over a filter) throws ParseError. Inputs
+/// must have equal lengths; timestamped inputs must agree on the timestamps
+/// of the new rows, and the target takes the index of the first timestamped
+/// input.
+///
+/// The target grows in place (TimeSeries::append), so a tick costs
+/// amortized O(new rows) including its validity bitmap and index. A full
+/// recompute happens instead when an input got shorter than the high-water
+/// mark or was rewritten, or the target is no longer the series this object
+/// wrote, as told by their TimeSeries::generation(). Grow inputs with
+/// TimeSeries::append() to keep updates incremental.
+class StreamingAssignment {
+public:
+    explicit StreamingAssignment(std::string_view input);
+
+    /// Bring the target up to date. Returns the number of rows evaluated.
+    std::size_t update(Env& env);
+
+    const std::string& target() const noexcept { return c_.target; }
+    const std::vector<std::string>& inputs() const noexcept { return inputs_; }
+    /// Input rows already reflected in the target.
+    std::size_t high_water() const noexcept { return high_water_; }
+    /// Forget the high-water mark; the next update() recomputes everything.
+    void reset() noexcept { high_water_ = 0; }
+
+    /// Rows of history the rolling calls need before the first new row.
+    std::size_t lookback() const noexcept { return lookback_; }
+    /// The step under update(): evaluate the statement over `rows` (the
+    /// inputs, unindexed and of equal length), whose first `context` rows
+    /// are history for the rolling windows, and return the rows after them.
+    /// Advances the recursive filters past the returned rows.
+    TimeSeries evaluate_rows(Env rows, std::size_t context);
+    /// Restart the recursive filters from an empty history.
+    void clear_filters() noexcept;
+
+private:
+    // A recursive filter call, evaluated outside the RPN with carried state.
+    struct Recursive {
+        std::vector<Token> arg;    // its series argument (RPN)
+        tsexpr::EwmFilter filter;
+        std::string name;          // variable standing in for it in c_.rpn
+        std::size_t token;         // its position in the compiled statement
+    };
+
+    Compiled c_;
+    std::vector<Recursive> recursive_;
+    std::vector<std::string> inputs_;
+    std::size_t lookback_{0}; // history rows the rolling calls need
+    std::size_t high_water_{0};
+    std::uint64_t target_generation_{0};     // of the target as last written
+    std::vector<std::uint64_t> generations_; // per input, as of high_water_
+};
+
+/// Incremental evaluation of a reduction over growing inputs, e.g.
+/// `s = sumproduct(a, b)` or `beta = sumproduct(x, y) / sumproduct(x, x)`.
+/// The high-water mark counts the rows folded in so far; update() folds in
+/// only the rows that arrived since the previous update and stores the
+/// result as a length-1 series, like execute_assignment.
+///
+/// Every sumproduct call sums the way the one-shot sumproduct does (see
+/// tsexpr::deterministic_sum): it keeps the sums of its completed
+/// reduce_leaf_rows-row leaves in a tsexpr::LeafTree, plus the leaf
+/// kernel's running accumulators for the trailing partial leaf, which new
+/// rows extend; the kernel's final combine runs on a copy of them when the
+/// result is taken. So results are bit-identical to the one-shot ones
+/// however the rows are split, at O(new rows) per update.
+///
+/// sumproduct arguments must be row-local (see StreamingAssignment); outside
+/// the sumproduct calls only literals and arithmetic are allowed. Inputs
+/// follow the StreamingAssignment rules (equal lengths, agreeing timestamps).
+///
+/// The running sums are tied to the input history they were built from,
+/// identified by each input's TimeSeries::generation(). An input that got
+/// shorter or has another generation was rewritten, and update() starts
+/// over from row 0; grow inputs with TimeSeries::append() to keep updates
+/// incremental.
+class StreamingReduction {
+public:
+    explicit StreamingReduction(std::string_view input);
+    StreamingReduction(const StreamingReduction&);
+    StreamingReduction(StreamingReduction&&) noexcept;
+    StreamingReduction& operator=(const StreamingReduction&);
+    StreamingReduction& operator=(StreamingReduction&&) noexcept;
+    ~StreamingReduction();
+
+    /// Bring the target up to date. Returns the number of rows folded in.
+    std::size_t update(Env& env);
+
+    const std::string& target() const noexcept { return target_; }
+    const std::vector<std::string>& inputs() const noexcept { return inputs_; }
+    /// Input rows already folded into the running sums.
+    std::size_t high_water() const noexcept { return high_water_; }
+    /// Updates that folded from row 0: the first, and any after reset() or
+    /// rewritten history.
+    std::size_t recomputes() const noexcept { return recomputes_; }
+    /// Drop the running state; the next update() recomputes everything.
+    void reset() noexcept { high_water_ = 0; }
+
+    /// The steps under update(): add `rows` (the inputs, unindexed and of
+    /// equal length, following the rows folded so far) to the running sums,
+    /// evaluate the statement on the sums, and restart them from zero.
+    void fold(const Env& rows);
+    double result();
+    void clear_sums() noexcept;
+
+private:
+    struct Site; // one sumproduct call in the statement
+
+    std::string target_;
+    std::vector<Token> outer_; // statement with each sumproduct replaced by a Number
+    std::vector<Site> sites_;
+    std::vector<std::string> inputs_;
+    std::vector<std::uint64_t> generations_; // per input, as of high_water_
+    std::size_t high_water_{0};
+    std::size_t recomputes_{0};
+};
+
+/// Live resampling of one timestamped input into bars, e.g.
+/// `bar = resample_last(px, 1000)`. The statement must be a single
+/// resample_* call on a variable with a literal width; anything else throws
+/// ParseError.
+///
+/// update() folds only the input rows that arrived since the previous
+/// update into a carried tsexpr::BucketAggregator, rewrites the target's
+/// trailing bar in place and appends any buckets the rows opened
+/// (TimeSeries::append), so a tick costs amortized O(1) plus O(new bars),
+/// index and validity bitmap included. The target always equals resample()
+/// over the whole input.
+///
+/// A full recompute happens instead when the input got shorter than the
+/// high-water mark or was rewritten, or the target is no longer the series
+/// this object wrote, as told by their TimeSeries::generation(). Grow the
+/// input with TimeSeries::append() to keep updates incremental.
+class StreamingResample {
+public:
+    explicit StreamingResample(std::string_view input);
+
+    /// Bring the target up to date. Returns the number of rows folded in.
+    std::size_t update(Env& env);
+
+    const std::string& target() const noexcept { return target_; }
+    const std::string& input() const noexcept { return input_; }
+    /// Input rows already folded into the bars.
+    std::size_t high_water() const noexcept { return high_water_; }
+    /// Forget the high-water mark; the next update() recomputes everything.
+    void reset() noexcept { high_water_ = 0; }
+
+private:
+    explicit StreamingResample(const Compiled& c);
+
+    std::string target_;
+    std::string input_;
+    tsexpr::BucketAggregator agg_;
+    std::size_t high_water_{0};
+    std::uint64_t generation_{0};        // of the input, as of high_water_
+    std::uint64_t target_generation_{0}; // of the target as last written
+};
+
+/// One input's rows in order, a chunk at a time: each call returns the next
+/// chunk, or nullopt once the input is exhausted.
+using ChunkReader = std::function<std::optional<TimeSeries>()>;
+/// Opens a reader at the first row of the named input.
+using ChunkSource = std::function<ChunkReader(const std::string& name)>;
+/// Receives output rows in order.
+using ChunkSink = std::function<void(TimeSeries rows)>;
+
+/// Out-of-core evaluation of one statement over inputs too long to hold in
+/// memory. The source supplies every input as a chunk reader; run() streams
+/// them in lockstep, never holding more than one chunk per input plus the
+/// rolling windows' lookback, and evaluates at most `max_chunk_rows` rows at
+/// a time.
+///
+/// A statement accepted by StreamingAssignment writes each evaluated slice
+/// to the sink as it goes, timestamped like the first timestamped input. One
+/// accepted by StreamingReduction folds every slice into its running sums
+/// and hands the sink a single length-1 series at the end. Either way the
+/// rows match evaluating the statement over the whole inputs at once; a
+/// reduction sums on the same fixed leaf tree, so bit for bit.
+///
+/// Inputs may be cut into chunks at different rows, but must end together
+/// and agree on the timestamps row by row; otherwise run() throws
+/// EvalError. Statements that are neither row-local nor reductions throw
+/// ParseError at construction.
+class ChunkedEvaluation {
+public:
+    /// Throws std::invalid_argument for max_chunk_rows == 0.
+    explicit ChunkedEvaluation(std::string_view input, std::size_t max_chunk_rows = std::size_t{1} << 16);
+
+    const std::string& target() const noexcept;
+    const std::vector<std::string>& inputs() const noexcept;
+    bool is_reduction() const noexcept { return reduction_.has_value(); }
+
+    /// Stream the inputs from their first row to their end. Returns the
+    /// number of rows evaluated.
+    std::size_t run(const ChunkSource& source, const ChunkSink& sink);
+
+private:
+    std::optional<StreamingAssignment> assignment_;
+    std::optional<StreamingReduction> reduction_;
+    std::size_t max_chunk_rows_;
+};
+
+} // namespace ts::expr
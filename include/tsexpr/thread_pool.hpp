@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tsexpr {
+
+// Work-stealing thread pool.
+//
+// Each worker owns a deque: it pushes and pops its own tasks at the back
+// (LIFO, cache-warm) and steals from the front of other workers' deques when
+// it runs dry. Tasks submitted from outside the pool go to a shared injection
+// queue. Threads that wait on a TaskGroup run pending tasks while they wait,
+// so nested parallelism (a task that itself waits on subtasks) cannot
+// deadlock the pool.
+class ThreadPool {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // threads == 0 picks std::thread::hardware_concurrency().
+    explicit ThreadPool(std::size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    // Queue a task. From a worker of this pool it goes to that worker's deque.
+    void submit(std::function<void()> task);
+
+    // Index of the calling thread among this pool's workers, or npos.
+    std::size_t worker_index() const noexcept;
+
+    // Run one queued task on the calling thread. False if none was found.
+    bool run_pending_task();
+
+    // Split [0, n) into ceil(n / grain) fixed chunks and call body(begin, end)
+    // for each, on up to size() workers plus the calling thread. Chunk
+    // boundaries depend only on n and grain. Runs inline when there is a
+    // single chunk. Rethrows the first exception thrown by body.
+    template <class Body>
+    void parallel_for(std::size_t n, std::size_t grain, Body&& body);
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool try_pop(std::size_t self, std::function<void()>& out);
+    void worker_loop(std::size_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues_; // one per worker
+    Queue injection_;
+    std::vector<std::thread> workers_;
+
+    std::mutex sleep_mu_;
+    std::condition_variable sleep_cv_;
+    std::atomic<std::size_t> pending_{0}; // counted before a task is queued
+    bool stop_{false};
+};
+
+// A set of tasks to wait for. wait() helps run queued tasks, then blocks
+// until every task of the group has finished, and rethrows the first
+// exception any of them threw. The destructor waits (and swallows errors).
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    struct State {
+        std::mutex mu;
+        std::condition_variable cv;
+        std::size_t outstanding{0};
+        std::exception_ptr error;
+    };
+
+    ThreadPool& pool_;
+    std::shared_ptr<State> st_ = std::make_shared<State>();
+};
+
+// Process-wide pool owned by the library (used by the series kernels).
+// Created on first use with set_default_thread_count()'s value.
+ThreadPool& default_thread_pool();
+
+// Resize the default pool; 0 = hardware_concurrency(). Must not be called
+// while work is running on the default pool.
+void set_default_thread_count(std::size_t threads);
+
+template <class Body>
+void ThreadPool::parallel_for(std::size_t n, std::size_t grain, Body&& body) {
+    if (n == 0) return;
+    if (grain == 0) grain = 1;
+    const std::size_t chunks = (n + grain - 1) / grain;
+    if (chunks == 1 || workers_.empty()) {
+        for (std::size_t c = 0; c < chunks; ++c) body(c * grain, std::min(n, (c + 1) * grain));
+        return;
+    }
+
+    // Helpers and the caller pull chunk numbers from a shared counter, so
+    // fast threads take more chunks and no per-chunk task is allocated.
+    std::atomic<std::size_t> next{0};
+    auto drain = [&] {
+        for (std::size_t c; (c = next.fetch_add(1)) < chunks;)
+            body(c * grain, std::min(n, (c + 1) * grain));
+    };
+
+    TaskGroup group(*this);
+    const std::size_t helpers = std::min(chunks - 1, workers_.size());
+    for (std::size_t h = 0; h < helpers; ++h) group.run(drain);
+    std::exception_ptr caller_error;
+    try {
+        drain();
+    } catch (...) {
+        caller_error = std::current_exception();
+        next.store(chunks); // stop handing out chunks
+    }
+    group.wait();
+    if (caller_error) std::rethrow_exception(caller_error);
+}
+
+} // namespace tsexpr
@@ -1,39 +1,320 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 #include <stdexcept>
 
+#include <tsexpr/alignment.hpp>
+#include <tsexpr/bitmap.hpp>
+#include <tsexpr/ewm.hpp>
+#include <tsexpr/resample.hpp>
+#include <tsexpr/rolling.hpp>
+
 namespace ts::expr {
 
+/// Element type of a series' storage.
+enum class DType : unsigned char {
+    F64,
+    F32,
+};
+
 /// A tiny stub TimeSeries used for tests and examples.
 /// Replace with your real time series type + alignment semantics.
-struct TimeSeries {
-    std::vector<double> v;
-
+///
+/// Values live in a reference-counted buffer that is shared between copies.
+/// Copying a series (e.g. loading it out of an Env) is O(1); the buffer is
+/// only duplicated when a shared series is written (copy-on-write).
+///
+/// Storage is either double (F64, the default) or float (F32). Mixed-precision
+/// rules used by the operators below:
+///   - F32 op F32     -> F32
+///   - F32 op F64     -> F64 (the f32 side is widened on load)
+///   - F32 op scalar  -> F32 (the scalar is rounded to float)
+///   - sumproduct always accumulates in double.
+///
+/// A series may carry a timestamp index (int64 nanoseconds, strictly
+/// increasing). When both operands of a TS op TS are indexed with different
+/// index buffers they are inner-joined on timestamps first; the join plan is
+/// cached per pair of index buffers (see AlignmentCache), and series that
+/// share an index buffer skip the join entirely. Unindexed series keep the
+/// positional same-size rule.
+///
+/// A series can be a view: a window of rows into a buffer it shares with
+/// other series (slice(), lag()). Kernels read views through f64()/f32()
+/// without copying; writing one copies its rows out first.
+///
+/// Positional series have an origin(), the position of row 0, which lag()
+/// shifts. Within one expression, a positional operand lag() shifted (or a
+/// result computed from one) is lined up with the other operand by
+/// position, and only the positions both cover are kept, as in an inner
+/// join (x - lag(x, 1) has size() - 1 rows). Assigning a result to a
+/// variable drops the shift, so stored series follow the same-size rule.
+///
+/// Missing observations are tracked by an optional validity bitmap rather
+/// than NaN. A series without a bitmap has no nulls; a series with one always
+/// has at least one null (all-set bitmaps are dropped), so kernels only need a
+/// pointer test to take the no-nulls fast path. Elementwise ops AND the input
+/// bitmaps word-wide; the values in null slots are unspecified.
+///
+/// Every series carries a generation(). Building a series, or changing its
+/// rows any way but append(), hands out a fresh one; copies share it. Two
+/// series with the same generation therefore agree on the rows both hold,
+/// which lets incremental consumers tell an appended input from a rewritten
+/// one without comparing rows.
+class TimeSeries {
+public:
     TimeSeries() = default;
-    explicit TimeSeries(std::vector<double> values) : v(std::move(values)) {}
+    explicit TimeSeries(std::vector<double> values)
+        : f64_(std::make_shared<std::vector<double>>(std::move(values))) {}
+    explicit TimeSeries(std::vector<float> values)
+        : f32_(std::make_shared<std::vector<float>>(std::move(values))), dtype_(DType::F32) {}
+
+    /// Timestamped series. Throws if the index is not strictly increasing or
+    /// its length differs from the values.
+    TimeSeries(TimeIndex index, std::vector<double> values);
+    TimeSeries(TimeIndex index, std::vector<float> values);
 
     /// Convenience for tests: represent a scalar as a length-1 series.
     /// Real implementations might store scalars separately; adapt as needed.
-    static TimeSeries from_scalar(double x) { return TimeSeries{{x}}; }
+    static TimeSeries from_scalar(double x) { return TimeSeries{std::vector<double>{x}}; }
+
+    DType dtype() const noexcept { return dtype_; }
+
+    std::size_t size() const noexcept {
+        if (len_ != whole) return len_;
+        if (dtype_ == DType::F32) return f32_ ? f32_->size() - offset_ : 0;
+        return f64_ ? f64_->size() - offset_ : 0;
+    }
+
+    /// Raw element pointers; null when the series has the other dtype.
+    const double* f64() const noexcept { return f64_ ? f64_->data() + offset_ : nullptr; }
+    const float* f32() const noexcept { return f32_ ? f32_->data() + offset_ : nullptr; }
+
+    /// Element access for either dtype, widened to double.
+    double operator[](std::size_t i) const {
+        return dtype_ == DType::F32 ? static_cast<double>((*f32_)[offset_ + i]) : (*f64_)[offset_ + i];
+    }
+
+    /// Read-only view of F64 values. Never copies. Throws for F32 series and
+    /// for views (use f64() and size(), or compact()).
+    const std::vector<double>& values() const {
+        static const std::vector<double> empty;
+        if (dtype_ != DType::F64) throw std::logic_error("TimeSeries::values() on a float32 series");
+        if (is_view()) throw std::logic_error("TimeSeries::values() on a view");
+        return f64_ ? *f64_ : empty;
+    }
+
+    /// Read-only view of F32 values. Never copies. Throws for F64 series and
+    /// for views.
+    const std::vector<float>& values_f32() const {
+        static const std::vector<float> empty;
+        if (dtype_ != DType::F32) throw std::logic_error("TimeSeries::values_f32() on a float64 series");
+        if (is_view()) throw std::logic_error("TimeSeries::values_f32() on a view");
+        return f32_ ? *f32_ : empty;
+    }
+
+    /// True if the series is a window into a larger buffer.
+    bool is_view() const noexcept { return offset_ != 0 || len_ != whole; }
+
+    /// Rows [b, e) as a view sharing this series' buffer. The validity
+    /// bitmap and timestamp index, if any, are sliced (copied); a positional
+    /// slice's origin moves up by b. Throws std::out_of_range.
+    TimeSeries slice(std::size_t b, std::size_t e) const;
+
+    /// The same rows in a buffer of their own (shared, not copied, if this is
+    /// not a view).
+    TimeSeries compact() const;
+
+    /// Position of row 0 of a positional series; see the class comment.
+    std::ptrdiff_t origin() const noexcept { return origin_; }
+    TimeSeries with_origin(std::ptrdiff_t origin) const {
+        TimeSeries out = *this;
+        out.origin_ = origin;
+        return out;
+    }
+    /// True if the series lines up with other operands by origin, i.e.
+    /// lag() shifted it within the current expression.
+    bool shifted() const noexcept { return shifted_; }
+    TimeSeries shifted_to(std::ptrdiff_t origin) const {
+        TimeSeries out = with_origin(origin);
+        out.shifted_ = true;
+        return out;
+    }
+    /// The same rows at origin 0, no longer shifted: how a result is stored.
+    TimeSeries unshifted() const {
+        TimeSeries out = with_origin(0);
+        out.shifted_ = false;
+        return out;
+    }
+
+    /// Writable access. Detaches from any other owner of the buffer first;
+    /// a view gets a buffer of its own rows. Starts a new generation.
+    std::vector<double>& mutable_values() {
+        if (dtype_ != DType::F64) throw std::logic_error("TimeSeries::mutable_values() on a float32 series");
+        generation_ = next_generation();
+        return detach(f64_, offset_, len_);
+    }
+    std::vector<float>& mutable_values_f32() {
+        if (dtype_ != DType::F32) throw std::logic_error("TimeSeries::mutable_values_f32() on a float64 series");
+        generation_ = next_generation();
+        return detach(f32_, offset_, len_);
+    }
 
-    std::size_t size() const noexcept { return v.size(); }
+    /// Identifies the rows; see the class comment.
+    std::uint64_t generation() const noexcept { return generation_; }
+
+    /// Add `rows` at the end. They must have this series' dtype, and be
+    /// timestamped after the last row exactly when this series is
+    /// timestamped; otherwise throws std::runtime_error and leaves this
+    /// series alone. The values grow in place when this series is the only
+    /// owner of its buffer, and so do the validity bitmap and the index once
+    /// this series holds copies of its own: a run of appends costs amortized
+    /// O(rows). Keeps the generation, unless the values buffer was shared
+    /// (the other owners may append rows of their own).
+    void append(const TimeSeries& rows);
+
+    /// Mark row i present or missing. Like mutable_values(), takes a copy of
+    /// a bitmap this series does not own alone (or makes one), then edits it
+    /// in place. Starts a new generation. Throws std::out_of_range.
+    void set_valid(std::size_t i, bool valid);
+
+    bool has_index() const noexcept { return static_cast<bool>(index_); }
+    const TimeIndexPtr& index() const noexcept { return index_; }
+
+    bool has_validity() const noexcept { return static_cast<bool>(validity_); }
+    const ValidityPtr& validity() const noexcept { return validity_; }
+    bool is_valid(std::size_t i) const noexcept { return !validity_ || validity_->get(i); }
+    std::size_t null_count() const noexcept { return validity_ ? size() - validity_->count() : 0; }
+
+    /// Same values with the given validity bitmap (null = no missing rows).
+    /// Throws on a size mismatch.
+    TimeSeries with_validity(ValidityPtr validity) const;
+
+    /// Same values, tagged with a (shared) timestamp index. The index must be
+    /// strictly increasing; only its length is checked here.
+    TimeSeries with_index(TimeIndexPtr index) const;
+
+    /// Convert to the given storage type. Returns a shared copy if the dtype
+    /// already matches.
+    TimeSeries astype(DType t) const;
+
+    /// True if both series currently point at the same underlying buffer.
+    bool shares_buffer_with(const TimeSeries& other) const noexcept {
+        if (dtype_ != other.dtype_) return false;
+        return dtype_ == DType::F32 ? (f32_ && f32_ == other.f32_) : (f64_ && f64_ == other.f64_);
+    }
 
     static void require_same_size(const TimeSeries& a, const TimeSeries& b) {
-        if (a.v.size() != b.v.size()) {
+        if (a.size() != b.size()) {
             throw std::runtime_error("TimeSeries size mismatch (stub alignment rule)");
         }
     }
+
+private:
+    static constexpr std::size_t whole = static_cast<std::size_t>(-1);
+
+    static std::uint64_t next_generation() noexcept;
+
+    // validity_ as a bitmap this series owns alone (copied or made all-set
+    // first if need be), so it can be edited in place.
+    ValidityBitmap& own_validity();
+
+    template <class T>
+    static std::vector<T>& detach(std::shared_ptr<std::vector<T>>& buf, std::size_t& offset, std::size_t& len) {
+        if (!buf) {
+            buf = std::make_shared<std::vector<T>>();
+        } else if (offset != 0 || len != whole) {
+            const std::size_t n = len != whole ? len : buf->size() - offset;
+            buf = std::make_shared<std::vector<T>>(buf->begin() + std::ptrdiff_t(offset),
+                                                   buf->begin() + std::ptrdiff_t(offset + n));
+        } else if (buf.use_count() > 1) {
+            buf = std::make_shared<std::vector<T>>(*buf);
+        }
+        offset = 0;
+        len = whole;
+        return *buf;
+    }
+
+    std::shared_ptr<std::vector<double>> f64_;
+    std::shared_ptr<std::vector<float>> f32_;
+    std::size_t offset_{0};  // first row in the buffer
+    std::size_t len_{whole}; // rows, or `whole` for the rest of the buffer
+    std::ptrdiff_t origin_{0};
+    bool shifted_{false};
+    TimeIndexPtr index_;
+    ValidityPtr validity_;
+    DType dtype_{DType::F64};
+    std::uint64_t generation_{next_generation()};
+    // index_ / validity_ when append() or set_valid() allocated them, so may
+    // change them in place while no other series shares them.
+    TimeIndex* own_index_{nullptr};
+    ValidityBitmap* own_validity_{nullptr};
 };
 
+/// Intra-operation parallelism for the operators and sumproduct below:
+/// inputs of at least `min_rows` rows are split into `grain`-row chunks
+/// (rounded up to a multiple of 64) on tsexpr::default_thread_pool();
+/// shorter inputs stay on the calling thread. sumproduct reduces over a
+/// fixed leaf tree (tsexpr::deterministic_sum), so its result never depends
+/// on the policy or the thread count.
+struct ParallelPolicy {
+    std::size_t min_rows{std::size_t{1} << 17};
+    std::size_t grain{std::size_t{1} << 15};
+};
+
+void set_parallel_policy(const ParallelPolicy& policy);
+ParallelPolicy parallel_policy();
+
+/// Align two timestamped series on their indices. Rows missing on one side
+/// (outer join, or as-of before the first right row) are null (and NaN). Returned series
+/// share the output index buffer. Plans come from alignment_cache().
+std::pair<TimeSeries, TimeSeries> align(const TimeSeries& a, const TimeSeries& b, JoinKind kind);
+
 /// Excel-like SUMPRODUCT: multiply elementwise then sum.
-/// Stub rule: requires same size.
+/// Stub rule: requires same size, or inner-joins timestamped inputs.
+/// Accumulates in double for every dtype. Null rows on either side are skipped.
 double sumproduct(const TimeSeries& a, const TimeSeries& b);
 double sumproduct(const TimeSeries& a, double b);
 double sumproduct(double a, const TimeSeries& b);
 double sumproduct(double a, double b);
 
-// TS op TS: elementwise; requires same size (stub semantics)
+/// Trailing-window statistic over `window` rows, in one pass with O(1)
+/// amortized work per row (tsexpr::RollingWindow; see there for how nulls
+/// and the first window-1 rows are treated). The result is F64, keeps the
+/// input's index, and is null where the statistic is undefined.
+TimeSeries rolling(tsexpr::RollingKind kind, const TimeSeries& x, std::size_t window);
+
+/// Run x through a recursive filter (ewma, ewvar, filter; see
+/// tsexpr::EwmFilter), continuing from and updating `state`: consecutive
+/// slices through one state give the rows of a single pass. The result is
+/// F64, keeps the input's index, and is null where x is null or before its
+/// first value.
+TimeSeries ewm(tsexpr::EwmFilter& state, const TimeSeries& x);
+
+/// Aggregate a timestamped series into buckets of `width` time units, in
+/// one pass (tsexpr::BucketAggregator). Row i of the result is one bucket
+/// that holds rows of x, timestamped with the bucket's start; the trailing
+/// bucket is included even though more rows may still arrive. The result
+/// is F64 and null for buckets whose rows were all missing (except for
+/// Count). Throws std::invalid_argument if x has no index or width <= 0.
+TimeSeries resample(tsexpr::ResampleKind kind, const TimeSeries& x, std::int64_t width);
+
+/// x shifted k rows later (k < 0: earlier), as a view over x's buffer: row
+/// i of the result is x[i - k] and stands at x's row i. Rows without a
+/// shifted value are dropped rather than padded, so the result has
+/// size() - |k| rows: a positional result's origin moves by k, a
+/// timestamped one takes the matching slice of x's index (the timestamps
+/// are copied, the values are not).
+TimeSeries lag(const TimeSeries& x, std::ptrdiff_t k);
+
+/// x - lag(x, 1) and x / lag(x, 1) - 1, fused into one pass over x.
+TimeSeries diff(const TimeSeries& x);
+TimeSeries pct_change(const TimeSeries& x);
+
+// TS op TS: elementwise; requires same size, or inner-joins timestamped inputs
 TimeSeries operator+(const TimeSeries& a, const TimeSeries& b);
 TimeSeries operator-(const TimeSeries& a, const TimeSeries& b);
 TimeSeries operator*(const TimeSeries& a, const TimeSeries& b);
@@ -0,0 +1,171 @@
+#include <tsexpr/alignment.hpp>
+
+#include <algorithm>
+
+namespace ts::expr {
+
+// First position p in [lo, n) with v[p] >= key (n if none). Gallops from lo
+// with doubling steps, then binary searches the last bracket, so skipping a
+// run of length k costs O(log k) instead of O(k).
+static std::size_t gallop_lower(const std::int64_t* v, std::size_t lo, std::size_t n, std::int64_t key) {
+    if (lo >= n || v[lo] >= key) return lo;
+    std::size_t prev = lo;
+    std::size_t step = 1;
+    while (lo + step < n && v[lo + step] < key) {
+        prev = lo + step;
+        step *= 2;
+    }
+    const std::size_t hi = std::min(lo + step, n);
+    return static_cast<std::size_t>(std::lower_bound(v + prev + 1, v + hi, key) - v);
+}
+
+// First position p in [lo, n) with v[p] > key (n if none).
+static std::size_t gallop_upper(const std::int64_t* v, std::size_t lo, std::size_t n, std::int64_t key) {
+    if (lo >= n || v[lo] > key) return lo;
+    std::size_t prev = lo;
+    std::size_t step = 1;
+    while (lo + step < n && v[lo + step] <= key) {
+        prev = lo + step;
+        step *= 2;
+    }
+    const std::size_t hi = std::min(lo + step, n);
+    return static_cast<std::size_t>(std::upper_bound(v + prev + 1, v + hi, key) - v);
+}
+
+static bool is_identity(const std::vector<std::size_t>& rows, std::size_t n) {
+    if (rows.size() != n) return false;
+    for (std::size_t k = 0; k < n; ++k)
+        if (rows[k] != k) return false;
+    return true;
+}
+
+AlignmentPlanPtr build_alignment(const TimeIndexPtr& a, const TimeIndexPtr& b, JoinKind kind) {
+    static const TimeIndex empty;
+    const TimeIndex& av = a ? *a : empty;
+    const TimeIndex& bv = b ? *b : empty;
+    const std::int64_t* x = av.data();
+    const std::int64_t* y = bv.data();
+    const std::size_t na = av.size();
+    const std::size_t nb = bv.size();
+
+    auto plan = std::make_shared<AlignmentPlan>();
+    if (a && a == b) {
+        plan->index = a;
+        plan->left_identity = plan->right_identity = true;
+        return plan;
+    }
+
+    auto out = std::make_shared<TimeIndex>();
+    auto& L = plan->left;
+    auto& R = plan->right;
+    constexpr std::size_t npos = AlignmentPlan::npos;
+
+    std::size_t i = 0, j = 0;
+    switch (kind) {
+        case JoinKind::Inner:
+            while (i < na && j < nb) {
+                if (x[i] == y[j]) {
+                    out->push_back(x[i]);
+                    L.push_back(i++);
+                    R.push_back(j++);
+                } else if (x[i] < y[j]) {
+                    i = gallop_lower(x, i, na, y[j]);
+                } else {
+                    j = gallop_lower(y, j, nb, x[i]);
+                }
+            }
+            break;
+
+        case JoinKind::Outer:
+            while (i < na || j < nb) {
+                if (j >= nb || (i < na && x[i] < y[j])) {
+                    const std::size_t end = j < nb ? gallop_lower(x, i, na, y[j]) : na;
+                    for (; i < end; ++i) { out->push_back(x[i]); L.push_back(i); R.push_back(npos); }
+                } else if (i >= na || y[j] < x[i]) {
+                    const std::size_t end = i < na ? gallop_lower(y, j, nb, x[i]) : nb;
+                    for (; j < end; ++j) { out->push_back(y[j]); L.push_back(npos); R.push_back(j); }
+                } else {
+                    out->push_back(x[i]);
+                    L.push_back(i++);
+                    R.push_back(j++);
+                }
+            }
+            break;
+
+        case JoinKind::AsOf:
+            R.reserve(na);
+            for (; i < na; ++i) {
+                j = gallop_upper(y, j, nb, x[i]);
+                R.push_back(j == 0 ? npos : j - 1);
+            }
+            plan->left_identity = true;
+            break;
+    }
+
+    if (!plan->left_identity && is_identity(L, na)) plan->left_identity = true;
+    if (is_identity(R, nb)) plan->right_identity = true;
+    if (plan->left_identity) { L.clear(); L.shrink_to_fit(); }
+    if (plan->right_identity) { R.clear(); R.shrink_to_fit(); }
+
+    // Reuse an input's index buffer when the output matches it, so results
+    // keep pointing at the same index and later ops hit the same-index path.
+    if (plan->left_identity && a) plan->index = a;
+    else if (plan->right_identity && b) plan->index = b;
+    else plan->index = std::move(out);
+    return plan;
+}
+
+AlignmentPlanPtr AlignmentCache::get(const TimeIndexPtr& a, const TimeIndexPtr& b, JoinKind kind) {
+    const Key key{a.get(), a ? a->size() : 0, b.get(), b ? b->size() : 0, kind};
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            Entry& e = it->second;
+            if (e.a.lock() == a && e.b.lock() == b) {
+                lru_.splice(lru_.begin(), lru_, e.lru);
+                ++stats_.hits;
+                return e.plan;
+            }
+            // Stale: an index buffer was freed and its address reused.
+            lru_.erase(e.lru);
+            entries_.erase(it);
+        }
+        ++stats_.misses;
+    }
+
+    // Join outside the lock; concurrent misses on the same key just race to
+    // insert equivalent plans.
+    AlignmentPlanPtr plan = build_alignment(a, b, kind);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    if (capacity_ == 0) return plan;
+    if (entries_.count(key)) return plan;
+    while (entries_.size() >= capacity_) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+        ++stats_.evictions;
+    }
+    lru_.push_front(key);
+    entries_.emplace(key, Entry{a, b, plan, lru_.begin()});
+    return plan;
+}
+
+AlignmentCache::Stats AlignmentCache::stats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return stats_;
+}
+
+void AlignmentCache::clear() {
+    std::lock_guard<std::mutex> lock(mu_);
+    entries_.clear();
+    lru_.clear();
+    stats_ = Stats{};
+}
+
+AlignmentCache& alignment_cache() {
+    static AlignmentCache cache;
+    return cache;
+}
+
+} // namespace ts::expr
@@ -0,0 +1,81 @@
+#include <tsexpr/bitmap.hpp>
+
+#include <bitset>
+#include <stdexcept>
+
+namespace ts::expr {
+
+ValidityBitmap::ValidityBitmap(std::size_t n, bool valid)
+    : words_((n + 63) / 64, valid ? ~std::uint64_t{0} : std::uint64_t{0}), n_(n) {
+    clear_tail();
+}
+
+ValidityBitmap ValidityBitmap::from_bools(const std::vector<bool>& valid) {
+    ValidityBitmap out(valid.size(), false);
+    for (std::size_t i = 0; i < valid.size(); ++i)
+        if (valid[i]) out.set(i, true);
+    return out;
+}
+
+std::size_t ValidityBitmap::count() const noexcept {
+    std::size_t c = 0;
+    for (std::uint64_t w : words_) c += std::bitset<64>(w).count();
+    return c;
+}
+
+bool ValidityBitmap::all_set() const noexcept {
+    const std::size_t full = n_ / 64;
+    for (std::size_t w = 0; w < full; ++w)
+        if (words_[w] != ~std::uint64_t{0}) return false;
+    if (n_ % 64 != 0) return words_.back() == (std::uint64_t{1} << (n_ % 64)) - 1;
+    return true;
+}
+
+void ValidityBitmap::clear_tail() noexcept {
+    if (n_ % 64 != 0) words_.back() &= (std::uint64_t{1} << (n_ % 64)) - 1;
+}
+
+ValidityBitmap ValidityBitmap::combine(const ValidityBitmap& a, const ValidityBitmap& b) {
+    if (a.n_ != b.n_) throw std::runtime_error("ValidityBitmap size mismatch");
+    ValidityBitmap out;
+    out.n_ = a.n_;
+    out.words_.resize(a.words_.size());
+    const std::uint64_t* x = a.words_.data();
+    const std::uint64_t* y = b.words_.data();
+    std::uint64_t* o = out.words_.data();
+    for (std::size_t w = 0; w < out.words_.size(); ++w) o[w] = x[w] & y[w];
+    return out;
+}
+
+ValidityBitmap ValidityBitmap::slice(std::size_t b, std::size_t e) const {
+    if (b > e || e > n_) throw std::out_of_range("ValidityBitmap slice out of range");
+    ValidityBitmap out;
+    out.n_ = e - b;
+    out.words_.resize((out.n_ + 63) / 64);
+    const std::size_t first = b / 64;
+    const unsigned shift = b % 64;
+    for (std::size_t w = 0; w < out.words_.size(); ++w) {
+        std::uint64_t lo = words_[first + w] >> shift;
+        if (shift && first + w + 1 < words_.size()) lo |= words_[first + w + 1] << (64 - shift);
+        out.words_[w] = lo;
+    }
+    out.clear_tail();
+    return out;
+}
+
+void ValidityBitmap::resize(std::size_t n, bool valid) {
+    const std::size_t old = n_;
+    words_.resize((n + 63) / 64, valid ? ~std::uint64_t{0} : std::uint64_t{0});
+    n_ = n;
+    // Bits past the old size in its last word are clear.
+    if (valid && n > old && old % 64 != 0) words_[old / 64] |= ~std::uint64_t{0} << (old % 64);
+    clear_tail();
+}
+
+ValidityPtr combine_validity(const ValidityPtr& a, const ValidityPtr& b) {
+    if (!a) return b;
+    if (!b || a == b) return a;
+    return std::make_shared<const ValidityBitmap>(ValidityBitmap::combine(*a, *b));
+}
+
+} // namespace ts::expr
@@ -0,0 +1,527 @@
+#include <tsexpr/compressed_series.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "kernels.hpp"
+
+namespace ts::expr {
+
+// -----------------------------
+// bit streams
+// -----------------------------
+static unsigned clz64(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return x ? static_cast<unsigned>(__builtin_clzll(x)) : 64u;
+#else
+    unsigned n = 0;
+    for (std::uint64_t bit = std::uint64_t{1} << 63; bit && !(x & bit); bit >>= 1) ++n;
+    return n;
+#endif
+}
+
+static unsigned ctz64(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return x ? static_cast<unsigned>(__builtin_ctzll(x)) : 64u;
+#else
+    unsigned n = 0;
+    for (std::uint64_t bit = 1; bit && !(x & bit); bit <<= 1) ++n;
+    return n;
+#endif
+}
+
+// MSB-first bit writer over 64-bit words.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<std::uint64_t>& words) : w_(words), nbits_(words.size() * 64) {}
+
+    std::size_t position() const noexcept { return nbits_; }
+
+    // Append the low `n` bits of `value` (n in [0, 64]).
+    void write(std::uint64_t value, unsigned n) {
+        if (n == 0) return;
+        if (n < 64) value &= (std::uint64_t{1} << n) - 1;
+        const unsigned used = static_cast<unsigned>(nbits_ & 63);
+        if (used == 0) w_.push_back(0);
+        const unsigned room = 64 - used;
+        if (n <= room) {
+            w_.back() |= value << (room - n);
+        } else {
+            const unsigned rest = n - room;
+            w_.back() |= value >> rest;
+            w_.push_back(value << (64 - rest));
+        }
+        nbits_ += n;
+    }
+
+    // Start the next record on a word boundary (blocks begin word-aligned).
+    void align() { nbits_ = w_.size() * 64; }
+
+private:
+    std::vector<std::uint64_t>& w_;
+    std::size_t nbits_;
+};
+
+class BitReader {
+public:
+    BitReader(const std::uint64_t* words, std::size_t bit_pos) : w_(words), pos_(bit_pos) {}
+
+    std::uint64_t read(unsigned n) {
+        if (n == 0) return 0;
+        const std::size_t word = pos_ >> 6;
+        const unsigned used = static_cast<unsigned>(pos_ & 63);
+        const unsigned avail = 64 - used;
+        std::uint64_t out;
+        if (n <= avail) {
+            out = (w_[word] << used) >> (64 - n);
+        } else {
+            const unsigned rest = n - avail;
+            const std::uint64_t hi = w_[word] & ((std::uint64_t{1} << avail) - 1);
+            out = (hi << rest) | (w_[word + 1] >> (64 - rest));
+        }
+        pos_ += n;
+        return out;
+    }
+
+    bool bit() { return read(1) != 0; }
+
+private:
+    const std::uint64_t* w_;
+    std::size_t pos_;
+};
+
+static std::uint64_t to_bits(double x) {
+    std::uint64_t u;
+    std::memcpy(&u, &x, sizeof u);
+    return u;
+}
+
+static double from_bits(std::uint64_t u) {
+    double x;
+    std::memcpy(&x, &u, sizeof x);
+    return x;
+}
+
+static std::int64_t sign_extend(std::uint64_t v, unsigned bits) {
+    const std::uint64_t m = std::uint64_t{1} << (bits - 1);
+    return static_cast<std::int64_t>((v ^ m) - m);
+}
+
+// -----------------------------
+// encoded layout
+// -----------------------------
+struct CompressedSeries::Data {
+    struct Block {
+        std::size_t bit_offset; // start of the block in `bits`
+        std::size_t rows;
+        std::size_t first_null; // the block's spans are nulls[first_null, next block's)
+    };
+    // Consecutive null rows of one block, `begin` relative to the block.
+    struct NullSpan {
+        std::uint32_t begin;
+        std::uint32_t rows;
+    };
+
+    std::vector<std::uint64_t> bits;
+    std::vector<Block> blocks;
+    std::vector<NullSpan> nulls;
+    std::size_t null_rows{0};
+    std::size_t rows{0};
+    std::size_t block_rows{default_block_rows};
+    bool timestamped{false};
+};
+
+// Per-block encoder state. Row 0 of a block stores its timestamp and value
+// raw; later rows store delta-of-delta timestamps and XOR'd values.
+struct BlockEncoder {
+    std::uint64_t prev_bits{0};
+    unsigned prev_lead{65}; // 65 = no previous window
+    unsigned prev_trail{0};
+    std::int64_t prev_ts{0};
+    std::int64_t prev_delta{0};
+
+    void first(BitWriter& w, const std::int64_t* ts, double v) {
+        if (ts) w.write(static_cast<std::uint64_t>(*ts), 64);
+        prev_bits = to_bits(v);
+        w.write(prev_bits, 64);
+        prev_lead = 65;
+        prev_trail = 0;
+        prev_ts = ts ? *ts : 0;
+        prev_delta = 0;
+    }
+
+    void next(BitWriter& w, const std::int64_t* ts, double v) {
+        if (ts) put_timestamp(w, *ts);
+        put_value(w, to_bits(v));
+    }
+
+    // A null row repeats the previous value: one control bit.
+    void next_null(BitWriter& w, const std::int64_t* ts) {
+        if (ts) put_timestamp(w, *ts);
+        put_value(w, prev_bits);
+    }
+
+    void put_timestamp(BitWriter& w, std::int64_t t) {
+        const std::int64_t delta = t - prev_ts;
+        const std::int64_t dod = delta - prev_delta;
+        prev_ts = t;
+        prev_delta = delta;
+        const auto u = static_cast<std::uint64_t>(dod);
+        if (dod == 0)                         w.write(0b0, 1);
+        else if (dod >= -64 && dod < 64)      { w.write(0b10, 2);   w.write(u, 7); }
+        else if (dod >= -256 && dod < 256)    { w.write(0b110, 3);  w.write(u, 9); }
+        else if (dod >= -2048 && dod < 2048)  { w.write(0b1110, 4); w.write(u, 12); }
+        else                                  { w.write(0b1111, 4); w.write(u, 64); }
+    }
+
+    void put_value(BitWriter& w, std::uint64_t bits) {
+        const std::uint64_t x = bits ^ prev_bits;
+        prev_bits = bits;
+        if (x == 0) { w.write(0b0, 1); return; }
+        const unsigned lead = std::min(clz64(x), 31u);
+        const unsigned trail = ctz64(x);
+        if (prev_lead <= 64 && lead >= prev_lead && trail >= prev_trail) {
+            // Meaningful bits fit in the previous window: reuse it.
+            w.write(0b10, 2);
+            w.write(x >> prev_trail, 64 - prev_lead - prev_trail);
+            return;
+        }
+        const unsigned sig = 64 - lead - trail;
+        w.write(0b11, 2);
+        w.write(lead, 5);
+        w.write(sig == 64 ? 0 : sig, 6);
+        w.write(x >> trail, sig);
+        prev_lead = lead;
+        prev_trail = trail;
+    }
+};
+
+static void decode_block(const std::uint64_t* words, std::size_t bit_offset, std::size_t rows, bool timestamped,
+                         std::int64_t* ts_out, double* v_out) {
+    BitReader r(words, bit_offset);
+    std::uint64_t prev_bits = 0;
+    unsigned lead = 0, trail = 0;
+    std::int64_t prev_ts = 0, prev_delta = 0;
+
+    for (std::size_t i = 0; i < rows; ++i) {
+        if (i == 0) {
+            if (timestamped) prev_ts = static_cast<std::int64_t>(r.read(64));
+            prev_bits = r.read(64);
+        } else {
+            if (timestamped) {
+                std::int64_t dod;
+                if (!r.bit())      dod = 0;
+                else if (!r.bit()) dod = sign_extend(r.read(7), 7);
+                else if (!r.bit()) dod = sign_extend(r.read(9), 9);
+                else if (!r.bit()) dod = sign_extend(r.read(12), 12);
+                else               dod = static_cast<std::int64_t>(r.read(64));
+                prev_delta += dod;
+                prev_ts += prev_delta;
+            }
+            if (r.bit()) {
+                if (r.bit()) {
+                    lead = static_cast<unsigned>(r.read(5));
+                    unsigned sig = static_cast<unsigned>(r.read(6));
+                    if (sig == 0) sig = 64;
+                    trail = 64 - lead - sig;
+                }
+                prev_bits ^= r.read(64 - lead - trail) << trail;
+            }
+        }
+        if (ts_out) ts_out[i] = prev_ts;
+        v_out[i] = from_bits(prev_bits);
+    }
+}
+
+// -----------------------------
+// Builder
+// -----------------------------
+struct CompressedSeries::Builder::State {
+    std::shared_ptr<Data> data = std::make_shared<Data>();
+    BitWriter w{data->bits};
+    BlockEncoder enc;
+    std::size_t in_block{0};
+    std::int64_t last_ts{0};
+};
+
+CompressedSeries::Builder::Builder(bool timestamped, std::size_t block_rows) : st_(std::make_unique<State>()) {
+    if (block_rows == 0 || block_rows > std::numeric_limits<std::uint32_t>::max())
+        throw std::runtime_error("CompressedSeries block_rows must be in [1, 2^32)");
+    st_->data->timestamped = timestamped;
+    st_->data->block_rows = block_rows;
+}
+
+CompressedSeries::Builder::~Builder() = default;
+CompressedSeries::Builder::Builder(Builder&&) noexcept = default;
+CompressedSeries::Builder& CompressedSeries::Builder::operator=(Builder&&) noexcept = default;
+
+void CompressedSeries::Builder::append(const std::int64_t* ts, const double* values, std::size_t n,
+                                       const ValidityBitmap* valid) {
+    Data& d = *st_->data;
+    if (d.timestamped && !ts && n) throw std::runtime_error("CompressedSeries: timestamped builder needs timestamps");
+    if (valid && valid->size() < n) throw std::runtime_error("CompressedSeries: validity shorter than the rows");
+    BitWriter& w = st_->w;
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::int64_t* t = d.timestamped ? ts + i : nullptr;
+        if (t) {
+            if (d.rows > 0 && *t <= st_->last_ts) throw std::runtime_error("CompressedSeries timestamps must be strictly increasing");
+            st_->last_ts = *t;
+        }
+        const bool present = !valid || valid->get(i);
+        if (st_->in_block == 0) {
+            w.align();
+            d.blocks.push_back(Data::Block{w.position(), 0, d.nulls.size()});
+            st_->enc.first(w, t, present ? values[i] : 0.0);
+        } else if (present) {
+            st_->enc.next(w, t, values[i]);
+        } else {
+            st_->enc.next_null(w, t);
+        }
+        Data::Block& block = d.blocks.back();
+        if (!present) {
+            const auto row = static_cast<std::uint32_t>(block.rows);
+            if (d.nulls.size() > block.first_null && d.nulls.back().begin + d.nulls.back().rows == row) {
+                ++d.nulls.back().rows;
+            } else {
+                d.nulls.push_back(Data::NullSpan{row, 1});
+            }
+            ++d.null_rows;
+        }
+        ++block.rows;
+        ++d.rows;
+        if (++st_->in_block == d.block_rows) st_->in_block = 0;
+    }
+}
+
+CompressedSeries CompressedSeries::Builder::finish() {
+    CompressedSeries out;
+    st_->data->bits.shrink_to_fit();
+    st_->data->nulls.shrink_to_fit();
+    const bool timestamped = st_->data->timestamped;
+    const std::size_t block_rows = st_->data->block_rows;
+    out.data_ = std::move(st_->data);
+    st_ = std::make_unique<State>();
+    st_->data->timestamped = timestamped;
+    st_->data->block_rows = block_rows;
+    return out;
+}
+
+// -----------------------------
+// CompressedSeries
+// -----------------------------
+CompressedSeries CompressedSeries::encode(const TimeSeries& s, std::size_t block_rows) {
+    Builder b(s.has_index(), block_rows);
+    const std::int64_t* ts = s.has_index() ? s.index()->data() : nullptr;
+    std::vector<double> chunk;
+    ValidityBitmap valid;
+    for (std::size_t base = 0; base < s.size(); base += block_rows) {
+        const std::size_t n = std::min(block_rows, s.size() - base);
+        chunk.resize(n);
+        for (std::size_t i = 0; i < n; ++i) chunk[i] = s[base + i];
+        if (s.has_validity()) {
+            valid = ValidityBitmap(n);
+            for (std::size_t i = 0; i < n; ++i) valid.set(i, s.is_valid(base + i));
+        }
+        b.append(ts ? ts + base : nullptr, chunk.data(), n, s.has_validity() ? &valid : nullptr);
+    }
+    return b.finish();
+}
+
+std::size_t CompressedSeries::size() const noexcept { return data_ ? data_->rows : 0; }
+std::size_t CompressedSeries::block_rows() const noexcept { return data_ ? data_->block_rows : default_block_rows; }
+std::size_t CompressedSeries::block_count() const noexcept { return data_ ? data_->blocks.size() : 0; }
+bool CompressedSeries::has_index() const noexcept { return data_ && data_->timestamped; }
+std::size_t CompressedSeries::null_count() const noexcept { return data_ ? data_->null_rows : 0; }
+
+std::size_t CompressedSeries::compressed_bytes() const noexcept {
+    if (!data_) return 0;
+    return data_->bits.size() * sizeof(std::uint64_t) + data_->blocks.size() * sizeof(Data::Block) +
+           data_->nulls.size() * sizeof(Data::NullSpan);
+}
+
+std::size_t CompressedSeries::raw_bytes() const noexcept {
+    return size() * (has_index() ? 16 : 8);
+}
+
+double CompressedSeries::compression_ratio() const noexcept {
+    const std::size_t c = compressed_bytes();
+    return c ? double(raw_bytes()) / double(c) : 0.0;
+}
+
+CompressedSeries::BlockReader::BlockReader(const CompressedSeries& s) : s_(&s) {
+    values_.reserve(s.block_rows());
+    if (s.has_index()) ts_.reserve(s.block_rows());
+}
+
+bool CompressedSeries::BlockReader::next() {
+    const Data* d = s_->data_.get();
+    if (!d || block_ >= d->blocks.size()) { rows_ = 0; return false; }
+    const Data::Block& b = d->blocks[block_++];
+    rows_ = b.rows;
+    values_.resize(rows_);
+    if (d->timestamped) ts_.resize(rows_);
+    decode_block(d->bits.data(), b.bit_offset, rows_, d->timestamped,
+                 d->timestamped ? ts_.data() : nullptr, values_.data());
+
+    const std::size_t end = block_ < d->blocks.size() ? d->blocks[block_].first_null : d->nulls.size();
+    has_nulls_ = b.first_null < end;
+    if (has_nulls_) {
+        valid_ = ValidityBitmap(rows_);
+        for (std::size_t k = b.first_null; k < end; ++k) {
+            const Data::NullSpan& span = d->nulls[k];
+            for (std::size_t i = span.begin; i < span.begin + span.rows; ++i) {
+                valid_.set(i, false);
+                values_[i] = std::numeric_limits<double>::quiet_NaN();
+            }
+        }
+    }
+    return true;
+}
+
+CompressedSeries::DecodeStats CompressedSeries::measure_decode() const {
+    DecodeStats st;
+    BlockReader r(*this);
+    double sink = 0.0;
+    const auto t0 = std::chrono::steady_clock::now();
+    while (r.next()) {
+        st.rows += r.rows();
+        ++st.blocks;
+        sink += r.values()[0];
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    st.seconds = std::chrono::duration<double>(t1 - t0).count();
+    // Keep the decode loop observable so it is not optimized away.
+    volatile double keep = sink;
+    (void)keep;
+    return st;
+}
+
+TimeSeries CompressedSeries::decode() const {
+    std::vector<double> values;
+    std::vector<std::int64_t> ts;
+    values.reserve(size());
+    if (has_index()) ts.reserve(size());
+    std::shared_ptr<ValidityBitmap> valid;
+    if (null_count() > 0) valid = std::make_shared<ValidityBitmap>(size());
+    BlockReader r(*this);
+    while (r.next()) {
+        if (const ValidityBitmap* block = r.validity()) {
+            for (std::size_t i = 0; i < r.rows(); ++i)
+                if (!block->get(i)) valid->set(values.size() + i, false);
+        }
+        values.insert(values.end(), r.values(), r.values() + r.rows());
+        if (r.timestamps()) ts.insert(ts.end(), r.timestamps(), r.timestamps() + r.rows());
+    }
+    TimeSeries out = has_index() ? TimeSeries{std::move(ts), std::move(values)} : TimeSeries{std::move(values)};
+    return valid ? out.with_validity(std::move(valid)) : out;
+}
+
+// -----------------------------
+// streaming kernels
+// -----------------------------
+
+// Validity of rows [i, i + n) of a block, or null if they are all valid.
+static const ValidityBitmap* window_validity(const ValidityBitmap* block, std::size_t i, std::size_t n,
+                                             ValidityBitmap& buf) {
+    if (!block) return nullptr;
+    if (i == 0 && n == block->size()) return block;
+    buf = block->slice(i, i + n);
+    return &buf;
+}
+
+// Walks two series in lockstep over windows that never cross a block
+// boundary on either side, so block sizes need not match. `fn` gets the
+// window's combined validity, null when no row in it is missing.
+template <class Fn>
+static void zip_blocks(const CompressedSeries& a, const CompressedSeries& b, Fn&& fn) {
+    if (a.size() != b.size()) throw std::runtime_error("CompressedSeries size mismatch");
+    const bool check_ts = a.has_index() && b.has_index();
+    CompressedSeries::BlockReader ra(a), rb(b);
+    ValidityBitmap buf_a, buf_b, both;
+    std::size_t ia = 0, ib = 0;
+    bool more_a = ra.next(), more_b = rb.next();
+    while (more_a && more_b) {
+        const std::size_t n = std::min(ra.rows() - ia, rb.rows() - ib);
+        if (check_ts && !std::equal(ra.timestamps() + ia, ra.timestamps() + ia + n, rb.timestamps() + ib))
+            throw std::runtime_error("CompressedSeries timestamp mismatch");
+        const std::int64_t* ts = ra.timestamps() ? ra.timestamps() + ia : (rb.timestamps() ? rb.timestamps() + ib : nullptr);
+        const ValidityBitmap* va = window_validity(ra.validity(), ia, n, buf_a);
+        const ValidityBitmap* vb = window_validity(rb.validity(), ib, n, buf_b);
+        const ValidityBitmap* valid = va ? va : vb;
+        if (va && vb) {
+            both = ValidityBitmap::combine(*va, *vb);
+            valid = &both;
+        }
+        fn(ts, ra.values() + ia, rb.values() + ib, valid, n);
+        ia += n;
+        ib += n;
+        if (ia == ra.rows()) { more_a = ra.next(); ia = 0; }
+        if (ib == rb.rows()) { more_b = rb.next(); ib = 0; }
+    }
+}
+
+double sumproduct(const CompressedSeries& a, const CompressedSeries& b) {
+    double acc = 0.0;
+    zip_blocks(a, b, [&](const std::int64_t*, const double* x, const double* y, const ValidityBitmap* valid,
+                         std::size_t n) {
+        acc += valid ? kernels::dot_masked(x, y, valid->words(), n) : kernels::dot(x, y, n);
+    });
+    return acc;
+}
+
+double sumproduct(const CompressedSeries& a, double b) {
+    double acc = 0.0;
+    CompressedSeries::BlockReader r(a);
+    while (r.next()) {
+        const ValidityBitmap* valid = r.validity();
+        acc += valid ? kernels::dot_scalar_masked(r.values(), b, valid->words(), r.rows())
+                     : kernels::dot_scalar(r.values(), b, r.rows());
+    }
+    return acc;
+}
+
+template <class Op>
+static CompressedSeries binop_cs_cs(const CompressedSeries& a, const CompressedSeries& b) {
+    CompressedSeries::Builder out(a.has_index() || b.has_index(), a.block_rows());
+    std::vector<double> buf;
+    zip_blocks(a, b, [&](const std::int64_t* ts, const double* x, const double* y, const ValidityBitmap* valid,
+                         std::size_t n) {
+        buf.resize(n);
+        kernels::vv<Op>(x, y, buf.data(), n);
+        out.append(ts, buf.data(), n, valid);
+    });
+    return out.finish();
+}
+
+template <class Op>
+static CompressedSeries binop_cs_s(const CompressedSeries& a, double s) {
+    CompressedSeries::Builder out(a.has_index(), a.block_rows());
+    std::vector<double> buf;
+    CompressedSeries::BlockReader r(a);
+    while (r.next()) {
+        buf.resize(r.rows());
+        kernels::vs<Op>(r.values(), s, buf.data(), r.rows());
+        out.append(r.timestamps(), buf.data(), r.rows(), r.validity());
+    }
+    return out.finish();
+}
+
+using kernels::Add;
+using kernels::Sub;
+using kernels::Mul;
+using kernels::Div;
+
+CompressedSeries operator+(const CompressedSeries& a, const CompressedSeries& b) { return binop_cs_cs<Add>(a, b); }
+CompressedSeries operator-(const CompressedSeries& a, const CompressedSeries& b) { return binop_cs_cs<Sub>(a, b); }
+CompressedSeries operator*(const CompressedSeries& a, const CompressedSeries& b) { return binop_cs_cs<Mul>(a, b); }
+CompressedSeries operator/(const CompressedSeries& a, const CompressedSeries& b) { return binop_cs_cs<Div>(a, b); }
+
+CompressedSeries operator+(const CompressedSeries& a, double b) { return binop_cs_s<Add>(a, b); }
+CompressedSeries operator-(const CompressedSeries& a, double b) { return binop_cs_s<Sub>(a, b); }
+CompressedSeries operator*(const CompressedSeries& a, double b) { return binop_cs_s<Mul>(a, b); }
+CompressedSeries operator/(const CompressedSeries& a, double b) { return binop_cs_s<Div>(a, b); }
+
+} // namespace ts::expr
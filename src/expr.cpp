@@ -1,8 +1,12 @@
 #include <tsexpr/expr.hpp>
+#include <tsexpr/scheduler.hpp>
 
+#include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <cstdlib>
 #include <optional>
+#include <set>
 #include <utility>
 
 namespace ts::expr {
@@ -355,7 +359,7 @@ static Value apply_binary(TokKind op, const Value& a, const Value& b) {
 }
 
 static Value apply_function(const Token& fn, const std::vector<Value>& args) {
-    // For now we only ship Excel-like SUMPRODUCT.
+    // Excel-like SUMPRODUCT.
     if (fn.text == "sumproduct") {
         if (args.size() != 2) throw EvalError("sumproduct expects 2 arguments");
         const Value& a = args[0];
@@ -376,6 +380,69 @@ static Value apply_function(const Token& fn, const std::vector<Value>& args) {
         return sumproduct(std::get<double>(a), std::get<double>(b));
     }
 
+    // Shifts: lag(x, k) is a view of x; diff and pct_change are fused.
+    if (fn.text == "lag") {
+        if (args.size() != 2) throw EvalError("lag expects 2 arguments");
+        if (!std::holds_alternative<TimeSeries>(args[0])) throw EvalError("lag expects a series");
+        const double* k = std::get_if<double>(&args[1]);
+        if (!k || *k != std::floor(*k) || std::fabs(*k) > 1e15) throw EvalError("lag expects an integer row count");
+        return lag(std::get<TimeSeries>(args[0]), static_cast<std::ptrdiff_t>(*k));
+    }
+    if (fn.text == "diff" || fn.text == "pct_change") {
+        if (args.size() != 1) throw EvalError(fn.text + " expects 1 argument");
+        if (!std::holds_alternative<TimeSeries>(args[0])) throw EvalError(fn.text + " expects a series");
+        const TimeSeries& x = std::get<TimeSeries>(args[0]);
+        return fn.text == "diff" ? diff(x) : pct_change(x);
+    }
+
+    // Trailing-window statistics: rolling_sum(x, 20), rolling_std(x, 60), ...
+    if (const auto kind = tsexpr::rolling_kind(fn.text)) {
+        if (args.size() != 2) throw EvalError(fn.text + " expects 2 arguments");
+        if (!std::holds_alternative<TimeSeries>(args[0])) throw EvalError(fn.text + " expects a series");
+        const double* w = std::get_if<double>(&args[1]);
+        if (!w || !(*w >= 1) || *w != std::floor(*w)) throw EvalError(fn.text + " window must be a positive integer");
+        const TimeSeries& x = std::get<TimeSeries>(args[0]);
+        // Windows longer than the series are all-null; clamp before the cast.
+        return rolling(*kind, x, static_cast<std::size_t>(std::min(*w, double(x.size()) + 1)));
+    }
+
+    // Recursive filters: ewma(x, halflife), ewvar(x, halflife), filter(x, alpha).
+    if (const auto kind = tsexpr::ewm_kind(fn.text)) {
+        if (args.size() != 2) throw EvalError(fn.text + " expects 2 arguments");
+        if (!std::holds_alternative<TimeSeries>(args[0])) throw EvalError(fn.text + " expects a series");
+        const double* p = std::get_if<double>(&args[1]);
+        if (!p) throw EvalError(fn.text + " expects a scalar parameter");
+        std::optional<tsexpr::EwmFilter> state;
+        try {
+            state.emplace(*kind, *p);
+        } catch (const std::invalid_argument& e) {
+            throw EvalError(e.what());
+        }
+        return ewm(*state, std::get<TimeSeries>(args[0]));
+    }
+
+    // Time buckets: resample_last(x, 1000), resample_sum(x, 60000), ...
+    if (const auto kind = tsexpr::resample_kind(fn.text)) {
+        if (args.size() != 2) throw EvalError(fn.text + " expects 2 arguments");
+        if (!std::holds_alternative<TimeSeries>(args[0])) throw EvalError(fn.text + " expects a series");
+        const double* w = std::get_if<double>(&args[1]);
+        if (!w || !(*w >= 1 && *w < 9e18) || *w != std::floor(*w))
+            throw EvalError(fn.text + " width must be a positive integer");
+        try {
+            return resample(*kind, std::get<TimeSeries>(args[0]), static_cast<std::int64_t>(*w));
+        } catch (const std::invalid_argument& e) {
+            throw EvalError(fn.text + ": " + e.what());
+        }
+    }
+
+    // Storage casts: pick the element type a variable is stored with.
+    if (fn.text == "float32" || fn.text == "float64") {
+        if (args.size() != 1) throw EvalError(fn.text + " expects 1 argument");
+        const DType t = fn.text == "float32" ? DType::F32 : DType::F64;
+        if (std::holds_alternative<double>(args[0])) return args[0];
+        return std::get<TimeSeries>(args[0]).astype(t);
+    }
+
     throw EvalError("Unknown function: " + fn.text);
 }
 
@@ -399,6 +466,7 @@ Value eval_rpn(const std::vector<Token>& rpn, const Env& env) {
             case TokKind::Ident: {
                 auto it = env.find(t.text);
                 if (it == env.end()) throw EvalError("Unknown variable: " + t.text);
+                // O(1): shares the series buffer with the Env entry.
                 st.emplace_back(it->second);
                 break;
             }
@@ -439,20 +507,94 @@ Value eval_rpn(const std::vector<Token>& rpn, const Env& env) {
     }
 
     if (st.size() != 1) throw EvalError("Expression did not reduce to a single value");
-    return st.back();
+    return std::move(st.back());
+}
+
+// For this starter repo, Env holds TimeSeries only. If a scalar is produced
+// (e.g., by sumproduct), we store it as a length-1 series.
+static void store_value(Value v, TimeSeries& slot) {
+    if (std::holds_alternative<double>(v)) slot = TimeSeries::from_scalar(std::get<double>(v));
+    else slot = std::get<TimeSeries>(v).unshifted();
 }
 
 void execute_assignment(std::string_view input, Env& env) {
     Compiled c = compile(input);
     Value v = eval_rpn(c.rpn, env);
+    store_value(std::move(v), env[c.target]);
+}
+
+void execute_assignment(std::string_view input, VariableStore& store) {
+    Compiled c = compile(input);
+    const VariableStore::Snapshot snap = store.snapshot();
+    TimeSeries out;
+    store_value(eval_rpn(c.rpn, snap.vars()), out);
+    store.store(c.target, std::move(out));
+}
+
+void execute_assignments(const std::vector<std::string>& statements, Env& env) {
+    auto run_serial = [&] {
+        for (const auto& s : statements) execute_assignment(s, env);
+    };
+    if (statements.size() < 2) return run_serial();
+
+    std::vector<Compiled> compiled;
+    compiled.reserve(statements.size());
+    try {
+        for (const auto& s : statements) compiled.push_back(compile(s));
+    } catch (const ParseError&) {
+        return run_serial();
+    }
+
+    tsexpr::DependencyGraph graph;
+    std::set<std::string, std::less<>> defined;
+    std::vector<std::string> reads;
+    for (const auto& c : compiled) {
+        reads.clear();
+        for (const auto& t : c.rpn) {
+            if (t.kind != TokKind::Ident) continue;
+            if (!env.count(t.text) && !defined.count(t.text)) return run_serial();
+            reads.push_back(t.text);
+        }
+        graph.add(reads, {c.target});
+        defined.insert(c.target);
+    }
 
-    // For this starter repo, Env holds TimeSeries only. If a scalar is produced
-    // (e.g., by sumproduct), we store it as a length-1 series.
-    if (std::holds_alternative<double>(v)) {
-        env[c.target] = TimeSeries::from_scalar(std::get<double>(v));
-        return;
+    // Create every target up front: statements then only assign to existing
+    // entries, so concurrent lookups never see the map change shape.
+    std::vector<std::string> created;
+    for (const auto& name : defined) {
+        if (env.emplace(name, TimeSeries{}).second) created.push_back(name);
+    }
+    // Each statement keeps a (copy-on-write) copy of the value it replaced,
+    // so statements that ran past a failure can be undone.
+    std::vector<char> stored(compiled.size(), 0);
+    std::vector<TimeSeries> replaced(compiled.size());
+    try {
+        graph.run(tsexpr::default_thread_pool(), [&](std::size_t i) {
+            Value v = eval_rpn(compiled[i].rpn, env);
+            TimeSeries& slot = env.find(compiled[i].target)->second;
+            replaced[i] = slot;
+            store_value(std::move(v), slot);
+            stored[i] = 1;
+        });
+    } catch (...) {
+        // Every statement before the earliest failing one has run; undo the
+        // ones after it. Statements writing the same target run in batch
+        // order, so undoing latest first leaves each target as the serial
+        // run would have.
+        std::size_t failed = 0;
+        while (failed < compiled.size() && stored[failed]) ++failed;
+        for (std::size_t i = compiled.size(); i-- > failed + 1;) {
+            if (stored[i]) env.find(compiled[i].target)->second = std::move(replaced[i]);
+        }
+        // Drop placeholders no statement before the failure assigned.
+        for (const auto& name : created) {
+            bool assigned = false;
+            for (std::size_t i = 0; i < failed && !assigned; ++i) assigned = compiled[i].target == name;
+            if (!assigned) env.erase(name);
+        }
+        throw;
     }
-    env[c.target] = std::get<TimeSeries>(v);
 }
 
 } // namespace ts::expr
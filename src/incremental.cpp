@@ -0,0 +1,121 @@
+#include "tsexpr/incremental.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace tsexpr {
+
+std::uint64_t VersionTable::get(std::string_view name) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = versions_.find(name);
+    return it == versions_.end() ? 0 : it->second;
+}
+
+std::uint64_t VersionTable::bump(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = versions_.find(name);
+    if (it == versions_.end()) it = versions_.emplace(std::string(name), 0).first;
+    return it->second = ++clock_;
+}
+
+void VersionTable::set(std::string_view name, std::uint64_t version) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = versions_.find(name);
+    if (it == versions_.end()) it = versions_.emplace(std::string(name), 0).first;
+    it->second = version;
+}
+
+IncrementalRunner::IncrementalRunner(std::vector<Program> programs) : programs_(std::move(programs)) {
+    statements_.resize(programs_.size());
+    for (std::size_t i = 0; i < programs_.size(); ++i) {
+        Statement& st = statements_[i];
+        for (const Instr& ins : programs_[i].code) {
+            auto& names = ins.op == Op::PushVar ? st.reads : st.writes;
+            if (ins.op != Op::PushVar && ins.op != Op::Store) continue;
+            if (std::find(names.begin(), names.end(), ins.text) == names.end()) names.push_back(ins.text);
+        }
+        st.read_versions.assign(st.reads.size(), 0);
+        st.write_versions.assign(st.writes.size(), 0);
+        st.last_writer.assign(st.writes.size(), true);
+        st.carried.assign(st.reads.size(), false);
+    }
+    // Earlier writes of a variable are expected to be overwritten by the
+    // later ones, so only the last writer checks that its value survived.
+    std::set<std::string_view> seen;
+    for (std::size_t i = statements_.size(); i-- > 0;) {
+        Statement& st = statements_[i];
+        for (std::size_t k = 0; k < st.writes.size(); ++k) st.last_writer[k] = seen.insert(st.writes[k]).second;
+    }
+    for (std::size_t i = 0; i < statements_.size(); ++i) {
+        Statement& st = statements_[i];
+        for (std::size_t k = 0; k < st.reads.size(); ++k) st.carried[k] = loop_carried(i, st.reads[k]);
+    }
+}
+
+bool IncrementalRunner::writes(std::size_t i, std::string_view name) const {
+    const auto& w = statements_[i].writes;
+    return std::find(w.begin(), w.end(), name) != w.end();
+}
+
+bool IncrementalRunner::reads_output_of(std::size_t k, std::size_t i) const {
+    for (const auto& r : statements_[k].reads)
+        if (writes(i, r)) return true;
+    return false;
+}
+
+// Statement i's read of `name` is loop-carried if i writes `name` itself, or
+// a later writer of `name` depends on i through the batch's own outputs: i
+// and that writer then form a cycle, and a full re-run never settles either.
+// A read of an earlier statement's write sees this pass's value, so later
+// writes do not matter to it; a plain forward read of a later statement's
+// output is not carried.
+bool IncrementalRunner::loop_carried(std::size_t i, std::string_view name) const {
+    if (writes(i, name)) return true;
+    for (std::size_t k = 0; k < i; ++k)
+        if (writes(k, name)) return true;
+    std::size_t last = i;
+    for (std::size_t j = i + 1; j < statements_.size(); ++j)
+        if (writes(j, name)) last = j;
+    if (last == i) return false;
+
+    std::vector<bool> reached(last + 1, false);
+    reached[i] = true;
+    for (std::size_t k = i + 1; k <= last; ++k) {
+        for (std::size_t from = i; from < k && !reached[k]; ++from)
+            reached[k] = reached[from] && reads_output_of(k, from);
+        if (reached[k] && writes(k, name)) return true;
+    }
+    return false;
+}
+
+void IncrementalRunner::settle() {
+    for (Statement& st : statements_) {
+        if (!st.ran) continue;
+        for (std::size_t k = 0; k < st.reads.size(); ++k)
+            if (st.carried[k]) st.read_versions[k] = versions_.get(st.reads[k]);
+    }
+}
+
+void IncrementalRunner::invalidate() noexcept {
+    for (Statement& st : statements_) st.ran = false;
+}
+
+std::vector<std::size_t> IncrementalRunner::stale() const {
+    std::vector<std::size_t> out;
+    std::set<std::string_view> rewritten; // targets of the statements picked so far
+    for (std::size_t i = 0; i < statements_.size(); ++i) {
+        const Statement& st = statements_[i];
+        bool run = !st.ran;
+        for (std::size_t k = 0; k < st.reads.size() && !run; ++k)
+            run = rewritten.count(st.reads[k]) || versions_.get(st.reads[k]) != st.read_versions[k];
+        for (std::size_t k = 0; k < st.writes.size() && !run; ++k)
+            run = rewritten.count(st.writes[k]) ||
+                  (st.last_writer[k] && versions_.get(st.writes[k]) != st.write_versions[k]);
+        if (!run) continue;
+        out.push_back(i);
+        for (const auto& w : st.writes) rewritten.insert(w);
+    }
+    return out;
+}
+
+} // namespace tsexpr
@@ -0,0 +1,265 @@
+#pragma once
+// Internal: elementwise and reduction kernels shared by the stub TimeSeries.
+//
+// Kernels are templated on the output element type (which picks the SIMD
+// width) and on the input element types, so the same code covers f64, f32
+// and mixed f32/f64 inputs. Reductions always accumulate in double.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+namespace ts::expr::kernels {
+
+struct Add { template <class V, class X> static X apply(X a, X b) { return V::add(a, b); } };
+struct Sub { template <class V, class X> static X apply(X a, X b) { return V::sub(a, b); } };
+struct Mul { template <class V, class X> static X apply(X a, X b) { return V::mul(a, b); } };
+struct Div { template <class V, class X> static X apply(X a, X b) { return V::div(a, b); } };
+
+// out[i] = a[i] op b[i]
+template <class Op, class TO, class TA, class TB>
+void vv(const TA* a, const TB* b, TO* out, std::size_t n) {
+    using V = simd::Vec<TO>;
+    using S = simd::Scalar<TO>;
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width)
+        V::store(out + i, Op::template apply<V>(V::load(a + i), V::load(b + i)));
+    for (; i < n; ++i)
+        S::store(out + i, Op::template apply<S>(S::load(a + i), S::load(b + i)));
+}
+
+// out[i] = a[i] op s
+template <class Op, class TO, class TA>
+void vs(const TA* a, TO s, TO* out, std::size_t n) {
+    using V = simd::Vec<TO>;
+    using S = simd::Scalar<TO>;
+    const auto sv = V::set1(s);
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width)
+        V::store(out + i, Op::template apply<V>(V::load(a + i), sv));
+    for (; i < n; ++i)
+        S::store(out + i, Op::template apply<S>(S::load(a + i), s));
+}
+
+// out[i] = s op b[i]
+template <class Op, class TO, class TB>
+void sv(TO s, const TB* b, TO* out, std::size_t n) {
+    using V = simd::Vec<TO>;
+    using S = simd::Scalar<TO>;
+    const auto svec = V::set1(s);
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width)
+        V::store(out + i, Op::template apply<V>(svec, V::load(b + i)));
+    for (; i < n; ++i)
+        S::store(out + i, Op::template apply<S>(s, S::load(b + i)));
+}
+
+// out[i] = -a[i]
+template <class T>
+void neg(const T* a, T* out, std::size_t n) {
+    using V = simd::Vec<T>;
+    std::size_t i = 0;
+    for (; i + V::width <= n; i += V::width) V::store(out + i, V::neg(V::load(a + i)));
+    for (; i < n; ++i) out[i] = -a[i];
+}
+
+// sum(a[i] * b[i]) accumulated in double over rows that may arrive in
+// pieces; b is an array or one scalar for every row. Two independent
+// accumulators hide the latency of the FP add chain. Rows go through them
+// in the same 2 * width-row steps from the first row however they were
+// split, and rows short of a step wait (widened to double) for the next
+// add or for finish(), so the result never depends on the split.
+class DotRun {
+    using V = simd::Vec<double>;
+    static constexpr std::size_t step = 2 * V::width;
+
+public:
+    template <class TA, class B>
+    void add(const TA* a, B b, std::size_t n) {
+        std::size_t i = 0;
+        if (tail_) {
+            for (; tail_ < step && i < n; ++i, ++tail_) {
+                ta_[tail_] = static_cast<double>(a[i]);
+                tb_[tail_] = at(b, i);
+            }
+            if (tail_ < step) return;
+            add_step(ta_, tb_, 0);
+            tail_ = 0;
+        }
+        for (; i + step <= n; i += step) add_step(a + i, b, i);
+        for (; i < n; ++i, ++tail_) {
+            ta_[tail_] = static_cast<double>(a[i]);
+            tb_[tail_] = at(b, i);
+        }
+    }
+
+    double finish() const {
+        double acc = V::hsum(V::add(acc0_, acc1_));
+        for (std::size_t k = 0; k < tail_; ++k) acc += ta_[k] * tb_[k];
+        return acc;
+    }
+
+private:
+    template <class TB> static double at(const TB* b, std::size_t i) { return static_cast<double>(b[i]); }
+    static double at(double s, std::size_t) { return s; }
+    template <class TB> static V::type load(const TB* b, std::size_t i) { return V::load(b + i); }
+    static V::type load(double s, std::size_t) { return V::set1(s); }
+
+    template <class TA, class B>
+    void add_step(const TA* a, B b, std::size_t i) {
+        acc0_ = V::add(acc0_, V::mul(V::load(a), load(b, i)));
+        acc1_ = V::add(acc1_, V::mul(V::load(a + V::width), load(b, i + V::width)));
+    }
+
+    V::type acc0_ = V::zero();
+    V::type acc1_ = V::zero();
+    double ta_[step], tb_[step];
+    std::size_t tail_{0};
+};
+
+// sum(a[i] * b[i]) accumulated in double, for any mix of f32/f64 inputs.
+template <class TA, class TB>
+double dot(const TA* a, const TB* b, std::size_t n) {
+    DotRun run;
+    run.add(a, b, n);
+    return run.finish();
+}
+
+// sum(a[i] * s) accumulated in double.
+template <class TA>
+double dot_scalar(const TA* a, double s, std::size_t n) {
+    DotRun run;
+    run.add(a, s, n);
+    return run.finish();
+}
+
+// Sum of the terms of one bitmap word's `len` rows whose bit is set; invalid
+// lanes are zeroed with a bit mask. vec/one as for masked_sum().
+template <class VecTerm, class OneTerm>
+double masked_word(std::uint64_t bits, std::size_t len, VecTerm vec, OneTerm one) {
+    using V = simd::Vec<double>;
+    auto vacc = V::zero();
+    std::size_t i = 0;
+    for (; i + V::width <= len; i += V::width)
+        vacc = V::add(vacc, V::keep(vec(i), static_cast<unsigned>(bits >> i)));
+    double part = V::hsum(vacc);
+    for (; i < len; ++i)
+        if ((bits >> i) & 1u) part += one(i);
+    return part;
+}
+
+// Masked reduction over a validity bitmap: rows whose bit is clear add
+// nothing. Runs of full 64-row words go through the dense kernel in one call,
+// empty words are skipped, and partial words zero invalid lanes with a bit
+// mask, so there is no per-row branch and NaN placeholders in null slots never
+// leak into the sum.
+//   vec(i)          -> Vec<double> of the terms for rows [i, i + width)
+//   one(i)          -> the term for row i
+//   dense(i, len)   -> sum of the terms for rows [i, i + len), all valid
+template <class VecTerm, class OneTerm, class Dense>
+double masked_sum(const std::uint64_t* valid, std::size_t n, VecTerm vec, OneTerm one, Dense dense) {
+    constexpr std::uint64_t full = ~std::uint64_t{0};
+    const std::size_t full_words = n / 64;
+    const std::size_t words = (n + 63) / 64;
+    double acc = 0.0;
+    std::size_t w = 0;
+    // A trailing partial word with every row valid extends the run, so an
+    // all-valid bitmap sums exactly like dense(0, n).
+    const std::uint64_t tail = n % 64 ? (std::uint64_t{1} << (n % 64)) - 1 : full;
+    auto all_valid = [&](std::size_t w) { return valid[w] == (w < full_words ? full : tail); };
+    while (w < words) {
+        if (all_valid(w)) {
+            const std::size_t start = w;
+            while (w < words && all_valid(w)) ++w;
+            acc += dense(start * 64, std::min(n, w * 64) - start * 64);
+            continue;
+        }
+        const std::uint64_t bits = valid[w];
+        const std::size_t base = w * 64;
+        const std::size_t len = std::min<std::size_t>(64, n - base);
+        ++w;
+        if (bits == 0) continue;
+        acc += masked_word(bits, len, [&](std::size_t i) { return vec(base + i); },
+                           [&](std::size_t i) { return one(base + i); });
+    }
+    return acc;
+}
+
+template <class TA, class TB>
+double dot_masked(const TA* a, const TB* b, const std::uint64_t* valid, std::size_t n) {
+    using V = simd::Vec<double>;
+    return masked_sum(valid, n,
+        [&](std::size_t i) { return V::mul(V::load(a + i), V::load(b + i)); },
+        [&](std::size_t i) { return static_cast<double>(a[i]) * static_cast<double>(b[i]); },
+        [&](std::size_t i, std::size_t len) { return dot(a + i, b + i, len); });
+}
+
+template <class TA>
+double dot_scalar_masked(const TA* a, double s, const std::uint64_t* valid, std::size_t n) {
+    using V = simd::Vec<double>;
+    const auto sv = V::set1(s);
+    return masked_sum(valid, n,
+        [&](std::size_t i) { return V::mul(V::load(a + i), sv); },
+        [&](std::size_t i) { return static_cast<double>(a[i]) * s; },
+        [&](std::size_t i, std::size_t len) { return dot_scalar(a + i, s, len); });
+}
+
+// One leaf of dot_masked() / dot_scalar_masked(), or of dot() when every row
+// is valid, fed a row at a time for sums whose rows arrive in pieces. Rows
+// wait in the current 64-row word; a complete word with every row valid
+// extends the open DotRun and any other goes through masked_word(), as
+// masked_sum() splits them. finish() closes the trailing partial word the
+// same way, so it returns the one-shot leaf sum over the rows pushed so far
+// without revisiting them.
+class LeafDot {
+public:
+    void push(double a, double b, bool valid) {
+        a_[rows_] = a;
+        b_[rows_] = b;
+        if (valid) bits_ |= std::uint64_t{1} << rows_;
+        if (++rows_ == 64) {
+            close_word(acc_, run_, open_);
+            rows_ = 0;
+            bits_ = 0;
+        }
+    }
+
+    double finish() const {
+        double acc = acc_;
+        DotRun run = run_;
+        bool open = open_;
+        if (rows_) close_word(acc, run, open);
+        return open ? acc + run.finish() : acc;
+    }
+
+private:
+    // Fold the current word's rows into the sum so far.
+    void close_word(double& acc, DotRun& run, bool& open) const {
+        using V = simd::Vec<double>;
+        const std::uint64_t live = rows_ == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << rows_) - 1;
+        if (bits_ == live) {
+            run.add(a_, b_, rows_);
+            open = true;
+            return;
+        }
+        if (open) {
+            acc += run.finish();
+            run = DotRun{};
+            open = false;
+        }
+        if (bits_)
+            acc += masked_word(bits_, rows_, [&](std::size_t i) { return V::mul(V::load(a_ + i), V::load(b_ + i)); },
+                               [&](std::size_t i) { return a_[i] * b_[i]; });
+    }
+
+    double acc_{0.0}; // runs and words closed so far
+    DotRun run_;      // the open all-valid run
+    bool open_{false};
+    double a_[64], b_[64]; // the current word's rows
+    std::uint64_t bits_{0};
+    std::size_t rows_{0};
+};
+
+} // namespace ts::expr::kernels
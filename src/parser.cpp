@@ -1,6 +1,8 @@
 #include "tsexpr/parser.hpp"
 #include "tsexpr/lexer.hpp"
 #include "tsexpr/token.hpp"
+#include <cstdint>
+#include <iterator>
 #include <vector>
 
 namespace tsexpr {
@@ -147,6 +149,94 @@ static std::vector<Token> to_rpn(Lexer& lex, Token t0) {
     return output;
 }
 
+// Expression tree rebuilt from the flat code, used to place fork points.
+struct Node {
+    Instr ins;
+    std::vector<Node> kids;
+    double cost{0.0};
+};
+
+static std::size_t operand_count(const Instr& ins) {
+    switch (ins.op) {
+        case Op::Neg: return 1;
+        case Op::Add:
+        case Op::Sub:
+        case Op::Mul:
+        case Op::Div: return 2;
+        case Op::Call: return static_cast<std::size_t>(ins.argc);
+        default: return 0;
+    }
+}
+
+static double own_cost(const Instr& ins, const CompileOptions& opt) {
+    if (ins.op == Op::Call) return opt.call_cost;
+    return operand_count(ins) > 0 ? 1.0 : 0.0;
+}
+
+static Node build_tree(std::vector<Instr> code, const CompileOptions& opt) {
+    std::vector<Node> st;
+    for (auto& ins : code) {
+        Node n;
+        const std::size_t k = operand_count(ins);
+        if (k > st.size()) throw ParseError("Internal error: malformed RPN");
+        n.kids.assign(std::make_move_iterator(st.end() - static_cast<std::ptrdiff_t>(k)),
+                      std::make_move_iterator(st.end()));
+        st.resize(st.size() - k);
+        n.ins = std::move(ins);
+        n.cost = own_cost(n.ins, opt);
+        for (const auto& c : n.kids) n.cost += c.cost;
+        st.push_back(std::move(n));
+    }
+    if (st.size() != 1) throw ParseError("Internal error: malformed RPN");
+    return std::move(st.back());
+}
+
+// Emit `n` in RPN order. Among its expensive operands, all but the last are
+// forked; the last one and the cheap ones run inline, then a Join restores
+// operand order before the operator itself.
+static void emit(const Node& n, const CompileOptions& opt, std::vector<Instr>& out) {
+    std::uint32_t forked = 0;
+    if (n.kids.size() >= 2) {
+        std::vector<std::size_t> expensive;
+        for (std::size_t i = 0; i < n.kids.size() && i < 32; ++i)
+            if (n.kids[i].cost >= opt.fork_threshold) expensive.push_back(i);
+        if (expensive.size() >= 2) {
+            expensive.pop_back();
+            for (std::size_t i : expensive) forked |= std::uint32_t{1} << i;
+        }
+    }
+    for (std::size_t i = 0; i < n.kids.size(); ++i) {
+        if (!(forked & (std::uint32_t{1} << i))) {
+            emit(n.kids[i], opt, out);
+            continue;
+        }
+        const std::size_t at = out.size();
+        out.push_back(Instr{Op::Fork});
+        emit(n.kids[i], opt, out);
+        out[at].argc = static_cast<int>(out.size() - at - 1);
+    }
+    if (forked) {
+        Instr join{Op::Join};
+        join.argc = static_cast<int>(n.kids.size());
+        join.forked = forked;
+        out.push_back(std::move(join));
+    }
+    out.push_back(n.ins);
+}
+
+Program compile(std::string_view input, const CompileOptions& options) {
+    Program p = compile(input);
+    if (options.fork_threshold <= 0.0) return p;
+
+    Instr store = std::move(p.code.back());
+    p.code.pop_back();
+    const Node root = build_tree(std::move(p.code), options);
+    p.code.clear();
+    emit(root, options, p.code);
+    p.code.push_back(std::move(store));
+    return p;
+}
+
 Program compile(std::string_view input) {
     Lexer lex(input);
 
@@ -202,4 +292,94 @@ Program compile(std::string_view input) {
     return p;
 }
 
+// -----------------------------
+// bulk compilation
+// -----------------------------
+void NameTable::reserve(std::size_t n) {
+    names.reserve(n);
+    ids_.reserve(n);
+}
+
+std::uint32_t NameTable::intern(const std::string& name) {
+    auto [it, inserted] = ids_.try_emplace(name, static_cast<std::uint32_t>(names.size()));
+    if (inserted) names.push_back(name);
+    return it->second;
+}
+
+std::uint32_t NameTable::find(const std::string& name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? Instr::no_name : it->second;
+}
+
+std::size_t CompiledCatalog::failed() const noexcept {
+    std::size_t n = 0;
+    for (const auto& e : errors) n += e.has_value();
+    return n;
+}
+
+static bool has_name(const Instr& ins) {
+    return ins.op == Op::PushVar || ins.op == Op::Store || ins.op == Op::Call;
+}
+
+CompiledCatalog compile_many(const std::string_view* inputs, std::size_t count,
+                             const CompileOptions& options, ThreadPool& pool) {
+    CompiledCatalog out;
+    out.programs.resize(count);
+    out.errors.resize(count);
+
+    // Each chunk compiles its inputs and numbers their names locally, in
+    // order of first appearance. Merging the chunk tables in chunk order
+    // then gives the same ids as one serial pass, while the per-occurrence
+    // hashing runs in parallel.
+    constexpr std::size_t grain = 256;
+    struct ChunkNames {
+        std::vector<std::string_view> names; // views into the chunk's programs
+        std::vector<std::uint32_t> global;   // local id -> NameTable id
+    };
+    std::vector<ChunkNames> chunks((count + grain - 1) / grain);
+
+    pool.parallel_for(count, grain, [&](std::size_t b, std::size_t e) {
+        ChunkNames& cn = chunks[b / grain];
+        std::unordered_map<std::string_view, std::uint32_t> local;
+        for (std::size_t i = b; i < e; ++i) {
+            try {
+                out.programs[i] = compile(inputs[i], options);
+            } catch (const ParseError& err) {
+                out.errors[i] = err;
+                continue;
+            }
+            for (auto& ins : out.programs[i].code) {
+                if (!has_name(ins)) continue;
+                auto [it, inserted] = local.try_emplace(ins.text, static_cast<std::uint32_t>(cn.names.size()));
+                if (inserted) cn.names.push_back(ins.text);
+                ins.name_id = it->second;
+            }
+        }
+    });
+
+    auto names = std::make_shared<NameTable>();
+    std::size_t upper = 0;
+    for (const ChunkNames& cn : chunks) upper += cn.names.size();
+    names->reserve(upper);
+    for (ChunkNames& cn : chunks) {
+        cn.global.reserve(cn.names.size());
+        for (std::string_view n : cn.names) cn.global.push_back(names->intern(std::string(n)));
+    }
+
+    pool.parallel_for(count, grain, [&](std::size_t b, std::size_t e) {
+        const ChunkNames& cn = chunks[b / grain];
+        for (std::size_t i = b; i < e; ++i) {
+            for (auto& ins : out.programs[i].code)
+                if (has_name(ins)) ins.name_id = cn.global[ins.name_id];
+        }
+    });
+    out.names = std::move(names);
+    return out;
+}
+
+CompiledCatalog compile_many(const std::vector<std::string_view>& inputs,
+                             const CompileOptions& options, ThreadPool& pool) {
+    return compile_many(inputs.data(), inputs.size(), options, pool);
+}
+
 } // namespace tsexpr
@@ -0,0 +1,95 @@
+#include "tsexpr/resample.hpp"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace tsexpr {
+
+std::optional<ResampleKind> resample_kind(std::string_view fn) noexcept {
+    if (fn == "resample_first" || fn == "resample_open") return ResampleKind::First;
+    if (fn == "resample_last" || fn == "resample_close") return ResampleKind::Last;
+    if (fn == "resample_sum") return ResampleKind::Sum;
+    if (fn == "resample_mean") return ResampleKind::Mean;
+    if (fn == "resample_min" || fn == "resample_low") return ResampleKind::Min;
+    if (fn == "resample_max" || fn == "resample_high") return ResampleKind::Max;
+    if (fn == "resample_count") return ResampleKind::Count;
+    return std::nullopt;
+}
+
+BucketAggregator::BucketAggregator(ResampleKind kind, std::int64_t width) : kind_(kind), width_(width) {
+    if (width <= 0) throw std::invalid_argument("resample bucket width must be positive");
+}
+
+void BucketAggregator::clear() noexcept {
+    open_ = false;
+    start_ = last_t_ = 0;
+    count_ = 0;
+    non_finite_ = {};
+    value_ = 0.0;
+    sum_ = {};
+}
+
+std::optional<Bar> BucketAggregator::push(std::int64_t t, double x, bool present) {
+    if (open_ && t < last_t_) throw std::invalid_argument("resample timestamps must be non-decreasing");
+    std::optional<Bar> closed;
+    const std::int64_t start = bucket_start(t, width_);
+    if (!open_ || start != start_) {
+        if (open_) closed = current();
+        open_ = true;
+        start_ = start;
+        count_ = 0;
+        non_finite_ = {};
+        value_ = 0.0;
+        sum_ = {};
+    }
+    last_t_ = t;
+    if (!present) return closed;
+
+    switch (kind_) {
+        case ResampleKind::First:
+            if (count_ == 0) value_ = x;
+            break;
+        case ResampleKind::Last:
+            value_ = x;
+            break;
+        case ResampleKind::Sum:
+        case ResampleKind::Mean:
+            if (!non_finite_.count(x, true)) sum_.add(x);
+            break;
+        case ResampleKind::Min:
+        case ResampleKind::Max: {
+            // A NaN is only counted, so it wins whichever row it is; the
+            // first other row seeds value_.
+            if (non_finite_.count(x, true) && std::isnan(x)) break;
+            const bool is_min = kind_ == ResampleKind::Min;
+            if (count_ == non_finite_.nan || (is_min ? x < value_ : x > value_)) value_ = x;
+        } break;
+        case ResampleKind::Count:
+            break;
+    }
+    ++count_;
+    return closed;
+}
+
+std::optional<Bar> BucketAggregator::current() const {
+    if (!open_) return std::nullopt;
+    Bar bar;
+    bar.start = start_;
+    bar.present = count_ > 0 || kind_ == ResampleKind::Count;
+    switch (kind_) {
+        case ResampleKind::Sum: bar.value = non_finite_.sum().value_or(sum_.value()); break;
+        case ResampleKind::Mean:
+            bar.value = count_ ? non_finite_.sum().value_or(sum_.value() / double(count_)) : 0.0;
+            break;
+        case ResampleKind::Count: bar.value = double(count_); break;
+        case ResampleKind::Min:
+        case ResampleKind::Max:
+            bar.value = non_finite_.nan ? std::numeric_limits<double>::quiet_NaN() : count_ ? value_ : 0.0;
+            break;
+        default: bar.value = count_ ? value_ : 0.0; break;
+    }
+    return bar;
+}
+
+} // namespace tsexpr
@@ -0,0 +1,54 @@
+#include "tsexpr/result_cache.hpp"
+
+#include <cstring>
+
+namespace tsexpr {
+
+static void append(std::string& out, const void* data, std::size_t n) {
+    out.append(static_cast<const char*>(data), n);
+}
+
+std::string program_canonical(const Program& program) {
+    std::string out;
+    for (const Instr& ins : program.code) {
+        if (ins.op == Op::Fork || ins.op == Op::Join) continue;
+        const auto op = static_cast<unsigned char>(ins.op);
+        append(out, &op, 1);
+        switch (ins.op) {
+            case Op::PushNum: {
+                std::uint64_t bits;
+                std::memcpy(&bits, &ins.number, sizeof bits);
+                append(out, &bits, sizeof bits);
+            } break;
+            case Op::Call:
+                append(out, &ins.argc, sizeof ins.argc);
+                [[fallthrough]];
+            case Op::PushVar:
+            case Op::Store: {
+                // Length first, so adjacent names cannot run together.
+                const std::uint64_t n = ins.text.size();
+                append(out, &n, sizeof n);
+                out += ins.text;
+            } break;
+            default:
+                break;
+        }
+    }
+    return out;
+}
+
+std::uint64_t program_hash(std::string_view canonical) noexcept {
+    // FNV-1a.
+    std::uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : canonical) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::uint64_t program_hash(const Program& program) {
+    return program_hash(program_canonical(program));
+}
+
+} // namespace tsexpr
@@ -0,0 +1,119 @@
+#include "tsexpr/rolling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace tsexpr {
+
+std::optional<RollingKind> rolling_kind(std::string_view fn) noexcept {
+    if (fn == "rolling_sum") return RollingKind::Sum;
+    if (fn == "rolling_mean") return RollingKind::Mean;
+    if (fn == "rolling_std") return RollingKind::Std;
+    if (fn == "rolling_min") return RollingKind::Min;
+    if (fn == "rolling_max") return RollingKind::Max;
+    return std::nullopt;
+}
+
+RollingWindow::RollingWindow(RollingKind kind, std::size_t window) : kind_(kind), window_(window) {
+    if (window == 0) throw std::invalid_argument("rolling window must be at least 1 row");
+    ring_.assign(window, 0.0);
+    present_.assign(window, 0);
+}
+
+void RollingWindow::clear() {
+    rows_ = count_ = 0;
+    non_finite_ = {};
+    sum_ = {};
+    mean_ = m2_ = 0.0;
+    extrema_.clear();
+}
+
+void RollingWindow::add(double x) {
+    ++count_;
+    // Non-finite values are only counted; see CompensatedSum.
+    if (non_finite_.count(x, true)) {
+        // Min and Max order infinities like any other value.
+        const bool extremum = kind_ == RollingKind::Min || kind_ == RollingKind::Max;
+        if (!extremum || std::isnan(x)) return;
+    }
+    switch (kind_) {
+        case RollingKind::Sum:
+        case RollingKind::Mean:
+            sum_.add(x);
+            break;
+        case RollingKind::Std: {
+            const double d = x - mean_;
+            mean_ += d / double(finite());
+            m2_ += d * (x - mean_);
+            break;
+        }
+        case RollingKind::Min:
+        case RollingKind::Max: {
+            const bool is_min = kind_ == RollingKind::Min;
+            while (!extrema_.empty() && (is_min ? extrema_.back().second >= x : extrema_.back().second <= x))
+                extrema_.pop_back();
+            extrema_.emplace_back(rows_, x);
+            break;
+        }
+    }
+}
+
+void RollingWindow::remove(double x) {
+    --count_;
+    if (non_finite_.count(x, false)) return;
+    if (finite() == 0) {
+        // No finite value left: drop whatever rounding drift the updates left.
+        sum_ = {};
+        mean_ = m2_ = 0.0;
+        return;
+    }
+    switch (kind_) {
+        case RollingKind::Sum:
+        case RollingKind::Mean:
+            sum_.add(-x);
+            break;
+        case RollingKind::Std: {
+            const double d = x - mean_;
+            mean_ -= d / double(finite());
+            m2_ -= d * (x - mean_);
+            break;
+        }
+        case RollingKind::Min:
+        case RollingKind::Max:
+            break; // expired entries leave the deque front in push()
+    }
+}
+
+std::optional<double> RollingWindow::push(double x, bool present) {
+    const std::size_t slot = rows_ % window_;
+    if (rows_ >= window_ && present_[slot]) remove(ring_[slot]);
+    ring_[slot] = x;
+    present_[slot] = present;
+    if (present) add(x);
+    ++rows_;
+
+    if (kind_ == RollingKind::Min || kind_ == RollingKind::Max) {
+        while (!extrema_.empty() && extrema_.front().first + window_ < rows_) extrema_.pop_front();
+    }
+    if (rows_ < window_ || count_ < (kind_ == RollingKind::Std ? 2u : 1u)) return std::nullopt;
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    switch (kind_) {
+        case RollingKind::Sum:
+        case RollingKind::Mean:
+            if (const auto s = non_finite_.sum()) return *s;
+            return kind_ == RollingKind::Sum ? sum_.value() : sum_.value() / double(count_);
+        case RollingKind::Std:
+            if (finite() != count_) return nan;
+            return std::sqrt(std::max(m2_, 0.0) / double(count_ - 1));
+        case RollingKind::Min:
+        case RollingKind::Max:
+            if (non_finite_.nan) return nan;
+            return extrema_.front().second;
+    }
+    return std::nullopt;
+}
+
+} // namespace tsexpr
@@ -0,0 +1,105 @@
+#include "tsexpr/row_kernel.hpp"
+
+#include <algorithm>
+
+namespace tsexpr {
+
+namespace {
+
+// What a stack entry holds, as TimeSeries evaluation would see it.
+enum class Prec : std::uint8_t { Literal, F32, F64 };
+
+// F32 with F32 or a literal stays F32; literals alone stay literals.
+Prec combine(Prec a, Prec b) {
+    if (a == Prec::F64 || b == Prec::F64) return Prec::F64;
+    if (a == Prec::F32 || b == Prec::F32) return Prec::F32;
+    return Prec::Literal;
+}
+
+} // namespace
+
+RowKernel::RowKernel(const Program& program) {
+    std::vector<Prec> stack; // one entry per value on the row's stack
+    auto pop = [&] {
+        if (stack.empty()) throw EvalError("Stack underflow (bad program)");
+        const Prec p = stack.back();
+        stack.pop_back();
+        return p;
+    };
+    auto push = [&](Prec p) {
+        if (stack.size() == max_depth) throw EvalError("Row kernel: expression deeper than " + std::to_string(max_depth));
+        stack.push_back(p);
+    };
+
+    for (std::size_t pc = 0; pc < program.code.size(); ++pc) {
+        const Instr& ins = program.code[pc];
+        switch (ins.op) {
+            case Op::PushVar: {
+                auto it = std::find(inputs_.begin(), inputs_.end(), ins.text);
+                if (it == inputs_.end()) it = inputs_.insert(inputs_.end(), ins.text);
+                push(Prec::F64);
+                steps_.push_back(Step{Kind::Load, Rhs::Stack, false, std::uint32_t(it - inputs_.begin()), 0.0});
+            } break;
+
+            case Op::PushNum:
+                push(Prec::Literal);
+                steps_.push_back(Step{Kind::Const, Rhs::Stack, false, 0, ins.number});
+                break;
+
+            case Op::Add:
+            case Op::Sub:
+            case Op::Mul:
+            case Op::Div: {
+                const Prec b = pop();
+                const Prec p = combine(pop(), b);
+                push(p);
+                const bool single = p == Prec::F32;
+                const Kind kind = ins.op == Op::Add   ? Kind::Add
+                                  : ins.op == Op::Sub ? Kind::Sub
+                                  : ins.op == Op::Mul ? Kind::Mul
+                                                      : Kind::Div;
+                // A load or literal just pushed is the right operand: read it
+                // in place instead of going through the stack.
+                if (!steps_.empty() && (steps_.back().kind == Kind::Load || steps_.back().kind == Kind::Const)) {
+                    Step& rhs = steps_.back();
+                    rhs.rhs = rhs.kind == Kind::Load ? Rhs::Slot : Rhs::Const;
+                    rhs.kind = kind;
+                    rhs.single = single;
+                } else {
+                    steps_.push_back(Step{kind, Rhs::Stack, single, 0, 0.0});
+                }
+            } break;
+
+            case Op::Neg:
+                push(pop());
+                steps_.push_back(Step{Kind::Neg, Rhs::Stack, false, 0, 0.0});
+                break;
+
+            case Op::Call:
+                if (ins.argc != 1 || (ins.text != "float32" && ins.text != "float64"))
+                    throw EvalError("Row kernel cannot evaluate " + ins.text + "()");
+                if (const Prec p = pop(); p == Prec::Literal) {
+                    push(p); // casts leave literals alone
+                } else if (ins.text == "float32") {
+                    push(Prec::F32);
+                    if (p == Prec::F64) steps_.push_back(Step{Kind::Float32, Rhs::Stack, false, 0, 0.0});
+                } else {
+                    push(Prec::F64);
+                }
+                break;
+
+            case Op::Store:
+                if (pc + 1 != program.code.size() || stack.size() != 1)
+                    throw EvalError("Row kernel needs a single assignment");
+                target_ = ins.text;
+                break;
+
+            case Op::Fork:
+            case Op::Join:
+                break; // scheduling only: the code in between is in RPN order
+        }
+    }
+    if (target_.empty()) throw EvalError("Row kernel needs a single assignment");
+}
+
+} // namespace tsexpr
@@ -0,0 +1,59 @@
+#include "tsexpr/scheduler.hpp"
+
+#include <algorithm>
+
+namespace tsexpr {
+
+void DependencyGraph::add_edge(std::size_t from, std::size_t to) {
+    if (from == npos || from == to) return;
+    auto& succ = nodes_[from].succ;
+    // Edges into `to` are added while `to` is the newest node, so a repeat
+    // can only be the last entry.
+    if (!succ.empty() && succ.back() == to) return;
+    succ.push_back(to);
+    ++nodes_[to].preds;
+}
+
+void DependencyGraph::add(const std::vector<std::string>& reads, const std::vector<std::string>& writes) {
+    const std::size_t id = nodes_.size();
+    nodes_.emplace_back();
+
+    for (const auto& name : reads) {
+        VarState& v = vars_[name];
+        add_edge(v.writer, id);                                        // read-after-write
+    }
+    for (const auto& name : writes) {
+        VarState& v = vars_[name];
+        add_edge(v.writer, id);                                        // write-after-write
+        for (std::size_t r : v.readers) add_edge(r, id);               // write-after-read
+    }
+    // Update the variable states only after all edges are in, so a
+    // statement that reads and writes the same variable (x = x + 1) still
+    // depends on the previous writer and readers of x.
+    for (const auto& name : reads) {
+        auto& readers = vars_[name].readers;
+        if (readers.empty() || readers.back() != id) readers.push_back(id);
+    }
+    for (const auto& name : writes) {
+        VarState& v = vars_[name];
+        v.writer = id;
+        v.readers.clear();
+    }
+}
+
+DependencyGraph DependencyGraph::from_programs(const std::vector<Program>& programs) {
+    DependencyGraph g;
+    std::vector<std::string> reads, writes;
+    for (const Program& p : programs) {
+        reads.clear();
+        writes.clear();
+        for (const Instr& ins : p.code) {
+            if (ins.op == Op::PushVar) reads.push_back(ins.text);
+            else if (ins.op == Op::Store) writes.push_back(ins.text);
+        }
+        g.add(reads, writes);
+    }
+    return g;
+}
+
+} // namespace tsexpr
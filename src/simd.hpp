@@ -0,0 +1,149 @@
+#pragma once
+// Internal: minimal fixed-width SIMD wrappers for the series kernels.
+//
+// Vec<T> exposes the same static interface for every target so kernels are
+// written once: width, zero/set1, load/store, add/sub/mul/div/neg, hsum, and
+// (double only) keep, which zeroes lanes by a validity bit mask.
+// Vec<double>::load also accepts a float pointer and widens on load, which is
+// how mixed-precision kernels promote f32 inputs without a temporary buffer.
+// Scalar<T> is the width-1 fallback and is also used for loop tails.
+
+#include <cstddef>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define TSEXPR_SIMD_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TSEXPR_SIMD_SSE2 1
+#endif
+
+namespace ts::expr::simd {
+
+template <class T>
+struct Scalar {
+    using type = T;
+    static constexpr std::size_t width = 1;
+
+    static type zero() { return T(0); }
+    static type set1(T x) { return x; }
+    template <class U> static type load(const U* p) { return static_cast<T>(*p); }
+    static void store(T* p, type x) { *p = x; }
+
+    static type add(type a, type b) { return a + b; }
+    static type sub(type a, type b) { return a - b; }
+    static type mul(type a, type b) { return a * b; }
+    static type div(type a, type b) { return a / b; }
+    static type neg(type a) { return -a; }
+    static T hsum(type a) { return a; }
+    static type keep(type a, unsigned bits) { return (bits & 1u) ? a : T(0); }
+};
+
+#if defined(TSEXPR_SIMD_AVX)
+
+template <class T> struct Vec;
+
+template <>
+struct Vec<double> {
+    using type = __m256d;
+    static constexpr std::size_t width = 4;
+
+    static type zero() { return _mm256_setzero_pd(); }
+    static type set1(double x) { return _mm256_set1_pd(x); }
+    static type load(const double* p) { return _mm256_loadu_pd(p); }
+    static type load(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+    static void store(double* p, type x) { _mm256_storeu_pd(p, x); }
+
+    static type add(type a, type b) { return _mm256_add_pd(a, b); }
+    static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+    static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+    static type div(type a, type b) { return _mm256_div_pd(a, b); }
+    static type neg(type a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+    static double hsum(type a) {
+        __m128d lo = _mm256_castpd256_pd128(a);
+        __m128d hi = _mm256_extractf128_pd(a, 1);
+        lo = _mm_add_pd(lo, hi);
+        return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+    }
+    // Zero the lanes whose bit (lane 0 = bit 0) is clear.
+    static type keep(type a, unsigned bits) {
+        const __m256i m = _mm256_set_epi64x(-static_cast<long long>((bits >> 3) & 1u),
+                                            -static_cast<long long>((bits >> 2) & 1u),
+                                            -static_cast<long long>((bits >> 1) & 1u),
+                                            -static_cast<long long>(bits & 1u));
+        return _mm256_and_pd(a, _mm256_castsi256_pd(m));
+    }
+};
+
+template <>
+struct Vec<float> {
+    using type = __m256;
+    static constexpr std::size_t width = 8;
+
+    static type zero() { return _mm256_setzero_ps(); }
+    static type set1(float x) { return _mm256_set1_ps(x); }
+    static type load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, type x) { _mm256_storeu_ps(p, x); }
+
+    static type add(type a, type b) { return _mm256_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+    static type div(type a, type b) { return _mm256_div_ps(a, b); }
+    static type neg(type a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+};
+
+#elif defined(TSEXPR_SIMD_SSE2)
+
+template <class T> struct Vec;
+
+template <>
+struct Vec<double> {
+    using type = __m128d;
+    static constexpr std::size_t width = 2;
+
+    static type zero() { return _mm_setzero_pd(); }
+    static type set1(double x) { return _mm_set1_pd(x); }
+    static type load(const double* p) { return _mm_loadu_pd(p); }
+    static type load(const float* p) {
+        return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+    }
+    static void store(double* p, type x) { _mm_storeu_pd(p, x); }
+
+    static type add(type a, type b) { return _mm_add_pd(a, b); }
+    static type sub(type a, type b) { return _mm_sub_pd(a, b); }
+    static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+    static type div(type a, type b) { return _mm_div_pd(a, b); }
+    static type neg(type a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+    static double hsum(type a) { return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a))); }
+    // Zero the lanes whose bit (lane 0 = bit 0) is clear.
+    static type keep(type a, unsigned bits) {
+        const __m128i m = _mm_set_epi64x(-static_cast<long long>((bits >> 1) & 1u),
+                                         -static_cast<long long>(bits & 1u));
+        return _mm_and_pd(a, _mm_castsi128_pd(m));
+    }
+};
+
+template <>
+struct Vec<float> {
+    using type = __m128;
+    static constexpr std::size_t width = 4;
+
+    static type zero() { return _mm_setzero_ps(); }
+    static type set1(float x) { return _mm_set1_ps(x); }
+    static type load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, type x) { _mm_storeu_ps(p, x); }
+
+    static type add(type a, type b) { return _mm_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+    static type div(type a, type b) { return _mm_div_ps(a, b); }
+    static type neg(type a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+};
+
+#else
+
+template <class T> struct Vec : Scalar<T> {};
+
+#endif
+
+} // namespace ts::expr::simd
@@ -0,0 +1,548 @@
+#include <tsexpr/streaming.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <variant>
+
+#include "kernels.hpp"
+
+namespace ts::expr {
+
+static bool row_local(const Token& t) {
+    switch (t.kind) {
+        case TokKind::Ident:
+        case TokKind::Number:
+        case TokKind::Plus:
+        case TokKind::Minus:
+        case TokKind::Star:
+        case TokKind::Slash:
+        case TokKind::Neg:
+            return true;
+        case TokKind::Func:
+            return t.text == "float32" || t.text == "float64";
+        default:
+            return false;
+    }
+}
+
+// For every token, the index of the first token of the operand it closes
+// (itself for leaves). A Func at i has its last argument at [start[i-1], i).
+static std::vector<std::size_t> subtree_starts(const std::vector<Token>& rpn, const std::string& target) {
+    std::vector<std::size_t> start(rpn.size()), pending;
+    for (std::size_t i = 0; i < rpn.size(); ++i) {
+        const Token& t = rpn[i];
+        int operands = 0;
+        if (t.kind == TokKind::Func) operands = t.arity;
+        else if (t.kind == TokKind::Neg) operands = 1;
+        else if (t.kind != TokKind::Ident && t.kind != TokKind::Number) operands = 2;
+
+        start[i] = i;
+        for (int k = 0; k < operands; ++k) {
+            if (pending.empty()) throw ParseError("Malformed expression: " + target);
+            start[i] = pending.back();
+            pending.pop_back();
+        }
+        pending.push_back(start[i]);
+    }
+    return start;
+}
+
+StreamingAssignment::StreamingAssignment(std::string_view input) : c_(compile(input)) {
+    const std::vector<Token>& rpn = c_.rpn;
+    const std::vector<std::size_t> start = subtree_starts(rpn, c_.target);
+    // The statement with every recursive filter call replaced by a variable
+    // holding its output; at[i] is where token i landed in it.
+    std::vector<Token> rewritten;
+    std::vector<std::size_t> at(rpn.size());
+
+    for (std::size_t i = 0; i < rpn.size(); ++i) {
+        const Token& t = rpn[i];
+        const Token* param = i > 0 ? &rpn[i - 1] : nullptr;
+        const bool literal = param && t.kind == TokKind::Func && t.arity == 2 && param->kind == TokKind::Number;
+
+        if (literal && tsexpr::rolling_kind(t.text)) {
+            // Needs window - 1 rows of history before the new ones; nested
+            // calls add up.
+            const double w = param->number;
+            if (!(w >= 1 && w < 1e9) || w != std::floor(w))
+                throw ParseError(t.text + " window must be a positive integer: " + c_.target);
+            for (const Recursive& r : recursive_)
+                if (r.token >= start[i])
+                    throw ParseError("Streaming assignment cannot roll a window over a recursive filter: " + c_.target);
+            lookback_ += static_cast<std::size_t>(w) - 1;
+        } else if (literal && tsexpr::ewm_kind(t.text)) {
+            // Carries its state across updates instead of replaying history.
+            const std::size_t arg_end = start[i - 1];
+            for (std::size_t j = start[i]; j < arg_end; ++j)
+                if (!row_local(rpn[j]))
+                    throw ParseError(t.text + " argument must be row-local in a streaming assignment: " + c_.target);
+            std::optional<tsexpr::EwmFilter> filter;
+            try {
+                filter.emplace(*tsexpr::ewm_kind(t.text), param->number);
+            } catch (const std::invalid_argument& e) {
+                throw ParseError(std::string(e.what()) + ": " + c_.target);
+            }
+            Recursive r{std::vector<Token>(rpn.begin() + std::ptrdiff_t(start[i]), rpn.begin() + std::ptrdiff_t(arg_end)),
+                        *filter, "`" + std::to_string(recursive_.size()), i};
+            rewritten.resize(at[start[i]]);
+            Token var;
+            var.kind = TokKind::Ident;
+            var.text = r.name;
+            rewritten.push_back(std::move(var));
+            recursive_.push_back(std::move(r));
+            at[i] = rewritten.size() - 1;
+            continue;
+        } else if (!row_local(t)) {
+            throw ParseError("Streaming assignment must be row-local, rolling or a recursive filter with a literal "
+                             "parameter: " + c_.target);
+        }
+        if (t.kind == TokKind::Ident && std::find(inputs_.begin(), inputs_.end(), t.text) == inputs_.end())
+            inputs_.push_back(t.text);
+        rewritten.push_back(t);
+        at[i] = rewritten.size() - 1;
+    }
+    if (inputs_.empty()) throw ParseError("Streaming assignment needs at least one series input: " + c_.target);
+    c_.rpn = std::move(rewritten);
+}
+
+// Rows [b, e) of `s` as an unindexed series: a view sharing its values.
+static TimeSeries slice_rows(const TimeSeries& s, std::size_t b, std::size_t e) {
+    return s.with_index(nullptr).slice(b, e).unshifted();
+}
+
+// `s` (F64) preceded by k null rows.
+static TimeSeries pad_front(const TimeSeries& s, std::size_t k) {
+    std::vector<double> v(k + s.size());
+    auto valid = std::make_shared<ValidityBitmap>(v.size());
+    for (std::size_t i = 0; i < k; ++i) valid->set(i, false);
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        v[k + i] = s[i];
+        valid->set(k + i, s.is_valid(i));
+    }
+    return TimeSeries{std::move(v)}.with_validity(std::move(valid));
+}
+
+// The named inputs, checked to have equal lengths. `indexed` is set to the
+// first timestamped input, if any.
+static std::vector<const TimeSeries*> find_inputs(const Env& env, const std::vector<std::string>& names,
+                                                  const std::string& target, const TimeSeries*& indexed) {
+    std::vector<const TimeSeries*> in;
+    in.reserve(names.size());
+    for (const auto& name : names) {
+        auto it = env.find(name);
+        if (it == env.end()) throw EvalError("Unknown variable: " + name);
+        in.push_back(&it->second);
+    }
+    const std::size_t n = in.front()->size();
+    indexed = nullptr;
+    for (const TimeSeries* s : in) {
+        if (s->size() != n) throw EvalError("Streaming inputs must have equal lengths: " + target);
+        if (s->has_index() && !indexed) indexed = s;
+    }
+    return in;
+}
+
+// Timestamped inputs must agree on rows [from, n).
+static void check_timestamps(const std::vector<const TimeSeries*>& in, const TimeSeries* indexed,
+                             std::size_t from, const std::string& target) {
+    if (!indexed) return;
+    for (const TimeSeries* s : in) {
+        if (!s->has_index()) throw EvalError("Streaming inputs must all be timestamped or all positional");
+        if (s->index() == indexed->index()) continue;
+        if (!std::equal(s->index()->begin() + from, s->index()->end(), indexed->index()->begin() + from))
+            throw EvalError("Streaming inputs disagree on timestamps: " + target);
+    }
+}
+
+TimeSeries StreamingAssignment::evaluate_rows(Env rows, std::size_t context) {
+    // Recursive filters only see the new rows; their carried state stands
+    // in for the history.
+    for (Recursive& r : recursive_) {
+        Value a = eval_rpn(r.arg, rows);
+        if (!std::holds_alternative<TimeSeries>(a)) throw EvalError("Recursive filter expects a series");
+        const TimeSeries& x = std::get<TimeSeries>(a);
+        TimeSeries y = ewm(r.filter, context ? slice_rows(x, context, x.size()) : x);
+        rows.emplace(r.name, context ? pad_front(y, context) : std::move(y));
+    }
+    Value v = eval_rpn(c_.rpn, rows);
+    if (!std::holds_alternative<TimeSeries>(v)) throw EvalError("Streaming assignment must produce a series");
+    TimeSeries& fresh = std::get<TimeSeries>(v);
+    return context ? slice_rows(fresh, context, fresh.size()) : fresh.unshifted();
+}
+
+void StreamingAssignment::clear_filters() noexcept {
+    for (Recursive& r : recursive_) r.filter.clear();
+}
+
+std::size_t StreamingAssignment::update(Env& env) {
+    const TimeSeries* indexed = nullptr;
+    const std::vector<const TimeSeries*> in = find_inputs(env, inputs_, c_.target, indexed);
+    const std::size_t n = in.front()->size();
+
+    auto target = env.find(c_.target);
+    bool full = high_water_ == 0 || n < high_water_ || target == env.end() ||
+                target->second.generation() != target_generation_ || generations_.size() != in.size();
+    for (std::size_t k = 0; !full && k < in.size(); ++k) full = in[k]->generation() != generations_[k];
+    const std::size_t from = full ? 0 : high_water_;
+    check_timestamps(in, indexed, from, c_.target);
+    if (!full && from == n) return 0;
+    if (full) clear_filters();
+
+    try {
+        // Evaluate from `lookback_` rows earlier so rolling windows are
+        // complete, then keep only the new rows.
+        const std::size_t context = from - std::min(from, lookback_);
+        Env rows;
+        for (std::size_t k = 0; k < in.size(); ++k) rows.emplace(inputs_[k], slice_rows(*in[k], context, n));
+        TimeSeries fresh = evaluate_rows(std::move(rows), from - context);
+
+        if (full) {
+            env[c_.target] = indexed ? fresh.with_index(indexed->index()) : std::move(fresh);
+            target = env.find(c_.target);
+        } else if (target->second.dtype() != fresh.dtype()) {
+            // The input dtypes changed under us: redo the whole history.
+            high_water_ = 0;
+            env.erase(target);
+            return update(env);
+        } else {
+            // Grows the target's own buffers in place; it takes copies of
+            // the new timestamps rather than sharing the input's index,
+            // which would make the input copy its index on every append.
+            if (indexed) {
+                const TimeIndex& ts = *indexed->index();
+                fresh = fresh.with_index(std::make_shared<const TimeIndex>(ts.begin() + std::ptrdiff_t(from), ts.end()));
+            }
+            target->second.append(fresh);
+        }
+    } catch (...) {
+        high_water_ = 0; // filter states may have moved on: start over next time
+        throw;
+    }
+    high_water_ = n;
+    target_generation_ = target->second.generation();
+    generations_.clear();
+    for (const TimeSeries* s : in) generations_.push_back(s->generation());
+    return n - from;
+}
+
+// Holds the internal leaf kernel, hence defined here.
+struct StreamingReduction::Site {
+    std::vector<Token> lhs, rhs; // argument expressions (RPN)
+    std::size_t slot{0};         // its placeholder in outer_
+    tsexpr::LeafTree leaves;     // completed leaves
+    kernels::LeafDot partial;    // the trailing leaf's rows
+    std::size_t pending{0};      // and how many there are
+};
+
+StreamingReduction::StreamingReduction(const StreamingReduction&) = default;
+StreamingReduction::StreamingReduction(StreamingReduction&&) noexcept = default;
+StreamingReduction& StreamingReduction::operator=(const StreamingReduction&) = default;
+StreamingReduction& StreamingReduction::operator=(StreamingReduction&&) noexcept = default;
+StreamingReduction::~StreamingReduction() = default;
+
+StreamingReduction::StreamingReduction(std::string_view input) {
+    Compiled c = compile(input);
+    target_ = std::move(c.target);
+    const std::vector<Token>& rpn = c.rpn;
+
+    // at[i] is where token i landed in outer_; an operand always starts
+    // with a leaf, and leaves are copied one-to-one.
+    const std::vector<std::size_t> start = subtree_starts(rpn, target_);
+    std::vector<std::size_t> at(rpn.size());
+    for (std::size_t i = 0; i < rpn.size(); ++i) {
+        const Token& t = rpn[i];
+        if (t.kind == TokKind::Func && t.text == "sumproduct") {
+            if (t.arity != 2) throw ParseError("sumproduct expects 2 arguments");
+            const std::size_t second = start[i - 1];
+            Site site;
+            site.lhs.assign(rpn.begin() + std::ptrdiff_t(start[i]), rpn.begin() + std::ptrdiff_t(second));
+            site.rhs.assign(rpn.begin() + std::ptrdiff_t(second), rpn.begin() + std::ptrdiff_t(i));
+            bool series = false;
+            for (const auto* arg : {&site.lhs, &site.rhs}) {
+                for (const Token& a : *arg) {
+                    if (!row_local(a))
+                        throw ParseError("sumproduct arguments must be row-local in a streaming reduction: " + target_);
+                    if (a.kind != TokKind::Ident) continue;
+                    series = true;
+                    if (std::find(inputs_.begin(), inputs_.end(), a.text) == inputs_.end()) inputs_.push_back(a.text);
+                }
+            }
+            if (!series) throw ParseError("sumproduct needs a series argument in a streaming reduction: " + target_);
+
+            outer_.resize(at[start[i]]);
+            site.slot = outer_.size();
+            Token placeholder;
+            placeholder.kind = TokKind::Number;
+            outer_.push_back(placeholder);
+            sites_.push_back(std::move(site));
+        } else {
+            outer_.push_back(t);
+        }
+        at[i] = outer_.size() - 1;
+    }
+
+    for (const Token& t : outer_) {
+        if (t.kind == TokKind::Ident)
+            throw ParseError("Streaming reduction uses a series outside sumproduct: " + target_);
+        if (t.kind == TokKind::Func && t.text != "float32" && t.text != "float64")
+            throw ParseError("Streaming reduction supports only sumproduct: " + target_);
+    }
+    if (sites_.empty()) throw ParseError("Streaming reduction needs a sumproduct: " + target_);
+}
+
+// Row access to a sumproduct argument; a scalar stands for every row.
+struct ArgRows {
+    const TimeSeries* ts{nullptr};
+    double scalar{0.0};
+
+    explicit ArgRows(const Value& v) {
+        if (const auto* s = std::get_if<TimeSeries>(&v)) ts = s;
+        else scalar = std::get<double>(v);
+    }
+    double value(std::size_t i) const { return ts ? (*ts)[i] : scalar; }
+    bool valid(std::size_t i) const { return !ts || ts->is_valid(i); }
+};
+
+void StreamingReduction::fold(const Env& rows) {
+    constexpr std::size_t leaf = tsexpr::reduce_leaf_rows;
+    for (Site& site : sites_) {
+        const Value a = eval_rpn(site.lhs, rows);
+        const Value b = eval_rpn(site.rhs, rows);
+        const ArgRows x(a), y(b);
+        const std::size_t n = x.ts ? x.ts->size() : y.ts->size();
+        // Row by row through the leaf kernel, closing each leaf that fills up.
+        for (std::size_t i = 0; i < n; ++i) {
+            site.partial.push(x.value(i), y.value(i), x.valid(i) && y.valid(i));
+            if (++site.pending < leaf) continue;
+            site.leaves.add_leaf(site.partial.finish());
+            site.partial = kernels::LeafDot{};
+            site.pending = 0;
+        }
+    }
+}
+
+double StreamingReduction::result() {
+    for (const Site& site : sites_)
+        outer_[site.slot].number = site.pending ? site.leaves.total(site.partial.finish()) : site.leaves.total();
+    return std::get<double>(eval_rpn(outer_, Env{}));
+}
+
+void StreamingReduction::clear_sums() noexcept {
+    for (Site& site : sites_) {
+        site.leaves.clear();
+        site.partial = kernels::LeafDot{};
+        site.pending = 0;
+    }
+}
+
+std::size_t StreamingReduction::update(Env& env) {
+    const TimeSeries* indexed = nullptr;
+    const std::vector<const TimeSeries*> in = find_inputs(env, inputs_, target_, indexed);
+    const std::size_t n = in.front()->size();
+
+    bool intact = n >= high_water_ && generations_.size() == in.size();
+    for (std::size_t k = 0; intact && k < in.size(); ++k) intact = in[k]->generation() == generations_[k];
+    if (!intact) high_water_ = 0;
+    const std::size_t from = high_water_;
+    check_timestamps(in, indexed, from, target_);
+
+    if (from == 0) {
+        ++recomputes_;
+        clear_sums();
+    }
+    if (from < n) {
+        Env rows;
+        for (std::size_t k = 0; k < in.size(); ++k) rows.emplace(inputs_[k], slice_rows(*in[k], from, n));
+        try {
+            fold(rows);
+        } catch (...) {
+            high_water_ = 0; // some sums may hold the rows: start over next time
+            throw;
+        }
+    }
+    env[target_] = TimeSeries::from_scalar(result());
+
+    high_water_ = n;
+    generations_.clear();
+    for (const TimeSeries* s : in) generations_.push_back(s->generation());
+    return n - from;
+}
+
+// The aggregator of `bar = resample_*(x, width)`, checked for that shape.
+static tsexpr::BucketAggregator resample_call(const Compiled& c) {
+    const std::vector<Token>& rpn = c.rpn;
+    const auto kind = rpn.size() == 3 ? tsexpr::resample_kind(rpn[2].text) : std::nullopt;
+    if (!kind || rpn[2].kind != TokKind::Func || rpn[2].arity != 2 || rpn[0].kind != TokKind::Ident ||
+        rpn[1].kind != TokKind::Number)
+        throw ParseError("Streaming resample must be resample_*(variable, width): " + c.target);
+    const double w = rpn[1].number;
+    if (!(w >= 1 && w < 9e18) || w != std::floor(w))
+        throw ParseError(rpn[2].text + " width must be a positive integer: " + c.target);
+    return tsexpr::BucketAggregator(*kind, static_cast<std::int64_t>(w));
+}
+
+StreamingResample::StreamingResample(std::string_view input)
+    : StreamingResample(compile(input)) {}
+
+StreamingResample::StreamingResample(const Compiled& c)
+    : target_(c.target), input_(c.rpn.empty() ? std::string() : c.rpn[0].text), agg_(resample_call(c)) {}
+
+// `bars` as a timestamped series: bucket starts, values, and a validity
+// bitmap if any bar is null.
+static TimeSeries bar_rows(std::vector<tsexpr::Bar>::const_iterator b, std::vector<tsexpr::Bar>::const_iterator e) {
+    TimeIndex index;
+    std::vector<double> values;
+    std::vector<bool> present;
+    for (auto it = b; it != e; ++it) {
+        index.push_back(it->start);
+        values.push_back(it->value);
+        present.push_back(it->present);
+    }
+    TimeSeries out{std::move(index), std::move(values)};
+    if (std::find(present.begin(), present.end(), false) == present.end()) return out;
+    return out.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(present)));
+}
+
+std::size_t StreamingResample::update(Env& env) {
+    auto in = env.find(input_);
+    if (in == env.end()) throw EvalError("Unknown variable: " + input_);
+    const TimeSeries& x = in->second;
+    if (!x.has_index()) throw EvalError("Streaming resample needs a timestamped input: " + target_);
+    const std::size_t n = x.size();
+    const TimeIndex& ts = *x.index();
+
+    auto target = env.find(target_);
+    const bool full = high_water_ == 0 || n < high_water_ || x.generation() != generation_ ||
+                      target == env.end() || target->second.generation() != target_generation_;
+    const std::size_t from = full ? 0 : high_water_;
+    if (!full && from == n) return 0;
+    if (full) agg_.clear();
+
+    try {
+        std::vector<tsexpr::Bar> fresh;
+        for (std::size_t i = from; i < n; ++i)
+            if (auto closed = agg_.push(ts[i], x[i], x.is_valid(i))) fresh.push_back(*closed);
+        if (auto current = agg_.current()) fresh.push_back(*current);
+
+        if (full) {
+            env[target_] = bar_rows(fresh.begin(), fresh.end());
+            target = env.find(target_);
+        } else {
+            // fresh[0] is the previous trailing bar: same bucket, new value.
+            TimeSeries& bars = target->second;
+            const std::size_t last = bars.size() - 1;
+            bars.mutable_values()[last] = fresh[0].value;
+            if (bars.is_valid(last) != fresh[0].present) bars.set_valid(last, fresh[0].present);
+            if (fresh.size() > 1) bars.append(bar_rows(fresh.begin() + 1, fresh.end()));
+        }
+    } catch (const std::invalid_argument& e) {
+        high_water_ = 0;
+        throw EvalError("Streaming resample: " + std::string(e.what()) + ": " + target_);
+    } catch (...) {
+        high_water_ = 0;
+        throw;
+    }
+    high_water_ = n;
+    generation_ = x.generation();
+    target_generation_ = target->second.generation();
+    return n - from;
+}
+
+ChunkedEvaluation::ChunkedEvaluation(std::string_view input, std::size_t max_chunk_rows)
+    : max_chunk_rows_(max_chunk_rows) {
+    if (max_chunk_rows == 0) throw std::invalid_argument("chunked evaluation needs at least 1 row per chunk");
+    const Compiled c = compile(input);
+    const bool reduces = std::any_of(c.rpn.begin(), c.rpn.end(), [](const Token& t) {
+        return t.kind == TokKind::Func && t.text == "sumproduct";
+    });
+    if (reduces) reduction_.emplace(input);
+    else assignment_.emplace(input);
+}
+
+const std::string& ChunkedEvaluation::target() const noexcept {
+    return reduction_ ? reduction_->target() : assignment_->target();
+}
+
+const std::vector<std::string>& ChunkedEvaluation::inputs() const noexcept {
+    return reduction_ ? reduction_->inputs() : assignment_->inputs();
+}
+
+// `history` followed by the rows of `s`, unindexed, in one owned buffer.
+static TimeSeries concat_rows(const TimeSeries& history, const TimeSeries& s) {
+    TimeSeries out = history.dtype() == s.dtype() ? history : history.astype(s.dtype());
+    out.append(s);
+    return out;
+}
+
+std::size_t ChunkedEvaluation::run(const ChunkSource& source, const ChunkSink& sink) {
+    const std::vector<std::string>& names = inputs();
+    const std::size_t m = names.size();
+    std::vector<ChunkReader> readers;
+    readers.reserve(m);
+    for (const auto& name : names) readers.push_back(source(name));
+
+    // Per input: the chunk being consumed and the next row in it, and the
+    // last lookback() rows already evaluated (context for rolling windows).
+    std::vector<TimeSeries> chunk(m), history(m);
+    std::vector<std::size_t> pos(m, 0);
+    std::size_t context = 0;
+    const std::size_t lookback = assignment_ ? assignment_->lookback() : 0;
+    if (assignment_) assignment_->clear_filters();
+    else reduction_->clear_sums();
+
+    std::size_t total = 0;
+    for (;;) {
+        std::size_t ended = 0, n = max_chunk_rows_;
+        for (std::size_t k = 0; k < m; ++k) {
+            while (pos[k] == chunk[k].size()) {
+                std::optional<TimeSeries> next = readers[k]();
+                if (!next) break;
+                chunk[k] = std::move(*next);
+                pos[k] = 0;
+            }
+            if (pos[k] == chunk[k].size()) ++ended;
+            else n = std::min(n, chunk[k].size() - pos[k]);
+        }
+        if (ended == m) break;
+        if (ended) throw EvalError("Chunked inputs have different lengths: " + target());
+
+        std::vector<TimeSeries> slices(m);
+        std::vector<const TimeSeries*> in(m);
+        const TimeSeries* indexed = nullptr;
+        for (std::size_t k = 0; k < m; ++k) {
+            slices[k] = chunk[k].slice(pos[k], pos[k] + n);
+            pos[k] += n;
+            in[k] = &slices[k];
+            if (!indexed && slices[k].has_index()) indexed = &slices[k];
+        }
+        check_timestamps(in, indexed, 0, target());
+
+        Env rows;
+        for (std::size_t k = 0; k < m; ++k) {
+            TimeSeries r = slice_rows(slices[k], 0, n);
+            rows.emplace(names[k], context ? concat_rows(history[k], r) : std::move(r));
+        }
+        if (reduction_) {
+            reduction_->fold(rows);
+        } else {
+            if (lookback) {
+                const std::size_t keep = std::min(lookback, context + n);
+                for (std::size_t k = 0; k < m; ++k) {
+                    const TimeSeries& r = rows.at(names[k]);
+                    history[k] = slice_rows(r, r.size() - keep, r.size()).compact();
+                }
+            }
+            TimeSeries out = assignment_->evaluate_rows(std::move(rows), context).compact();
+            if (indexed) out = out.with_index(indexed->index());
+            sink(std::move(out));
+            context = std::min(lookback, context + n);
+        }
+        total += n;
+    }
+    if (reduction_) sink(TimeSeries::from_scalar(reduction_->result()));
+    return total;
+}
+
+} // namespace ts::expr
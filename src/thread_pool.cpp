@@ -0,0 +1,176 @@
+#include "tsexpr/thread_pool.hpp"
+
+#include <chrono>
+
+namespace tsexpr {
+
+namespace {
+
+// Which pool (if any) the current thread works for, and its index there.
+struct WorkerIdentity {
+    const ThreadPool* pool{nullptr};
+    std::size_t index{ThreadPool::npos};
+};
+thread_local WorkerIdentity tls_worker;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    queues_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+    workers_.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) workers_.emplace_back([this, i] { worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mu_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+std::size_t ThreadPool::worker_index() const noexcept {
+    return tls_worker.pool == this ? tls_worker.index : npos;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    const std::size_t self = worker_index();
+    Queue& q = self != npos ? *queues_[self] : injection_;
+    {
+        // Count the task before publishing it: once it is in a queue any
+        // worker may pop it and decrement, which must never run ahead of
+        // this increment. Taking the lock orders it before a sleeper's
+        // predicate check, so the wakeup cannot be lost.
+        std::lock_guard<std::mutex> lock(sleep_mu_);
+        pending_.fetch_add(1);
+    }
+    try {
+        std::lock_guard<std::mutex> lock(q.mu);
+        q.tasks.push_back(std::move(task));
+    } catch (...) {
+        pending_.fetch_sub(1);
+        throw;
+    }
+    sleep_cv_.notify_one();
+}
+
+bool ThreadPool::try_pop(std::size_t self, std::function<void()>& out) {
+    auto take = [&](Queue& q, bool back) {
+        std::lock_guard<std::mutex> lock(q.mu);
+        if (q.tasks.empty()) return false;
+        if (back) { out = std::move(q.tasks.back()); q.tasks.pop_back(); }
+        else      { out = std::move(q.tasks.front()); q.tasks.pop_front(); }
+        return true;
+    };
+
+    bool found = (self != npos && take(*queues_[self], true)) || take(injection_, false);
+    if (!found) {
+        // Steal, starting after our own slot so victims are spread out.
+        const std::size_t n = queues_.size();
+        const std::size_t start = self != npos ? self + 1 : 0;
+        for (std::size_t k = 0; k < n && !found; ++k) {
+            const std::size_t victim = (start + k) % n;
+            if (victim != self) found = take(*queues_[victim], false);
+        }
+    }
+    if (found) pending_.fetch_sub(1);
+    return found;
+}
+
+bool ThreadPool::run_pending_task() {
+    std::function<void()> task;
+    if (!try_pop(worker_index(), task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(std::size_t index) {
+    tls_worker = WorkerIdentity{this, index};
+    std::function<void()> task;
+    for (;;) {
+        if (try_pop(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mu_);
+        sleep_cv_.wait(lock, [&] { return stop_ || pending_.load() > 0; });
+        if (stop_ && pending_.load() == 0) return;
+    }
+}
+
+// -----------------------------
+// TaskGroup
+// -----------------------------
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(st_->mu);
+        ++st_->outstanding;
+    }
+    pool_.submit([st = st_, task = std::move(task)] {
+        std::exception_ptr err;
+        try {
+            task();
+        } catch (...) {
+            err = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(st->mu);
+        if (err && !st->error) st->error = err;
+        if (--st->outstanding == 0) st->cv.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(st_->mu);
+            if (st_->outstanding == 0) break;
+        }
+        if (pool_.run_pending_task()) continue;
+        // Nothing to help with: our tasks are running elsewhere. Sleep
+        // briefly, then look for work again in case more was queued.
+        std::unique_lock<std::mutex> lock(st_->mu);
+        st_->cv.wait_for(lock, std::chrono::microseconds(200), [&] { return st_->outstanding == 0; });
+    }
+    std::exception_ptr err;
+    {
+        std::lock_guard<std::mutex> lock(st_->mu);
+        std::swap(err, st_->error);
+    }
+    if (err) std::rethrow_exception(err);
+}
+
+// -----------------------------
+// default pool
+// -----------------------------
+namespace {
+
+std::mutex default_mu;
+std::size_t default_threads = 0;
+std::unique_ptr<ThreadPool> default_pool;
+
+} // namespace
+
+ThreadPool& default_thread_pool() {
+    std::lock_guard<std::mutex> lock(default_mu);
+    if (!default_pool) default_pool = std::make_unique<ThreadPool>(default_threads);
+    return *default_pool;
+}
+
+void set_default_thread_count(std::size_t threads) {
+    std::lock_guard<std::mutex> lock(default_mu);
+    default_threads = threads;
+    default_pool.reset();
+}
+
+} // namespace tsexpr
@@ -1,81 +1,547 @@
 #include <tsexpr/timeseries_stub.hpp>
+#include <tsexpr/reduce.hpp>
+#include <tsexpr/thread_pool.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+#include "kernels.hpp"
 
 namespace ts::expr {
 
-double sumproduct(const TimeSeries& a, const TimeSeries& b) {
+static TimeIndexPtr make_index(TimeIndex index, std::size_t n) {
+    if (index.size() != n) throw std::runtime_error("TimeSeries index/value length mismatch");
+    for (std::size_t i = 1; i < index.size(); ++i) {
+        if (index[i] <= index[i - 1]) throw std::runtime_error("TimeSeries index must be strictly increasing");
+    }
+    return std::make_shared<const TimeIndex>(std::move(index));
+}
+
+TimeSeries::TimeSeries(TimeIndex index, std::vector<double> values)
+    : TimeSeries(std::move(values)) {
+    index_ = make_index(std::move(index), size());
+}
+
+TimeSeries::TimeSeries(TimeIndex index, std::vector<float> values)
+    : TimeSeries(std::move(values)) {
+    index_ = make_index(std::move(index), size());
+}
+
+std::uint64_t TimeSeries::next_generation() noexcept {
+    static std::atomic<std::uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+TimeSeries TimeSeries::with_index(TimeIndexPtr index) const {
+    if (index && index->size() != size()) throw std::runtime_error("TimeSeries index/value length mismatch");
+    TimeSeries out = *this;
+    out.index_ = std::move(index);
+    out.own_index_ = nullptr;
+    out.generation_ = next_generation();
+    return out;
+}
+
+TimeSeries TimeSeries::with_validity(ValidityPtr validity) const {
+    if (validity && validity->size() != size()) throw std::runtime_error("TimeSeries validity/value length mismatch");
+    TimeSeries out = *this;
+    out.validity_ = (validity && validity->all_set()) ? nullptr : std::move(validity);
+    out.own_validity_ = nullptr;
+    out.generation_ = next_generation();
+    return out;
+}
+
+ValidityBitmap& TimeSeries::own_validity() {
+    if (!own_validity_ || own_validity_ != validity_.get() || validity_.use_count() > 1) {
+        auto copy = validity_ ? std::make_shared<ValidityBitmap>(*validity_) : std::make_shared<ValidityBitmap>(size());
+        own_validity_ = copy.get();
+        validity_ = std::move(copy);
+    }
+    return *own_validity_;
+}
+
+void TimeSeries::set_valid(std::size_t i, bool valid) {
+    if (i >= size()) throw std::out_of_range("TimeSeries::set_valid row out of range");
+    generation_ = next_generation();
+    if (!validity_ && valid) return;
+    own_validity().set(i, valid);
+}
+
+void TimeSeries::append(const TimeSeries& rows) {
+    if (&rows == this) {
+        const TimeSeries copy = rows;
+        append(copy);
+        return;
+    }
+    if (rows.dtype_ != dtype_) throw std::runtime_error("TimeSeries append dtype mismatch");
+    if (rows.has_index() != has_index()) throw std::runtime_error("TimeSeries append mixes timestamped and positional rows");
+    if (index_ && !index_->empty() && rows.size() && rows.index_->front() <= index_->back())
+        throw std::runtime_error("TimeSeries index must be strictly increasing");
+
+    const std::size_t n = size();
+    const bool shared = dtype_ == DType::F32 ? f32_.use_count() > 1 : f64_.use_count() > 1;
+    if (shared) generation_ = next_generation();
+    if (dtype_ == DType::F32) {
+        auto& v = detach(f32_, offset_, len_);
+        v.insert(v.end(), rows.f32(), rows.f32() + rows.size());
+    } else {
+        auto& v = detach(f64_, offset_, len_);
+        v.insert(v.end(), rows.f64(), rows.f64() + rows.size());
+    }
+
+    if (validity_ || rows.validity_) {
+        ValidityBitmap& valid = own_validity();
+        valid.resize(n + rows.size());
+        for (std::size_t i = 0; i < rows.size(); ++i)
+            if (!rows.is_valid(i)) valid.set(n + i, false);
+    }
+
+    if (index_) {
+        if (!own_index_ || own_index_ != index_.get() || index_.use_count() > 1) {
+            auto copy = std::make_shared<TimeIndex>(*index_);
+            own_index_ = copy.get();
+            index_ = std::move(copy);
+        }
+        own_index_->insert(own_index_->end(), rows.index_->begin(), rows.index_->end());
+    }
+}
+
+TimeSeries TimeSeries::astype(DType t) const {
+    if (t == dtype_) return *this;
+    const std::size_t n = size();
+    TimeSeries out;
+    if (t == DType::F32) {
+        const double* x = f64();
+        out = TimeSeries{std::vector<float>(x, x + n)};
+    } else {
+        const float* x = f32();
+        out = TimeSeries{std::vector<double>(x, x + n)};
+    }
+    out.index_ = index_;
+    out.validity_ = validity_;
+    out.origin_ = origin_;
+    out.shifted_ = shifted_;
+    return out;
+}
+
+TimeSeries TimeSeries::slice(std::size_t b, std::size_t e) const {
+    if (b > e || e > size()) throw std::out_of_range("TimeSeries slice out of range");
+    TimeSeries out = *this;
+    out.offset_ = offset_ + b;
+    out.len_ = e - b;
+    out.own_index_ = nullptr;
+    out.own_validity_ = nullptr;
+    out.generation_ = next_generation();
+    if (index_ && (b != 0 || e != size()))
+        out.index_ = std::make_shared<const TimeIndex>(index_->begin() + std::ptrdiff_t(b), index_->begin() + std::ptrdiff_t(e));
+    if (validity_) {
+        auto valid = std::make_shared<ValidityBitmap>(validity_->slice(b, e));
+        out.validity_ = valid->all_set() ? nullptr : std::move(valid);
+    }
+    if (!index_) out.origin_ = origin_ + std::ptrdiff_t(b);
+    return out;
+}
+
+TimeSeries TimeSeries::compact() const {
+    if (!is_view()) return *this;
+    TimeSeries out = *this;
+    if (dtype_ == DType::F32) out.mutable_values_f32();
+    else out.mutable_values();
+    return out;
+}
+
+// A fresh result laid out like `x`: same index or positional origin.
+static TimeSeries like(const TimeSeries& out, const TimeSeries& x) {
+    const TimeSeries r = out.with_index(x.index());
+    return x.shifted() ? r.shifted_to(x.origin()) : r.with_origin(x.origin());
+}
+
+// -----------------------------
+// parallel policy
+// -----------------------------
+static std::atomic<std::size_t> g_min_rows{ParallelPolicy{}.min_rows};
+static std::atomic<std::size_t> g_grain{ParallelPolicy{}.grain};
+
+void set_parallel_policy(const ParallelPolicy& policy) {
+    g_min_rows.store(policy.min_rows);
+    g_grain.store(policy.grain);
+}
+
+ParallelPolicy parallel_policy() {
+    return ParallelPolicy{g_min_rows.load(), g_grain.load()};
+}
+
+// Chunk size actually used: a positive multiple of 64 so chunks start on a
+// validity-bitmap word boundary.
+static std::size_t effective_grain() {
+    const std::size_t g = g_grain.load();
+    return g <= 64 ? 64 : (g + 63) / 64 * 64;
+}
+
+// Run body(begin, end) over [0, n), in parallel chunks for large n.
+template <class Body>
+static void for_chunks(std::size_t n, Body&& body) {
+    if (n < g_min_rows.load()) { body(std::size_t{0}, n); return; }
+    tsexpr::default_thread_pool().parallel_for(n, effective_grain(), body);
+}
+
+// Sum of chunk(begin, end) over [0, n) on a fixed leaf tree, so the result
+// is the same whether or not the input is long enough to run in parallel.
+template <class Chunk>
+static double sum_chunks(std::size_t n, Chunk&& chunk) {
+    tsexpr::ThreadPool* pool = n < g_min_rows.load() ? nullptr : &tsexpr::default_thread_pool();
+    return tsexpr::deterministic_sum(n, chunk, pool, effective_grain());
+}
+
+// -----------------------------
+// alignment
+// -----------------------------
+template <class T>
+static TimeSeries gather_as(const T* src, const std::vector<std::size_t>& rows) {
+    std::vector<T> out(rows.size());
+    for (std::size_t k = 0; k < rows.size(); ++k) {
+        out[k] = rows[k] == AlignmentPlan::npos ? std::numeric_limits<T>::quiet_NaN() : src[rows[k]];
+    }
+    return TimeSeries{std::move(out)};
+}
+
+// Row-select `s` through a plan side; shares the buffer when it is identity.
+// Rows with no source (npos) and gathered null rows come out null.
+static TimeSeries gather(const TimeSeries& s, const std::vector<std::size_t>& rows, bool identity,
+                         const TimeIndexPtr& index) {
+    if (identity) return s.with_index(index);
+    TimeSeries out = s.dtype() == DType::F32 ? gather_as(s.f32(), rows) : gather_as(s.f64(), rows);
+    auto valid = std::make_shared<ValidityBitmap>(rows.size());
+    for (std::size_t k = 0; k < rows.size(); ++k) {
+        if (rows[k] == AlignmentPlan::npos || !s.is_valid(rows[k])) valid->set(k, false);
+    }
+    return out.with_index(index).with_validity(std::move(valid));
+}
+
+std::pair<TimeSeries, TimeSeries> align(const TimeSeries& a, const TimeSeries& b, JoinKind kind) {
+    if (!a.has_index() || !b.has_index()) throw std::runtime_error("align() requires timestamped series");
+    AlignmentPlanPtr plan = alignment_cache().get(a.index(), b.index(), kind);
+    return {gather(a, plan->left, plan->left_identity, plan->index),
+            gather(b, plan->right, plan->right_identity, plan->index)};
+}
+
+// Bring both operands of a TS op TS onto one row layout. Returns the index
+// the result should carry (null for positional, unindexed inputs).
+static TimeIndexPtr align_operands(const TimeSeries& a, const TimeSeries& b,
+                                   TimeSeries& a_out, TimeSeries& b_out) {
+    if (a.has_index() && b.has_index() && a.index() != b.index()) {
+        std::tie(a_out, b_out) = align(a, b, JoinKind::Inner);
+        return a_out.index();
+    }
+    if (!a.has_index() && !b.has_index() && (a.shifted() || b.shifted()) &&
+        (a.origin() != b.origin() || a.size() != b.size())) {
+        // Shifted positional series: keep the positions both cover, as views.
+        const std::ptrdiff_t lo = std::max(a.origin(), b.origin());
+        const std::ptrdiff_t hi = std::min(a.origin() + std::ptrdiff_t(a.size()), b.origin() + std::ptrdiff_t(b.size()));
+        if (hi <= lo) {
+            a_out = a.slice(0, 0);
+            b_out = b.slice(0, 0);
+            return nullptr;
+        }
+        const std::size_t n = std::size_t(hi - lo);
+        a_out = a.slice(std::size_t(lo - a.origin()), std::size_t(lo - a.origin()) + n);
+        b_out = b.slice(std::size_t(lo - b.origin()), std::size_t(lo - b.origin()) + n);
+        return nullptr;
+    }
     TimeSeries::require_same_size(a, b);
-    double acc = 0.0;
-    for (std::size_t i = 0; i < a.v.size(); ++i) {
-        acc += a.v[i] * b.v[i];
+    a_out = a;
+    b_out = b;
+    return a.has_index() ? a.index() : b.index();
+}
+
+// No-nulls fast path when `valid` is null, masked kernel otherwise.
+template <class TA, class TB>
+static double dot_valid(const TA* a, const TB* b, const ValidityPtr& valid, std::size_t n) {
+    if (!valid) {
+        return sum_chunks(n, [&](std::size_t i, std::size_t e) { return kernels::dot(a + i, b + i, e - i); });
     }
-    return acc;
+    const std::uint64_t* w = valid->words();
+    return sum_chunks(n, [&](std::size_t i, std::size_t e) {
+        return kernels::dot_masked(a + i, b + i, w + i / 64, e - i);
+    });
+}
+
+template <class TA>
+static double dot_scalar_valid(const TA* a, double s, const ValidityPtr& valid, std::size_t n) {
+    if (!valid) {
+        return sum_chunks(n, [&](std::size_t i, std::size_t e) { return kernels::dot_scalar(a + i, s, e - i); });
+    }
+    const std::uint64_t* w = valid->words();
+    return sum_chunks(n, [&](std::size_t i, std::size_t e) {
+        return kernels::dot_scalar_masked(a + i, s, w + i / 64, e - i);
+    });
+}
+
+double sumproduct(const TimeSeries& lhs, const TimeSeries& rhs) {
+    TimeSeries a, b;
+    align_operands(lhs, rhs, a, b);
+    const ValidityPtr valid = combine_validity(a.validity(), b.validity());
+    const std::size_t n = a.size();
+    const bool a32 = a.dtype() == DType::F32;
+    const bool b32 = b.dtype() == DType::F32;
+    if (!a32 && !b32) return dot_valid(a.f64(), b.f64(), valid, n);
+    if (a32 && b32)   return dot_valid(a.f32(), b.f32(), valid, n);
+    if (a32)          return dot_valid(a.f32(), b.f64(), valid, n);
+    return dot_valid(a.f64(), b.f32(), valid, n);
 }
 
 double sumproduct(const TimeSeries& a, double b) {
-    double acc = 0.0;
-    for (double x : a.v) acc += x * b;
-    return acc;
+    if (a.dtype() == DType::F32) return dot_scalar_valid(a.f32(), b, a.validity(), a.size());
+    return dot_scalar_valid(a.f64(), b, a.validity(), a.size());
 }
 
 double sumproduct(double a, const TimeSeries& b) {
-    double acc = 0.0;
-    for (double x : b.v) acc += a * x;
-    return acc;
+    return sumproduct(b, a);
 }
 
 double sumproduct(double a, double b) {
     return a * b;
 }
 
-static TimeSeries binop_ts_ts(const TimeSeries& a, const TimeSeries& b, double (*op)(double,double)) {
-    TimeSeries::require_same_size(a,b);
-    TimeSeries out;
-    out.v.resize(a.v.size());
-    for (std::size_t i=0;i<a.v.size();++i) out.v[i] = op(a.v[i], b.v[i]);
-    return out;
+template <class T>
+static void rolling_into(tsexpr::RollingWindow& w, const T* x, const TimeSeries& s, double* out,
+                         ValidityBitmap& valid) {
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        const std::optional<double> r = w.push(double(x[i]), s.is_valid(i));
+        out[i] = r ? *r : 0.0;
+        if (!r) valid.set(i, false);
+    }
 }
 
-static TimeSeries binop_ts_s(const TimeSeries& a, double b, double (*op)(double,double)) {
-    TimeSeries out;
-    out.v.resize(a.v.size());
-    for (std::size_t i=0;i<a.v.size();++i) out.v[i] = op(a.v[i], b);
-    return out;
+TimeSeries rolling(tsexpr::RollingKind kind, const TimeSeries& x, std::size_t window) {
+    const std::size_t n = x.size();
+    tsexpr::RollingWindow w(kind, std::min(window, n + 1)); // longer windows are all-null anyway
+    std::vector<double> out(n);
+    auto valid = std::make_shared<ValidityBitmap>(n);
+    if (x.dtype() == DType::F32) rolling_into(w, x.f32(), x, out.data(), *valid);
+    else rolling_into(w, x.f64(), x, out.data(), *valid);
+    TimeSeries r = TimeSeries{std::move(out)}.with_validity(std::move(valid));
+    return like(r, x);
+}
+
+template <class T>
+static void ewm_into(tsexpr::EwmFilter& f, const T* x, const TimeSeries& s, double* out, ValidityBitmap& valid) {
+    if (!s.has_validity()) {
+        f.run(x, s.size(), out);
+        return;
+    }
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        const std::optional<double> r = f.push(double(x[i]), s.is_valid(i));
+        out[i] = r ? *r : 0.0;
+        if (!r) valid.set(i, false);
+    }
+}
+
+TimeSeries ewm(tsexpr::EwmFilter& state, const TimeSeries& x) {
+    const std::size_t n = x.size();
+    std::vector<double> out(n);
+    auto valid = std::make_shared<ValidityBitmap>(n);
+    if (x.dtype() == DType::F32) ewm_into(state, x.f32(), x, out.data(), *valid);
+    else ewm_into(state, x.f64(), x, out.data(), *valid);
+    TimeSeries r = TimeSeries{std::move(out)}.with_validity(std::move(valid));
+    return like(r, x);
+}
+
+template <class T>
+static void resample_into(tsexpr::BucketAggregator& agg, const T* x, const TimeSeries& s,
+                          std::vector<tsexpr::Bar>& bars) {
+    const TimeIndex& ts = *s.index();
+    for (std::size_t i = 0; i < s.size(); ++i)
+        if (auto closed = agg.push(ts[i], double(x[i]), s.is_valid(i))) bars.push_back(*closed);
+}
+
+TimeSeries resample(tsexpr::ResampleKind kind, const TimeSeries& x, std::int64_t width) {
+    if (!x.has_index()) throw std::invalid_argument("resample needs a timestamped series");
+    tsexpr::BucketAggregator agg(kind, width);
+    std::vector<tsexpr::Bar> bars;
+    if (x.dtype() == DType::F32) resample_into(agg, x.f32(), x, bars);
+    else resample_into(agg, x.f64(), x, bars);
+    if (auto last = agg.current()) bars.push_back(*last);
+
+    TimeIndex starts(bars.size());
+    std::vector<double> values(bars.size());
+    auto valid = std::make_shared<ValidityBitmap>(bars.size());
+    for (std::size_t i = 0; i < bars.size(); ++i) {
+        starts[i] = bars[i].start;
+        values[i] = bars[i].value;
+        if (!bars[i].present) valid->set(i, false);
+    }
+    return TimeSeries{std::move(starts), std::move(values)}.with_validity(std::move(valid));
 }
 
-static TimeSeries binop_s_ts(double a, const TimeSeries& b, double (*op)(double,double)) {
+template <class Op, class TO, class TA, class TB>
+static void par_vv(const TA* a, const TB* b, TO* out, std::size_t n) {
+    for_chunks(n, [=](std::size_t i, std::size_t e) { kernels::vv<Op>(a + i, b + i, out + i, e - i); });
+}
+
+template <class Op, class TO, class TA>
+static void par_vs(const TA* a, TO s, TO* out, std::size_t n) {
+    for_chunks(n, [=](std::size_t i, std::size_t e) { kernels::vs<Op>(a + i, s, out + i, e - i); });
+}
+
+template <class Op, class TO, class TB>
+static void par_sv(TO s, const TB* b, TO* out, std::size_t n) {
+    for_chunks(n, [=](std::size_t i, std::size_t e) { kernels::sv<Op>(s, b + i, out + i, e - i); });
+}
+
+template <class T>
+static void par_neg(const T* a, T* out, std::size_t n) {
+    for_chunks(n, [=](std::size_t i, std::size_t e) { kernels::neg(a + i, out + i, e - i); });
+}
+
+// Results are built in a fresh vector and handed to the series, so the
+// output buffer is uniquely owned and never goes through copy-on-write.
+template <class Op>
+static TimeSeries binop_ts_ts(const TimeSeries& lhs, const TimeSeries& rhs) {
+    TimeSeries a, b;
+    const TimeIndexPtr index = align_operands(lhs, rhs, a, b);
+    const ValidityPtr valid = combine_validity(a.validity(), b.validity());
+    const std::size_t n = a.size();
+    const bool a32 = a.dtype() == DType::F32;
+    const bool b32 = b.dtype() == DType::F32;
+    // Shifted if either operand was, at the positions both cover.
+    auto place = [&](TimeSeries out) {
+        out = out.with_index(index).with_validity(valid);
+        return lhs.shifted() || rhs.shifted() ? out.shifted_to(a.origin()) : out.with_origin(a.origin());
+    };
+    if (a32 && b32) {
+        std::vector<float> out(n);
+        par_vv<Op>(a.f32(), b.f32(), out.data(), n);
+        return place(TimeSeries{std::move(out)});
+    }
+    std::vector<double> out(n);
+    if (!a32 && !b32) par_vv<Op>(a.f64(), b.f64(), out.data(), n);
+    else if (a32)     par_vv<Op>(a.f32(), b.f64(), out.data(), n);
+    else              par_vv<Op>(a.f64(), b.f32(), out.data(), n);
+    return place(TimeSeries{std::move(out)});
+}
+
+template <class Op>
+static TimeSeries binop_ts_s(const TimeSeries& a, double b) {
+    const std::size_t n = a.size();
+    if (a.dtype() == DType::F32) {
+        std::vector<float> out(n);
+        par_vs<Op>(a.f32(), static_cast<float>(b), out.data(), n);
+        return like(TimeSeries{std::move(out)}, a).with_validity(a.validity());
+    }
+    std::vector<double> out(n);
+    par_vs<Op>(a.f64(), b, out.data(), n);
+    return like(TimeSeries{std::move(out)}, a).with_validity(a.validity());
+}
+
+template <class Op>
+static TimeSeries binop_s_ts(double a, const TimeSeries& b) {
+    const std::size_t n = b.size();
+    if (b.dtype() == DType::F32) {
+        std::vector<float> out(n);
+        par_sv<Op>(static_cast<float>(a), b.f32(), out.data(), n);
+        return like(TimeSeries{std::move(out)}, b).with_validity(b.validity());
+    }
+    std::vector<double> out(n);
+    par_sv<Op>(a, b.f64(), out.data(), n);
+    return like(TimeSeries{std::move(out)}, b).with_validity(b.validity());
+}
+
+using kernels::Add;
+using kernels::Sub;
+using kernels::Mul;
+using kernels::Div;
+
+TimeSeries lag(const TimeSeries& x, std::ptrdiff_t k) {
+    const std::size_t n = x.size();
+    const std::size_t m = std::min<std::size_t>(n, k < 0 ? std::size_t(-k) : std::size_t(k));
+    // Values [0, n - m) move to rows [m, n) for a lag, the other way round
+    // for a lead.
+    if (!x.has_index()) {
+        TimeSeries out = k >= 0 ? x.slice(0, n - m) : x.slice(m, n);
+        return out.shifted_to(out.origin() + k); // slice() already moved it by its start
+    }
+    // The rows keep their values but take the timestamps `m` rows away, so
+    // slice the values unindexed and copy only that part of the index.
+    const TimeSeries values = x.with_index(nullptr);
+    TimeSeries out = k >= 0 ? values.slice(0, n - m) : values.slice(m, n);
+    const TimeIndex& ts = *x.index();
+    auto index = k >= 0 ? std::make_shared<const TimeIndex>(ts.begin() + std::ptrdiff_t(m), ts.end())
+                        : std::make_shared<const TimeIndex>(ts.begin(), ts.end() - std::ptrdiff_t(m));
+    return out.with_origin(x.origin()).with_index(std::move(index));
+}
+
+// Adjacent-row kernels: out[i] from x[i + 1] and x[i].
+struct PctChange {
+    template <class T> static T apply(T cur, T prev) { return cur / prev - T(1); }
+};
+
+template <class Op, class T>
+static void adjacent(const T* x, T* out, std::size_t n) {
+    for_chunks(n, [=](std::size_t i, std::size_t e) {
+        for (; i < e; ++i) out[i] = Op::apply(x[i + 1], x[i]);
+    });
+}
+
+// Rows 1.. of x combined with the row before, in one pass over x's buffer.
+template <class Op>
+static TimeSeries adjacent_op(const TimeSeries& x) {
+    if (x.size() < 2) return lag(x, 1);
+    const std::size_t n = x.size() - 1;
+    const TimeSeries cur = x.slice(1, n + 1);
     TimeSeries out;
-    out.v.resize(b.v.size());
-    for (std::size_t i=0;i<b.v.size();++i) out.v[i] = op(a, b.v[i]);
-    return out;
+    if (x.dtype() == DType::F32) {
+        std::vector<float> v(n);
+        if constexpr (std::is_same_v<Op, Sub>) par_vv<Sub>(x.f32() + 1, x.f32(), v.data(), n);
+        else adjacent<Op>(x.f32(), v.data(), n);
+        out = TimeSeries{std::move(v)};
+    } else {
+        std::vector<double> v(n);
+        if constexpr (std::is_same_v<Op, Sub>) par_vv<Sub>(x.f64() + 1, x.f64(), v.data(), n);
+        else adjacent<Op>(x.f64(), v.data(), n);
+        out = TimeSeries{std::move(v)};
+    }
+    ValidityPtr valid;
+    if (x.has_validity())
+        valid = std::make_shared<const ValidityBitmap>(
+            ValidityBitmap::combine(x.validity()->slice(1, n + 1), x.validity()->slice(0, n)));
+    // Positional: lined up like x - lag(x, 1).
+    const TimeSeries r = like(out, cur).with_validity(std::move(valid));
+    return x.has_index() ? r : r.shifted_to(r.origin());
 }
 
-static double add(double x,double y){return x+y;}
-static double sub(double x,double y){return x-y;}
-static double mul(double x,double y){return x*y;}
-static double divv(double x,double y){return x/y;}
+TimeSeries diff(const TimeSeries& x) { return adjacent_op<Sub>(x); }
+TimeSeries pct_change(const TimeSeries& x) { return adjacent_op<PctChange>(x); }
 
-TimeSeries operator+(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts(a,b,add); }
-TimeSeries operator-(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts(a,b,sub); }
-TimeSeries operator*(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts(a,b,mul); }
-TimeSeries operator/(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts(a,b,divv); }
+TimeSeries operator+(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts<Add>(a,b); }
+TimeSeries operator-(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts<Sub>(a,b); }
+TimeSeries operator*(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts<Mul>(a,b); }
+TimeSeries operator/(const TimeSeries& a, const TimeSeries& b){ return binop_ts_ts<Div>(a,b); }
 
-TimeSeries operator+(const TimeSeries& a, double b){ return binop_ts_s(a,b,add); }
-TimeSeries operator-(const TimeSeries& a, double b){ return binop_ts_s(a,b,sub); }
-TimeSeries operator*(const TimeSeries& a, double b){ return binop_ts_s(a,b,mul); }
-TimeSeries operator/(const TimeSeries& a, double b){ return binop_ts_s(a,b,divv); }
+TimeSeries operator+(const TimeSeries& a, double b){ return binop_ts_s<Add>(a,b); }
+TimeSeries operator-(const TimeSeries& a, double b){ return binop_ts_s<Sub>(a,b); }
+TimeSeries operator*(const TimeSeries& a, double b){ return binop_ts_s<Mul>(a,b); }
+TimeSeries operator/(const TimeSeries& a, double b){ return binop_ts_s<Div>(a,b); }
 
-TimeSeries operator+(double a, const TimeSeries& b){ return binop_s_ts(a,b,add); }
-TimeSeries operator-(double a, const TimeSeries& b){ return binop_s_ts(a,b,sub); }
-TimeSeries operator*(double a, const TimeSeries& b){ return binop_s_ts(a,b,mul); }
-TimeSeries operator/(double a, const TimeSeries& b){ return binop_s_ts(a,b,divv); }
+TimeSeries operator+(double a, const TimeSeries& b){ return binop_s_ts<Add>(a,b); }
+TimeSeries operator-(double a, const TimeSeries& b){ return binop_s_ts<Sub>(a,b); }
+TimeSeries operator*(double a, const TimeSeries& b){ return binop_s_ts<Mul>(a,b); }
+TimeSeries operator/(double a, const TimeSeries& b){ return binop_s_ts<Div>(a,b); }
 
 TimeSeries operator-(const TimeSeries& a){
-    TimeSeries out;
-    out.v.resize(a.v.size());
-    for (std::size_t i=0;i<a.v.size();++i) out.v[i] = -a.v[i];
-    return out;
+    const std::size_t n = a.size();
+    if (a.dtype() == DType::F32) {
+        std::vector<float> out(n);
+        par_neg(a.f32(), out.data(), n);
+        return like(TimeSeries{std::move(out)}, a).with_validity(a.validity());
+    }
+    std::vector<double> out(n);
+    par_neg(a.f64(), out.data(), n);
+    return like(TimeSeries{std::move(out)}, a).with_validity(a.validity());
 }
 
 } // namespace ts::expr
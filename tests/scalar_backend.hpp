@@ -0,0 +1,59 @@
+#pragma once
+#include <tsexpr/parser.hpp>
+
+#include <atomic>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tsexpr::test {
+
+// Scalar-only backend shared by the Program-level tests. It counts evaluated
+// calls; slow(x) returns x * 10, check(x) raises for negative x, and fail(x)
+// always raises. Forked programs call it from pool threads, hence the atomic
+// counter.
+struct ScalarBackend {
+    std::map<std::string, double> vars;
+    std::atomic<int> calls{0};
+
+    ScalarBackend() = default;
+    ScalarBackend(const ScalarBackend& other) : vars(other.vars), calls(other.calls.load()) {}
+
+    double load_var(std::string_view name) const {
+        auto it = vars.find(std::string(name));
+        if (it == vars.end()) throw std::runtime_error("unknown var: " + std::string(name));
+        return it->second;
+    }
+    void store_var(std::string_view name, double v) { vars[std::string(name)] = v; }
+    double make_number(double x) const { return x; }
+    double neg(double a) const { return -a; }
+    double binary(Op op, double a, double b) const {
+        switch (op) {
+            case Op::Add: return a + b;
+            case Op::Sub: return a - b;
+            case Op::Mul: return a * b;
+            case Op::Div: return a / b;
+            default: throw std::runtime_error("bad op");
+        }
+    }
+    double call(std::string_view fn, const std::vector<double>& args) {
+        ++calls;
+        if (fn == "slow") return args.at(0) * 10;
+        if (fn == "check") {
+            if (args.at(0) < 0) throw std::runtime_error("check failed");
+            return args[0];
+        }
+        if (fn == "fail") throw std::runtime_error("fail(" + std::to_string(args.at(0)) + ")");
+        throw std::runtime_error("unknown fn");
+    }
+};
+
+inline std::vector<Program> compile_all(const std::vector<std::string>& src) {
+    std::vector<Program> out;
+    for (const auto& s : src) out.push_back(compile(s));
+    return out;
+}
+
+} // namespace tsexpr::test
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <tsexpr/async_executor.hpp>
+#include <tsexpr/parser.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Stand-in pricing service: answers "price(x)" with 10 * x, but only once
+// `expected` requests are pending, so a test passes only if every program is
+// parked on its call at the same time.
+template <class Reply>
+struct Service {
+    std::mutex mu;
+    std::vector<std::pair<double, Reply>> pending;
+    std::size_t expected = 0;
+
+    void request(double x, Reply r) {
+        std::vector<std::pair<double, Reply>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            pending.emplace_back(x, std::move(r));
+            if (pending.size() < expected) return;
+            ready.swap(pending);
+        }
+        std::thread([ready = std::move(ready)]() mutable {
+            for (auto& [x, reply] : ready) {
+                if (x < 0) reply.fail(std::make_exception_ptr(std::runtime_error("negative")));
+                else reply(10 * x);
+            }
+        }).detach();
+    }
+};
+
+struct ScalarVars {
+    std::shared_mutex mu;
+    std::map<std::string, double> vars;
+
+    double load_var(std::string_view name) {
+        std::shared_lock<std::shared_mutex> lock(mu);
+        auto it = vars.find(std::string(name));
+        if (it == vars.end()) throw std::runtime_error("unknown var: " + std::string(name));
+        return it->second;
+    }
+    void store_var(std::string_view name, double v) {
+        std::unique_lock<std::shared_mutex> lock(mu);
+        vars[std::string(name)] = v;
+    }
+    double make_number(double x) const { return x; }
+    double neg(double a) const { return -a; }
+    double binary(tsexpr::Op op, double a, double b) const { return op == tsexpr::Op::Add ? a + b : a * b; }
+    double call(std::string_view, const std::vector<double>&) const { throw std::runtime_error("sync call"); }
+};
+
+struct CallbackBackend : ScalarVars {
+    Service<tsexpr::Completion<double>> service;
+    void call_async(std::string_view, std::vector<double> args, tsexpr::Completion<double> done) {
+        service.request(args.at(0), std::move(done));
+    }
+};
+
+// Adapts a promise to the Reply interface used by Service.
+struct PromiseReply {
+    std::shared_ptr<std::promise<double>> p;
+    void operator()(double v) const { p->set_value(v); }
+    void fail(std::exception_ptr e) const { p->set_exception(e); }
+};
+
+struct FutureBackend : ScalarVars {
+    Service<PromiseReply> service;
+    std::future<double> call_async(std::string_view, std::vector<double> args) {
+        PromiseReply r{std::make_shared<std::promise<double>>()};
+        auto f = r.p->get_future();
+        service.request(args.at(0), std::move(r));
+        return f;
+    }
+};
+
+template <class Backend>
+void run_many_in_flight() {
+    Backend be;
+    constexpr int n = 24;
+    std::vector<tsexpr::Program> progs;
+    for (int i = 0; i < n; ++i) {
+        be.vars["x" + std::to_string(i)] = i;
+        progs.push_back(tsexpr::compile("y" + std::to_string(i) + " = price(x" + std::to_string(i) + ") + 1"));
+    }
+    be.service.expected = n;
+
+    tsexpr::ThreadPool pool(1); // one thread keeps all 24 programs going
+    tsexpr::AsyncExecutor<Backend> ex(be, pool);
+    std::vector<std::future<void>> done;
+    for (const auto& p : progs) done.push_back(ex.submit(p));
+    for (auto& d : done) ASSERT_EQ(d.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    ex.wait_all();
+    for (int i = 0; i < n; ++i) EXPECT_EQ(be.vars.at("y" + std::to_string(i)), 10.0 * i + 1);
+}
+
+TEST(AsyncExecutor, ContinuationCallsKeepManyProgramsInFlight) { run_many_in_flight<CallbackBackend>(); }
+TEST(AsyncExecutor, FutureCallsKeepManyProgramsInFlight) { run_many_in_flight<FutureBackend>(); }
+
+TEST(AsyncExecutor, ErrorsReachTheProgramsFuture) {
+    CallbackBackend be;
+    be.vars["x"] = -1;
+    be.service.expected = 1;
+    const auto p = tsexpr::compile("y = price(x) * 2");
+    const auto q = tsexpr::compile("z = missing + 1");
+    tsexpr::AsyncExecutor<CallbackBackend> ex(be);
+    auto fp = ex.submit(p);
+    auto fq = ex.submit(q);
+    EXPECT_THROW(fp.get(), std::runtime_error);
+    EXPECT_THROW(fq.get(), std::runtime_error);
+    ex.wait_all();
+    EXPECT_EQ(ex.in_flight(), 0u);
+    EXPECT_EQ(be.vars.count("y"), 0u);
+}
+
+} // namespace
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <tsexpr/compressed_series.hpp>
+
+#include "../bench/tick_data.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using ts::expr::CompressedSeries;
+using ts::expr::TimeSeries;
+using ts::expr::ValidityBitmap;
+using tsexpr::bench::make_ticks;
+
+TEST(Compressed, RoundTripsAndCompresses) {
+    TimeSeries s = make_ticks(10'000, 1);
+    CompressedSeries c = CompressedSeries::encode(s, 1000);
+    EXPECT_EQ(c.size(), s.size());
+    EXPECT_EQ(c.block_count(), 10u);
+    EXPECT_GT(c.compression_ratio(), 2.0);
+
+    TimeSeries d = c.decode();
+    ASSERT_EQ(d.size(), s.size());
+    EXPECT_EQ(*d.index(), *s.index());
+    for (std::size_t i = 0; i < s.size(); ++i) ASSERT_EQ(d[i], s[i]) << i;
+
+    auto st = c.measure_decode();
+    EXPECT_EQ(st.rows, s.size());
+    EXPECT_EQ(st.blocks, 10u);
+}
+
+TEST(Compressed, RoundTripsArbitraryBitPatterns) {
+    std::mt19937_64 rng(3);
+    std::vector<double> v(777);
+    for (auto& x : v) {
+        std::uint64_t u = rng();
+        std::memcpy(&x, &u, sizeof x);
+        if (std::isnan(x)) x = 0.0; // NaN != NaN would defeat the comparison
+    }
+    CompressedSeries c = CompressedSeries::encode(TimeSeries{v}, 100);
+    TimeSeries d = c.decode();
+    for (std::size_t i = 0; i < v.size(); ++i) ASSERT_EQ(d[i], v[i]) << i;
+}
+
+TEST(Compressed, StreamingKernelsMatchUncompressed) {
+    TimeSeries a = make_ticks(5000, 5);
+    TimeSeries b = make_ticks(5000, 5) * 0.5 + 1.0; // same timestamps
+    // Different block sizes on each side exercise the lockstep windows.
+    CompressedSeries ca = CompressedSeries::encode(a, 700);
+    CompressedSeries cb = CompressedSeries::encode(b, 1024);
+
+    EXPECT_NEAR(ts::expr::sumproduct(ca, cb), ts::expr::sumproduct(a, b), 1e-6);
+    EXPECT_NEAR(ts::expr::sumproduct(ca, 2.0), ts::expr::sumproduct(a, 2.0), 1e-6);
+
+    TimeSeries expect = a - b / 3.0;
+    TimeSeries got = (ca - cb / 3.0).decode();
+    ASSERT_EQ(got.size(), expect.size());
+    EXPECT_EQ(*got.index(), *expect.index());
+    for (std::size_t i = 0; i < got.size(); ++i) ASSERT_DOUBLE_EQ(got[i], expect[i]);
+}
+
+TEST(Compressed, BuilderKeepsItsSettingsAcrossFinish) {
+    CompressedSeries::Builder b(true, 4);
+    const std::int64_t ts[] = {1, 2, 3, 4, 5, 6};
+    const double v[] = {1, 2, 3, 4, 5, 6};
+    b.append(ts, v, 6);
+    const CompressedSeries first = b.finish();
+    EXPECT_EQ(first.block_count(), 2u);
+
+    // A second series from the same builder is timestamped with 4-row blocks
+    // too, and the timestamp order starts over.
+    EXPECT_THROW(b.append(nullptr, v, 1), std::runtime_error);
+    b.append(ts, v, 6);
+    const CompressedSeries second = b.finish();
+    EXPECT_TRUE(second.has_index());
+    EXPECT_EQ(second.block_rows(), 4u);
+    EXPECT_EQ(second.block_count(), 2u);
+    EXPECT_EQ(*second.decode().index(), *first.decode().index());
+}
+
+TEST(Compressed, NullsRoundTripAndStayNullInKernels) {
+    // Null runs at a block start, across a block boundary, and a whole block.
+    const std::size_t n = 1000;
+    std::vector<bool> ok(n, true);
+    for (std::size_t i : {0, 1, 5, 99}) ok[i] = false;
+    for (std::size_t i = 95; i < 110; ++i) ok[i] = false;
+    for (std::size_t i = 300; i < 400; ++i) ok[i] = false;
+    const auto valid = std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok));
+    TimeSeries a = make_ticks(n, 7).with_validity(valid);
+    TimeSeries b = make_ticks(n, 8).with_index(a.index());
+    CompressedSeries ca = CompressedSeries::encode(a, 100);
+    CompressedSeries cb = CompressedSeries::encode(b, 64);
+    EXPECT_EQ(ca.null_count(), valid->size() - valid->count());
+    EXPECT_EQ(cb.null_count(), 0u);
+
+    TimeSeries d = ca.decode();
+    ASSERT_EQ(d.size(), n);
+    EXPECT_EQ(*d.index(), *a.index());
+    for (std::size_t i = 0; i < n; ++i) {
+        ASSERT_EQ(d.is_valid(i), ok[i]) << i;
+        if (ok[i]) {
+            ASSERT_EQ(d[i], a[i]) << i;
+        }
+    }
+    EXPECT_FALSE(cb.decode().has_validity());
+
+    EXPECT_NEAR(ts::expr::sumproduct(ca, cb), ts::expr::sumproduct(a, b), 1e-6);
+    EXPECT_NEAR(ts::expr::sumproduct(cb, ca), ts::expr::sumproduct(a, b), 1e-6);
+    EXPECT_NEAR(ts::expr::sumproduct(ca, 2.0), ts::expr::sumproduct(a, 2.0), 1e-6);
+    EXPECT_NEAR(ts::expr::sumproduct(ca, ca), ts::expr::sumproduct(a, a), 1e-6);
+
+    for (const TimeSeries& got : {(ca * cb).decode(), (cb - ca).decode(), (ca + 1.0).decode()}) {
+        ASSERT_EQ(got.size(), n);
+        for (std::size_t i = 0; i < n; ++i) ASSERT_EQ(got.is_valid(i), ok[i]) << i;
+    }
+    const TimeSeries prod = (ca * cb).decode();
+    const TimeSeries want = a * b;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (ok[i]) {
+            ASSERT_EQ(prod[i], want[i]) << i;
+        }
+    }
+
+    // A null row never turns a sum into NaN.
+    TimeSeries small = TimeSeries{std::vector<double>{2, 7, 3}}.with_validity(
+        std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools({true, false, true})));
+    const CompressedSeries cs = CompressedSeries::encode(small);
+    EXPECT_EQ(ts::expr::sumproduct(cs, 2.0), 10.0);
+    EXPECT_EQ(ts::expr::sumproduct(cs, cs), 13.0);
+}
+
+} // namespace
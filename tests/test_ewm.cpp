@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <tsexpr/ewm.hpp>
+#include <tsexpr/expr.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+using tsexpr::EwmFilter;
+using tsexpr::EwmKind;
+using namespace ts::expr;
+
+TEST(Ewm, HalflifeHalvesTheWeight) {
+    const double a = tsexpr::ewm_alpha(10.0);
+    EXPECT_NEAR(std::pow(1.0 - a, 10.0), 0.5, 1e-12);
+}
+
+TEST(Ewm, MatchesTheRecurrence) {
+    const std::vector<double> x{3, 1, 4, 1, 5, 9, 2, 6};
+    const double a = tsexpr::ewm_alpha(2.0);
+    double m = x[0], v = 0, y = 0.3 * x[0];
+    Env env{{"x", TimeSeries{x}}};
+    execute_assignment("m = ewma(x, 2)", env);
+    execute_assignment("v = ewvar(x, 2)", env);
+    execute_assignment("y = filter(x, 0.3)", env);
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        if (i > 0) {
+            const double d = x[i] - m;
+            m += a * d;
+            v = (1 - a) * (v + a * d * d);
+            y = 0.3 * x[i] + 0.7 * y;
+        }
+        EXPECT_NEAR(env.at("m")[i], m, 1e-12) << i;
+        EXPECT_NEAR(env.at("v")[i], v, 1e-12) << i;
+        EXPECT_NEAR(env.at("y")[i], y, 1e-12) << i;
+    }
+}
+
+TEST(Ewm, SlicesThroughOneStateEqualOnePass) {
+    std::vector<float> x(1000);
+    for (std::size_t i = 0; i < x.size(); ++i) x[i] = float(std::sin(0.01 * double(i)) * 50);
+    std::vector<bool> ok(x.size(), true);
+    ok[0] = ok[1] = ok[500] = false;
+    const TimeSeries s = TimeSeries{x}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+
+    for (EwmKind kind : {EwmKind::Mean, EwmKind::Var, EwmKind::Filter}) {
+        EwmFilter whole(kind, kind == EwmKind::Filter ? 0.05 : 20.0);
+        EwmFilter parts = whole;
+        const TimeSeries want = ewm(whole, s);
+        std::vector<double> got;
+        std::vector<bool> got_ok;
+        for (std::size_t b = 0; b < x.size(); b += 137) {
+            const std::size_t e = std::min(x.size(), b + 137);
+            std::vector<float> part(x.begin() + std::ptrdiff_t(b), x.begin() + std::ptrdiff_t(e));
+            std::vector<bool> part_ok(ok.begin() + std::ptrdiff_t(b), ok.begin() + std::ptrdiff_t(e));
+            const TimeSeries r = ewm(parts, TimeSeries{part}.with_validity(
+                std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(part_ok))));
+            for (std::size_t i = 0; i < r.size(); ++i) {
+                got.push_back(r[i]);
+                got_ok.push_back(r.is_valid(i));
+            }
+        }
+        ASSERT_EQ(got.size(), want.size());
+        for (std::size_t i = 0; i < got.size(); ++i) {
+            ASSERT_EQ(got_ok[i], want.is_valid(i)) << i;
+            if (got_ok[i]) {
+                ASSERT_EQ(got[i], want[i]) << i;
+            }
+        }
+        EXPECT_FALSE(want.is_valid(1));
+        EXPECT_TRUE(want.is_valid(2));
+    }
+}
+
+TEST(Ewm, RejectsBadParameters) {
+    Env env{{"x", TimeSeries{std::vector<double>{1, 2}}}};
+    EXPECT_THROW(execute_assignment("z = ewma(x, 0)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = filter(x, 1.5)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = ewvar(2, 3)", env), EvalError);
+    EXPECT_THROW(EwmFilter(EwmKind::Filter, 0.0), std::invalid_argument);
+}
+
+} // namespace
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <tsexpr/execution.hpp>
+#include <tsexpr/parser.hpp>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Series-valued backend; rows() reports the length of each result.
+struct RowsBackend {
+    using Series = std::vector<double>;
+    std::map<std::string, Series> vars;
+
+    Series load_var(std::string_view name) const {
+        auto it = vars.find(std::string(name));
+        if (it == vars.end()) throw std::runtime_error("unknown var: " + std::string(name));
+        return it->second;
+    }
+    void store_var(std::string_view name, Series v) { vars[std::string(name)] = std::move(v); }
+    Series make_number(double x) const { return {x}; }
+    Series neg(const Series& a) const {
+        Series o(a);
+        for (auto& x : o) x = -x;
+        return o;
+    }
+    Series binary(tsexpr::Op op, const Series& a, const Series& b) const {
+        // Length-1 operands broadcast.
+        const std::size_t n = std::max(a.size(), b.size());
+        Series o(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const double x = a[a.size() == 1 ? 0 : i], y = b[b.size() == 1 ? 0 : i];
+            o[i] = op == tsexpr::Op::Add ? x + y : op == tsexpr::Op::Sub ? x - y : op == tsexpr::Op::Mul ? x * y : x / y;
+        }
+        return o;
+    }
+    Series call(std::string_view, const std::vector<Series>&) const { throw std::runtime_error("no calls"); }
+    std::size_t rows(const Series& s) const { return s.size(); }
+};
+
+TEST(Execution, SuspendsOnInstructionBudgetAndResumes) {
+    RowsBackend be;
+    be.vars["a"] = {1, 2, 3};
+    const auto p = tsexpr::compile("z = (a + 1) * (a - 1) / 2");
+
+    tsexpr::Execution<RowsBackend> ex(p, be);
+    std::size_t slices = 0;
+    while (!ex.resume({/*instructions=*/2})) ++slices;
+    EXPECT_TRUE(ex.done());
+    EXPECT_EQ(ex.instructions_executed(), p.code.size());
+    EXPECT_EQ(slices, (p.code.size() + 1) / 2 - 1);
+    EXPECT_EQ(be.vars["z"], (std::vector<double>{0, 1.5, 4}));
+}
+
+TEST(Execution, RowBudgetLetsCheapProgramsFinishFirst) {
+    RowsBackend be;
+    be.vars["big"] = std::vector<double>(10'000, 1.0);
+    be.vars["small"] = {2.0};
+    const auto heavy = tsexpr::compile("h = big * 2 + big * 3 + big");
+    const auto light = tsexpr::compile("l = small * 2 + 1");
+
+    std::vector<tsexpr::Execution<RowsBackend>> ex{{heavy, be}, {light, be}};
+    const tsexpr::SliceBudget budget{/*instructions=*/1000, /*rows=*/5'000};
+    EXPECT_FALSE(ex[0].resume(budget)); // a 10k-row result overruns the slice
+    EXPECT_TRUE(ex[1].resume(budget));  // the cheap one completes in one slice
+    EXPECT_EQ(be.vars["l"], (std::vector<double>{5}));
+
+    tsexpr::run_round_robin(ex.begin(), ex.end(), budget);
+    EXPECT_TRUE(ex[0].done());
+    EXPECT_EQ(be.vars["h"].size(), 10'000u);
+    EXPECT_EQ(be.vars["h"][0], 6.0);
+    EXPECT_GE(ex[0].rows_processed(), 50'000u);
+}
+
+TEST(Execution, FailureEndsTheExecution) {
+    RowsBackend be;
+    be.vars["a"] = {1};
+    const auto p = tsexpr::compile("z = a + missing");
+    tsexpr::Execution<RowsBackend> ex(p, be);
+    EXPECT_THROW(ex.resume(), std::runtime_error);
+    EXPECT_TRUE(ex.failed());
+    EXPECT_THROW(ex.resume(), tsexpr::EvalError);
+}
+
+TEST(Execution, RoundRobinKeepsGoingPastFailures) {
+    RowsBackend be;
+    be.vars["a"] = {1, 2};
+    const auto ok = tsexpr::compile("x = a * 2 + a * 3 + a");
+    const auto bad = tsexpr::compile("y = a * 2 + missing");
+    const auto ok2 = tsexpr::compile("z = a - 1");
+
+    std::vector<tsexpr::Execution<RowsBackend>> ex{{ok, be}, {bad, be}, {ok2, be}, {bad, be}};
+    EXPECT_THROW(ex[3].resume(), std::runtime_error); // failed before the run: skipped
+    const auto report = tsexpr::run_round_robin(ex.begin(), ex.end(), {/*instructions=*/2});
+    EXPECT_EQ(report.failed(), 1u);
+    ASSERT_EQ(report.errors.size(), 4u);
+    EXPECT_TRUE(report.errors[1]);
+    EXPECT_FALSE(report.errors[3]);
+    EXPECT_THROW(std::rethrow_exception(report.errors[1]), std::runtime_error);
+    EXPECT_TRUE(ex[0].done());
+    EXPECT_TRUE(ex[1].failed());
+    EXPECT_TRUE(ex[2].done());
+    EXPECT_EQ(be.vars["x"], (std::vector<double>{6, 12}));
+    EXPECT_EQ(be.vars["z"], (std::vector<double>{0, 1}));
+    EXPECT_GT(report.slices, 3u);
+}
+
+TEST(Execution, ForkedProgramsRunInline) {
+    RowsBackend be;
+    be.vars["a"] = {1, 2};
+    be.vars["b"] = {3, 4};
+    tsexpr::CompileOptions opt;
+    opt.fork_threshold = 1;
+    const auto p = tsexpr::compile("z = (a + b) - (a * b)", opt);
+    tsexpr::Execution<RowsBackend> ex(p, be);
+    while (!ex.resume({1})) {}
+    EXPECT_EQ(be.vars["z"], (std::vector<double>{1, -2}));
+}
+
+} // namespace
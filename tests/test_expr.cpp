@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include <tsexpr/parser.hpp>
 
+#include <chrono>
+#include <condition_variable>
+#include <future>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <string>
 #include <variant>
@@ -140,4 +144,127 @@ TEST(Expr, ScalarsOnly) {
     EXPECT_DOUBLE_EQ(std::get<double>(be.vars["y"]), 26.0);
 }
 
+TEST(Expr, ForkedSubtreesMatchSerialEvaluation) {
+    Backend be;
+    be.vars["a"] = Series{{1,2,3}};
+    be.vars["b"] = Series{{10,20,30}};
+    be.vars["c"] = Series{{4,5,6}};
+
+    const char* src = "z = sumproduct(a, b) * c - sumproduct(a + c, -b) / (a - sumproduct(c, c))";
+    tsexpr::CompileOptions opt;
+    opt.fork_threshold = 8;
+    const auto forked = tsexpr::compile(src, opt);
+
+    std::size_t forks = 0, joins = 0;
+    for (const auto& ins : forked.code) {
+        forks += ins.op == tsexpr::Op::Fork;
+        joins += ins.op == tsexpr::Op::Join;
+    }
+    EXPECT_EQ(forks, 2u); // both sides of '-', and both sides of '/'
+    EXPECT_EQ(joins, forks);
+
+    Backend serial = be;
+    tsexpr::compile(src).execute(serial);
+    for (int rep = 0; rep < 20; ++rep) forked.execute(be);
+    EXPECT_EQ(std::get<Series>(be.vars["z"]).v, std::get<Series>(serial.vars["z"]).v);
+
+    // Cheap expressions are left alone.
+    const auto plain = tsexpr::compile("y = a + b * c", opt);
+    EXPECT_EQ(plain.code.size(), tsexpr::compile("y = a + b * c").code.size());
+}
+
+TEST(Expr, InputsInFirstUseOrder) {
+    const auto p = tsexpr::compile("z = b + a * b - sumproduct(c, a)");
+    EXPECT_EQ(p.inputs(), (std::vector<std::string>{"b", "a", "c"}));
+}
+
+// Each load completes only once every input has been requested, so loading
+// lazily, one PushVar at a time, would time out.
+struct AsyncBackend : Backend {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::size_t requested = 0, expected = 0, sync_loads = 0;
+
+    std::future<Value> load_var_async(std::string_view name) {
+        { std::lock_guard<std::mutex> lock(mu); ++requested; }
+        cv.notify_all();
+        return std::async(std::launch::async, [this, n = std::string(name)] {
+            std::unique_lock<std::mutex> lock(mu);
+            if (!cv.wait_for(lock, std::chrono::seconds(5), [&] { return requested == expected; }))
+                throw std::runtime_error("loads were not overlapped");
+            lock.unlock();
+            return Backend::load_var(n);
+        });
+    }
+    Value load_var(std::string_view name) {
+        ++sync_loads;
+        return Backend::load_var(name);
+    }
+};
+
+TEST(Expr, PrefetchedExecutionOverlapsLoads) {
+    AsyncBackend be;
+    be.vars["a"] = Series{{1,2,3}};
+    be.vars["b"] = Series{{10,20,30}};
+    be.vars["c"] = 2.0;
+    const auto p = tsexpr::compile("z = a * c + b - a");
+    be.expected = p.inputs().size();
+
+    p.execute_prefetched(be);
+    EXPECT_EQ(be.sync_loads, 0u);
+    EXPECT_EQ(std::get<Series>(be.vars["z"]).v, (std::vector<double>{11, 22, 33}));
+}
+
+TEST(Expr, PrefetchHookRunsBeforeLoads) {
+    struct PrefetchBackend : Backend {
+        std::vector<std::string> fetched;
+        bool loaded_before_prefetch = false;
+        void prefetch(const std::vector<std::string>& names) { fetched = names; }
+        Value load_var(std::string_view name) {
+            loaded_before_prefetch |= fetched.empty();
+            return Backend::load_var(name);
+        }
+    } be;
+    be.vars["x"] = 10.0;
+    be.vars["y"] = 4.0;
+    tsexpr::compile("q = y * x + y").execute_prefetched(be);
+    EXPECT_EQ(be.fetched, (std::vector<std::string>{"y", "x"}));
+    EXPECT_FALSE(be.loaded_before_prefetch);
+    EXPECT_DOUBLE_EQ(std::get<double>(be.vars["q"]), 44.0);
+}
+
+TEST(Expr, CompileManyCollectsErrorsAndSharesNames) {
+    std::vector<std::string> src;
+    for (int i = 0; i < 1000; ++i) src.push_back("v" + std::to_string(i % 10) + " = a * " + std::to_string(i) + " + b");
+    src[500] = "broken = (a +";
+    const std::vector<std::string_view> views(src.begin(), src.end());
+
+    const auto cat = tsexpr::compile_many(views);
+    ASSERT_EQ(cat.programs.size(), src.size());
+    EXPECT_EQ(cat.failed(), 1u);
+    ASSERT_TRUE(cat.errors[500].has_value());
+    EXPECT_TRUE(cat.programs[500].code.empty());
+
+    // Ids follow first appearance in code order: a, b, v0, v1, ...
+    ASSERT_TRUE(cat.names);
+    EXPECT_EQ(cat.names->find("a"), 0u);
+    EXPECT_EQ(cat.names->find("b"), 1u);
+    EXPECT_EQ(cat.names->find("v0"), 2u);
+    EXPECT_EQ(cat.names->names.size(), 12u);
+    EXPECT_EQ(cat.names->find("broken"), tsexpr::Instr::no_name);
+    for (const auto& p : cat.programs) {
+        for (const auto& ins : p.code) {
+            if (ins.op == tsexpr::Op::PushVar || ins.op == tsexpr::Op::Store) {
+                ASSERT_EQ(cat.names->names.at(ins.name_id), ins.text);
+            }
+        }
+    }
+
+    Backend be;
+    be.vars["a"] = 2.0;
+    be.vars["b"] = 1.0;
+    cat.programs[7].execute(be);
+    EXPECT_DOUBLE_EQ(std::get<double>(be.vars["v7"]), 15.0);
+}
+
 } // namespace
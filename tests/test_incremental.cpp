@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <tsexpr/incremental.hpp>
+#include <tsexpr/parser.hpp>
+
+#include "scalar_backend.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using tsexpr::test::ScalarBackend;
+using tsexpr::test::compile_all;
+
+const std::vector<std::string> kChains = {
+    "a1 = x1 * 2",  // 0
+    "b1 = a1 + 1",  // 1
+    "a2 = x2 * 2",  // 2
+    "b2 = a2 + 1",  // 3
+    "s = b1 + b2",  // 4
+};
+
+TEST(Incremental, RerunsOnlyChangedChains) {
+    tsexpr::IncrementalRunner runner(compile_all(kChains));
+    ScalarBackend be;
+    be.vars = {{"x1", 1.0}, {"x2", 2.0}};
+
+    EXPECT_EQ(runner.recompute(be), 5u);
+    EXPECT_EQ(be.vars["s"], 3.0 + 5.0);
+    EXPECT_TRUE(runner.stale().empty());
+    EXPECT_EQ(runner.recompute(be), 0u);
+
+    be.vars["x1"] = 10.0;
+    runner.touch("x1");
+    EXPECT_EQ(runner.stale(), (std::vector<std::size_t>{0, 1, 4}));
+    EXPECT_EQ(runner.recompute(be), 3u);
+
+    ScalarBackend full;
+    full.vars = {{"x1", 10.0}, {"x2", 2.0}};
+    for (const auto& p : runner.programs()) p.execute(full);
+    EXPECT_EQ(be.vars, full.vars);
+
+    runner.invalidate();
+    EXPECT_EQ(runner.recompute(be), 5u);
+}
+
+TEST(Incremental, RerunsWriterOfOverwrittenTarget) {
+    tsexpr::IncrementalRunner runner(compile_all(kChains));
+    ScalarBackend be;
+    be.vars = {{"x1", 1.0}, {"x2", 2.0}};
+    runner.recompute(be);
+
+    be.vars["b1"] = -100.0;
+    runner.touch("b1");
+    EXPECT_EQ(runner.stale(), (std::vector<std::size_t>{1, 4}));
+    runner.recompute(be);
+    EXPECT_EQ(be.vars["b1"], 3.0);
+    EXPECT_EQ(be.vars["s"], 8.0);
+}
+
+TEST(Incremental, OverwrittenEarlierWritesStayFresh) {
+    tsexpr::IncrementalRunner runner(compile_all({"a = x", "b = a + 1", "a = y"}));
+    ScalarBackend be;
+    be.vars = {{"x", 1.0}, {"y", 5.0}};
+    EXPECT_EQ(runner.recompute(be), 3u);
+    EXPECT_EQ(runner.recompute(be), 0u);
+
+    runner.touch("x");
+    EXPECT_EQ(runner.recompute(be), 3u); // the rewrite of a must follow
+    EXPECT_EQ(be.vars["a"], 5.0);
+    EXPECT_EQ(be.vars["b"], 2.0);
+}
+
+TEST(Incremental, LoopCarriedReadsIgnoreOwnWrites) {
+    tsexpr::IncrementalRunner runner(compile_all({"acc = acc + x"}));
+    ScalarBackend be;
+    be.vars = {{"acc", 1.0}, {"x", 3.0}};
+    EXPECT_EQ(runner.recompute(be), 1u);
+    EXPECT_EQ(runner.recompute(be), 0u);
+    EXPECT_EQ(be.vars["acc"], 4.0);
+
+    runner.touch("x");
+    EXPECT_EQ(runner.recompute(be), 1u);
+    EXPECT_EQ(be.vars["acc"], 7.0);
+
+    // A cycle through the batch's own outputs settles the same way.
+    tsexpr::IncrementalRunner cycle(compile_all({"a = b + 1", "b = a * 2"}));
+    be.vars = {{"b", 1.0}};
+    EXPECT_EQ(cycle.recompute(be), 2u);
+    EXPECT_EQ(cycle.recompute(be), 0u);
+    EXPECT_EQ(be.vars["a"], 2.0);
+    EXPECT_EQ(be.vars["b"], 4.0);
+}
+
+TEST(Incremental, ForwardReadsFollowTheLaterWrite) {
+    // y reads the a that the next statement writes: each recompute() must
+    // match one more full run of the batch.
+    const std::vector<std::string> src{"y = a + 1", "a = b * 2"};
+    tsexpr::IncrementalRunner runner(compile_all(src));
+    ScalarBackend be, full;
+    be.vars = full.vars = {{"a", 0.0}, {"b", 5.0}};
+    auto full_run = [&] {
+        for (const auto& p : compile_all(src)) p.execute(full);
+    };
+
+    EXPECT_EQ(runner.recompute(be), 2u);
+    full_run();
+    EXPECT_EQ(be.vars, full.vars); // y = 1, a = 10
+
+    EXPECT_EQ(runner.recompute(be), 1u);
+    full_run();
+    EXPECT_EQ(be.vars, full.vars); // y = 11
+    EXPECT_EQ(runner.recompute(be), 0u);
+
+    be.vars["b"] = full.vars["b"] = 7.0;
+    runner.touch("b");
+    EXPECT_EQ(runner.recompute(be), 1u);
+    full_run();
+    EXPECT_EQ(be.vars, full.vars);
+    EXPECT_EQ(be.vars["y"], 11.0);
+    EXPECT_EQ(be.vars["a"], 14.0);
+
+    EXPECT_EQ(runner.recompute(be), 1u);
+    full_run();
+    EXPECT_EQ(be.vars, full.vars);
+    EXPECT_EQ(be.vars["y"], 15.0);
+}
+
+TEST(Incremental, FailedStatementStaysStale) {
+    tsexpr::IncrementalRunner runner(compile_all({"a = x + 1", "b = check(x)", "c = a + 1"}));
+    ScalarBackend be;
+    be.vars = {{"x", -1.0}};
+    EXPECT_THROW(runner.recompute(be), std::runtime_error);
+    EXPECT_EQ(runner.stale(), (std::vector<std::size_t>{1, 2}));
+
+    be.vars["x"] = 4.0;
+    runner.touch("x");
+    EXPECT_EQ(runner.recompute(be), 3u);
+    EXPECT_EQ(be.vars["b"], 4.0);
+    EXPECT_EQ(be.vars["c"], 6.0);
+}
+
+TEST(Incremental, ParallelRecomputeMatchesFullRun) {
+    std::vector<std::string> src;
+    for (int k = 0; k < 30; ++k) {
+        const std::string x = "x" + std::to_string(k % 6);
+        const std::string v = "v" + std::to_string(k % 4);
+        src.push_back(v + " = " + v + " + " + x);
+        src.push_back("w" + std::to_string(k) + " = " + v + " * 2 - " + x);
+    }
+    tsexpr::IncrementalRunner runner(compile_all(src));
+    tsexpr::ThreadPool pool(4);
+
+    ScalarBackend be;
+    for (int k = 0; k < 6; ++k) be.vars["x" + std::to_string(k)] = k + 1;
+    for (int k = 0; k < 4; ++k) be.vars["v" + std::to_string(k)] = 0.5 * k;
+    ScalarBackend serial = be;
+
+    EXPECT_EQ(runner.recompute(be, pool), src.size());
+    for (const auto& p : runner.programs()) p.execute(serial);
+    EXPECT_EQ(be.vars, serial.vars);
+
+    // Change one input: the rerun statements match the same statements run
+    // serially on the same state.
+    be.vars["x3"] = serial.vars["x3"] = -7.0;
+    runner.touch("x3");
+    const std::vector<std::size_t> todo = runner.stale();
+    EXPECT_LT(todo.size(), src.size());
+    EXPECT_EQ(runner.recompute(be, pool), todo.size());
+    for (std::size_t i : todo) runner.programs()[i].execute(serial);
+    EXPECT_EQ(be.vars, serial.vars);
+}
+
+} // namespace
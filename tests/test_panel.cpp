@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <tsexpr/panel.hpp>
+#include <tsexpr/parser.hpp>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Instrument {
+    std::map<std::string, double> vars;
+
+    double load_var(std::string_view name) const {
+        auto it = vars.find(std::string(name));
+        if (it == vars.end()) throw std::runtime_error("unknown var: " + std::string(name));
+        return it->second;
+    }
+    void store_var(std::string_view name, double v) { vars[std::string(name)] = v; }
+    double make_number(double x) const { return x; }
+    double neg(double a) const { return -a; }
+    double binary(tsexpr::Op op, double a, double b) const {
+        switch (op) {
+            case tsexpr::Op::Add: return a + b;
+            case tsexpr::Op::Sub: return a - b;
+            case tsexpr::Op::Mul: return a * b;
+            case tsexpr::Op::Div: return a / b;
+            default: throw std::runtime_error("bad op");
+        }
+    }
+    double call(std::string_view fn, const std::vector<double>& args) const {
+        if (fn == "max2") return args.at(0) > args.at(1) ? args[0] : args[1];
+        throw std::runtime_error("unknown fn");
+    }
+};
+
+TEST(Panel, RunsEveryInstrumentAndReusesContexts) {
+    const tsexpr::Program p = tsexpr::compile("z = max2(carry, ret * 2) - carry");
+    std::vector<Instrument> panel(2000);
+    for (std::size_t i = 0; i < panel.size(); ++i) {
+        panel[i].vars = {{"carry", double(i % 11)}, {"ret", double(i % 7)}};
+    }
+    panel[123].vars.erase("ret"); // one bad instrument must not stop the rest
+
+    tsexpr::ThreadPool pool(3);
+    const tsexpr::PanelReport r = tsexpr::execute_panel(p, panel.begin(), panel.end(), pool, 16);
+
+    ASSERT_EQ(r.instruments, panel.size());
+    EXPECT_EQ(r.failed(), 1u);
+    EXPECT_NE(r.errors[123], nullptr);
+    EXPECT_GT(r.instruments_per_second(), 0.0);
+    for (std::size_t i = 0; i < panel.size(); ++i) {
+        if (i == 123) continue;
+        const double c = double(i % 11), t = double(i % 7) * 2;
+        ASSERT_EQ(panel[i].vars.at("z"), (c > t ? c : t) - c) << i;
+    }
+}
+
+TEST(Panel, ConcurrentPanelsShareOnePool) {
+    // Each caller's wait may run the other panel's chunks; every chunk must
+    // still get a context no other thread is using.
+    const tsexpr::Program p = tsexpr::compile("z = max2(carry, ret * 2) - carry");
+    tsexpr::ThreadPool pool(2);
+    std::vector<std::vector<Instrument>> panels(4, std::vector<Instrument>(3000));
+    for (auto& panel : panels)
+        for (std::size_t i = 0; i < panel.size(); ++i) panel[i].vars = {{"carry", double(i % 5)}, {"ret", double(i % 9)}};
+
+    for (int round = 0; round < 5; ++round) {
+        std::vector<std::thread> callers;
+        std::vector<std::size_t> failed(panels.size());
+        for (std::size_t k = 0; k < panels.size(); ++k)
+            callers.emplace_back([&, k] {
+                failed[k] = tsexpr::execute_panel(p, panels[k].begin(), panels[k].end(), pool, 4).failed();
+            });
+        for (auto& t : callers) t.join();
+        for (std::size_t k = 0; k < panels.size(); ++k) {
+            EXPECT_EQ(failed[k], 0u);
+            for (std::size_t i = 0; i < panels[k].size(); ++i) {
+                const double c = double(i % 5), t = double(i % 9) * 2;
+                ASSERT_EQ(panels[k][i].vars.at("z"), (c > t ? c : t) - c) << k << " " << i;
+            }
+        }
+    }
+}
+
+TEST(Panel, BuildsBackendsFromBindingSets) {
+    const tsexpr::Program p = tsexpr::compile("y = x * x");
+    std::vector<double> out(100);
+    // Backends built on the fly from a binding; results captured per instrument.
+    struct Bound : Instrument {
+        double* sink{nullptr};
+        void store_var(std::string_view, double v) { *sink = v; }
+    };
+    const auto r = tsexpr::execute_panel(p, out.size(), [&](std::size_t i) {
+        Bound b;
+        b.vars["x"] = double(i);
+        b.sink = &out[i];
+        return b;
+    });
+    EXPECT_EQ(r.failed(), 0u);
+    for (std::size_t i = 0; i < out.size(); ++i) EXPECT_EQ(out[i], double(i * i));
+}
+
+TEST(Panel, ContextSurvivesFailedRun) {
+    tsexpr::ExecutionContext<double> ctx;
+    Instrument in;
+    in.vars = {{"a", 2.0}};
+    EXPECT_THROW(tsexpr::compile("b = a + missing").execute(in, ctx), std::runtime_error);
+    tsexpr::compile("b = max2(a, 5) + a").execute(in, ctx);
+    EXPECT_EQ(in.vars.at("b"), 7.0);
+    EXPECT_TRUE(ctx.stack.empty());
+}
+
+} // namespace
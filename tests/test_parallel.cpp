@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/reduce.hpp>
+#include <tsexpr/thread_pool.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ts::expr::TimeSeries;
+
+// Force the chunked path on small inputs; restores the policy afterwards.
+struct ScopedPolicy {
+    ts::expr::ParallelPolicy saved = ts::expr::parallel_policy();
+    explicit ScopedPolicy(ts::expr::ParallelPolicy p) { ts::expr::set_parallel_policy(p); }
+    ~ScopedPolicy() { ts::expr::set_parallel_policy(saved); }
+};
+
+TEST(ThreadPool, ParallelForCoversEveryIndexOnce) {
+    tsexpr::ThreadPool pool(4);
+    std::vector<std::atomic<int>> hits(10'001);
+    pool.parallel_for(hits.size(), 97, [&](std::size_t b, std::size_t e) {
+        for (std::size_t i = b; i < e; ++i) hits[i].fetch_add(1);
+    });
+    for (auto& h : hits) ASSERT_EQ(h.load(), 1);
+}
+
+TEST(ThreadPool, NestedParallelForDoesNotDeadlock) {
+    tsexpr::ThreadPool pool(2);
+    std::atomic<long> sum{0};
+    pool.parallel_for(16, 1, [&](std::size_t, std::size_t) {
+        pool.parallel_for(100, 10, [&](std::size_t b, std::size_t e) { sum.fetch_add(long(e - b)); });
+    });
+    EXPECT_EQ(sum.load(), 1600);
+}
+
+TEST(ThreadPool, ExceptionsPropagateToCaller) {
+    tsexpr::ThreadPool pool(3);
+    EXPECT_THROW(pool.parallel_for(100, 1, [](std::size_t b, std::size_t) {
+        if (b == 57) throw std::runtime_error("boom");
+    }), std::runtime_error);
+
+    tsexpr::TaskGroup g(pool);
+    g.run([] { throw std::logic_error("task"); });
+    EXPECT_THROW(g.wait(), std::logic_error);
+}
+
+TEST(ThreadPool, ChunkedKernelsMatchSingleThreaded) {
+    const std::size_t n = 10'000;
+    std::vector<double> x(n), y(n);
+    for (std::size_t i = 0; i < n; ++i) { x[i] = double(i % 17) - 8.0; y[i] = 1.0 / double(i + 1); }
+    TimeSeries a{x}, b{y};
+
+    TimeSeries serial = a * b - a / 3.0;
+    ScopedPolicy force({/*min_rows=*/0, /*grain=*/128});
+    TimeSeries chunked = a * b - a / 3.0;
+    ASSERT_EQ(chunked.size(), n);
+    for (std::size_t i = 0; i < n; ++i) ASSERT_EQ(chunked[i], serial[i]);
+
+    double expect = 0.0;
+    for (std::size_t i = 0; i < n; ++i) expect += x[i] * y[i];
+    EXPECT_NEAR(ts::expr::sumproduct(a, b), expect, 1e-9);
+}
+
+TEST(DeterministicReduce, TreeDependsOnlyOnLength) {
+    // Record the combine tree with a non-associative combine: it must be the
+    // fixed pairwise tree, with and without a pool.
+    auto leaf = [](std::size_t b, std::size_t) { return std::to_string(b / tsexpr::reduce_leaf_rows); };
+    auto pair = [](std::string a, std::string b) { return "(" + a + "," + b + ")"; };
+    tsexpr::ThreadPool pool(3);
+    const struct {
+        std::size_t leaves;
+        const char* tree;
+    } cases[] = {
+        {1, "0"},
+        {2, "(0,1)"},
+        {5, "(((0,1),(2,3)),4)"},
+        {6, "(((0,1),(2,3)),(4,5))"},
+        {7, "(((0,1),(2,3)),((4,5),6))"},
+    };
+    for (const auto& c : cases) {
+        const std::size_t n = (c.leaves - 1) * tsexpr::reduce_leaf_rows + 17;
+        EXPECT_EQ(tsexpr::deterministic_reduce(n, std::string{}, leaf, pair), c.tree) << c.leaves;
+        EXPECT_EQ(tsexpr::deterministic_reduce(n, std::string{}, leaf, pair, &pool, 1), c.tree) << c.leaves;
+    }
+    EXPECT_EQ(tsexpr::deterministic_reduce(0, std::string{"-"}, leaf, pair), "-");
+    EXPECT_EQ(tsexpr::deterministic_sum(0, [](std::size_t, std::size_t) { return 1.0; }), 0.0);
+}
+
+TEST(DeterministicReduce, SumproductIsBitIdenticalAcrossPoliciesAndThreads) {
+    // Values of wildly different magnitude make the sum order-sensitive.
+    const std::size_t n = 300'001;
+    std::vector<double> x(n), y(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        x[i] = std::ldexp(1.0 + double(i % 13), int(i % 61) - 30) * (i % 3 ? 1.0 : -1.0);
+        y[i] = 1.0 + 1e-3 * double(i % 101);
+    }
+    TimeSeries a{x}, b{y};
+    auto bits = [](double v) { std::uint64_t u; std::memcpy(&u, &v, 8); return u; };
+
+    double serial;
+    {
+        ScopedPolicy never({/*min_rows=*/n + 1, /*grain=*/1 << 15});
+        serial = ts::expr::sumproduct(a, b);
+    }
+    for (std::size_t threads : {1, 2, 5}) {
+        tsexpr::set_default_thread_count(threads);
+        for (std::size_t grain : {64, 4096, 100'000}) {
+            ScopedPolicy always({/*min_rows=*/0, grain});
+            ASSERT_EQ(bits(ts::expr::sumproduct(a, b)), bits(serial)) << threads << " threads, grain " << grain;
+        }
+    }
+    tsexpr::set_default_thread_count(0);
+}
+
+} // namespace
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/resample.hpp>
+#include <tsexpr/streaming.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using tsexpr::ResampleKind;
+using namespace ts::expr;
+
+TimeSeries ticks(std::vector<std::int64_t> ts, std::vector<double> v, std::vector<bool> ok = {}) {
+    TimeSeries s{TimeIndex(std::move(ts)), std::move(v)};
+    if (ok.empty()) return s;
+    return s.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+}
+
+void expect_same(const TimeSeries& got, const TimeSeries& want) {
+    ASSERT_EQ(got.size(), want.size());
+    ASSERT_TRUE(got.has_index());
+    EXPECT_EQ(*got.index(), *want.index());
+    for (std::size_t i = 0; i < want.size(); ++i) {
+        ASSERT_EQ(got.is_valid(i), want.is_valid(i)) << i;
+        if (want.is_valid(i)) {
+            EXPECT_EQ(got[i], want[i]) << i;
+        }
+    }
+}
+
+TEST(Resample, BucketsFloorTowardsNegativeInfinity) {
+    EXPECT_EQ(tsexpr::bucket_start(0, 10), 0);
+    EXPECT_EQ(tsexpr::bucket_start(19, 10), 10);
+    EXPECT_EQ(tsexpr::bucket_start(-1, 10), -10);
+    EXPECT_EQ(tsexpr::bucket_start(-10, 10), -10);
+}
+
+TEST(Resample, AggregatesEachBucketInOnePass) {
+    // Buckets of 10: [0, 10) has 3 rows, [10, 20) none, [20, 30) one missing
+    // row only, [30, 40) two rows.
+    const TimeSeries x = ticks({1, 4, 9, 25, 30, 38}, {5, 2, 7, 100, 1, 3}, {true, true, true, false, true, true});
+
+    const std::vector<std::int64_t> starts{0, 20, 30};
+    const struct {
+        ResampleKind kind;
+        std::vector<double> values;
+    } cases[] = {
+        {ResampleKind::First, {5, 0, 1}}, {ResampleKind::Last, {7, 0, 3}}, {ResampleKind::Sum, {14, 0, 4}},
+        {ResampleKind::Mean, {14.0 / 3, 0, 2}}, {ResampleKind::Min, {2, 0, 1}}, {ResampleKind::Max, {7, 0, 3}},
+    };
+    for (const auto& c : cases) {
+        expect_same(resample(c.kind, x, 10), ticks(starts, c.values, {true, false, true}));
+    }
+    expect_same(resample(ResampleKind::Count, x, 10), ticks(starts, {3, 0, 2}));
+
+    EXPECT_THROW(resample(ResampleKind::Last, TimeSeries{std::vector<double>{1, 2}}, 10), std::invalid_argument);
+    EXPECT_THROW(resample(ResampleKind::Last, x, 0), std::invalid_argument);
+
+    tsexpr::BucketAggregator agg(ResampleKind::Last, 10);
+    EXPECT_FALSE(agg.current());
+    EXPECT_FALSE(agg.push(5, 1.0));
+    EXPECT_THROW(agg.push(4, 1.0), std::invalid_argument);
+}
+
+TEST(Resample, NonFiniteValues) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    auto bar = [](ResampleKind kind, const std::vector<double>& x) {
+        tsexpr::BucketAggregator agg(kind, 10);
+        for (double v : x) agg.push(0, v);
+        return agg.current()->value;
+    };
+    EXPECT_EQ(bar(ResampleKind::Sum, {1, inf}), inf);
+    EXPECT_EQ(bar(ResampleKind::Sum, {-inf, 1, 2}), -inf);
+    EXPECT_TRUE(std::isnan(bar(ResampleKind::Sum, {inf, 1, -inf})));
+    EXPECT_TRUE(std::isnan(bar(ResampleKind::Sum, {1, nan, 2})));
+    EXPECT_EQ(bar(ResampleKind::Mean, {1, inf, 3}), inf);
+    EXPECT_TRUE(std::isnan(bar(ResampleKind::Mean, {nan, 1})));
+
+    // A NaN wins Min and Max wherever it falls in the bucket.
+    for (ResampleKind kind : {ResampleKind::Min, ResampleKind::Max}) {
+        EXPECT_TRUE(std::isnan(bar(kind, {nan, 5})));
+        EXPECT_TRUE(std::isnan(bar(kind, {5, nan})));
+        EXPECT_TRUE(std::isnan(bar(kind, {5, nan, 7})));
+    }
+    EXPECT_EQ(bar(ResampleKind::Min, {5, -inf, 7}), -inf);
+    EXPECT_EQ(bar(ResampleKind::Max, {inf, 7}), inf);
+    EXPECT_EQ(bar(ResampleKind::Min, {-2, 3}), -2.0);
+
+    // A later bucket starts over.
+    tsexpr::BucketAggregator agg(ResampleKind::Sum, 10);
+    agg.push(0, inf);
+    agg.push(1, -inf);
+    EXPECT_TRUE(std::isnan(agg.push(10, 2)->value));
+    agg.push(11, 3);
+    EXPECT_EQ(agg.current()->value, 5.0);
+}
+
+TEST(Resample, ExpressionsAndErrors) {
+    Env env{{"px", ticks({1000, 1500, 2100, 2200, 3999}, {10, 11, 9, 12, 8})}};
+    execute_assignment("o = resample_open(px, 1000)", env);
+    execute_assignment("h = resample_high(px, 1000)", env);
+    execute_assignment("l = resample_low(px, 1000)", env);
+    execute_assignment("c = resample_close(px, 1000)", env);
+    execute_assignment("range = resample_high(px, 1000) - resample_low(px, 1000)", env);
+    const std::vector<std::int64_t> starts{1000, 2000, 3000};
+    expect_same(env.at("o"), ticks(starts, {10, 9, 8}));
+    expect_same(env.at("h"), ticks(starts, {11, 12, 8}));
+    expect_same(env.at("l"), ticks(starts, {10, 9, 8}));
+    expect_same(env.at("c"), ticks(starts, {11, 12, 8}));
+    expect_same(env.at("range"), ticks(starts, {1, 3, 0}));
+
+    env["pos"] = TimeSeries{std::vector<double>{1, 2}};
+    EXPECT_THROW(execute_assignment("z = resample_last(pos, 10)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = resample_last(px, 0)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = resample_last(px, 2.5)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = resample_last(px)", env), EvalError);
+}
+
+TEST(Resample, StreamingUpdatesTheTrailingBar) {
+    const char* stmt = "bar = resample_sum(qty, 10)";
+    Env env{{"qty", ticks({1, 2}, {1, 2})}};
+    StreamingResample bars(stmt);
+    EXPECT_EQ(bars.update(env), 2u);
+    EXPECT_EQ(bars.update(env), 0u);
+
+    std::vector<std::int64_t> ts{1, 2};
+    const ValidityBitmap* valid = nullptr;
+    const TimeIndex* index = nullptr;
+    for (int t = 0; t < 30; ++t) {
+        const std::int64_t next = ts.back() + (t % 4 == 0 ? 13 : 1);
+        ts.push_back(next);
+        env.at("qty").append(ticks({next}, {double(t)}, {t % 7 != 3}));
+        EXPECT_EQ(bars.update(env), 1u);
+        Env full = env;
+        execute_assignment(stmt, full);
+        expect_same(env.at("bar"), full.at("bar"));
+
+        // Once the target owns its index and bitmap, they grow in place.
+        const TimeSeries& bar = env.at("bar");
+        if (valid) {
+            EXPECT_EQ(bar.validity().get(), valid) << t;
+        }
+        if (index) {
+            EXPECT_EQ(bar.index().get(), index) << t;
+        }
+        if (bar.has_validity()) valid = bar.validity().get();
+        if (bar.size() > 2) index = bar.index().get();
+    }
+    EXPECT_TRUE(valid);
+
+    // Rewritten history: start over, also when only a middle row changed.
+    env.at("qty").mutable_values()[5] += 100;
+    EXPECT_EQ(bars.update(env), env.at("qty").size());
+    {
+        Env full = env;
+        execute_assignment(stmt, full);
+        expect_same(env.at("bar"), full.at("bar"));
+    }
+    env["bar"] = env.at("bar") * 2.0; // target overwritten, same bars
+    env.at("qty").append(ticks({ts.back() + 1}, {1}));
+    EXPECT_EQ(bars.update(env), env.at("qty").size());
+    {
+        Env full = env;
+        execute_assignment(stmt, full);
+        expect_same(env.at("bar"), full.at("bar"));
+    }
+
+    env["qty"] = ticks({5, 50}, {1, 1});
+    EXPECT_EQ(bars.update(env), 2u);
+    expect_same(env.at("bar"), ticks({0, 50}, {1, 1}));
+
+    env["qty"] = TimeSeries{std::vector<double>{1, 1, 1}};
+    EXPECT_THROW(bars.update(env), EvalError);
+
+    EXPECT_THROW(StreamingResample("bar = resample_sum(a + b, 10)"), ParseError);
+    EXPECT_THROW(StreamingResample("bar = resample_sum(a, w)"), ParseError);
+    EXPECT_THROW(StreamingResample("bar = resample_sum(a, -1)"), ParseError);
+    EXPECT_THROW(StreamingResample("bar = a + 1"), ParseError);
+}
+
+} // namespace
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <tsexpr/parser.hpp>
+#include <tsexpr/result_cache.hpp>
+
+#include "scalar_backend.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using tsexpr::test::ScalarBackend;
+
+TEST(ProgramHash, IgnoresForkingButNotContent) {
+    tsexpr::CompileOptions opt;
+    opt.fork_threshold = 1;
+    const char* src = "y = slow(a) + slow(b)";
+    const auto plain = tsexpr::compile(src);
+    const auto forked = tsexpr::compile(src, opt);
+    ASSERT_NE(plain.code.size(), forked.code.size());
+    EXPECT_EQ(tsexpr::program_hash(plain), tsexpr::program_hash(forked));
+
+    EXPECT_NE(tsexpr::program_hash(plain), tsexpr::program_hash(tsexpr::compile("y = slow(a) - slow(b)")));
+    EXPECT_NE(tsexpr::program_hash(tsexpr::compile("y = a + 1")), tsexpr::program_hash(tsexpr::compile("y = a + 2")));
+    EXPECT_NE(tsexpr::program_hash(tsexpr::compile("y = ab")), tsexpr::program_hash(tsexpr::compile("ya = b")));
+
+    EXPECT_EQ(tsexpr::program_canonical(plain), tsexpr::program_canonical(forked));
+    EXPECT_EQ(tsexpr::program_hash(tsexpr::program_canonical(plain)), tsexpr::program_hash(plain));
+}
+
+TEST(ResultCache, HitsReplayStoresUntilAnInputChanges) {
+    tsexpr::ResultCache<double> cache(1 << 20);
+    tsexpr::VersionTable versions;
+    const auto p = tsexpr::compile("y = slow(a) + b");
+    ScalarBackend be;
+    be.vars = {{"a", 1.0}, {"b", 2.0}};
+
+    EXPECT_FALSE(cache.execute(p, be, versions));
+    EXPECT_EQ(be.vars["y"], 12.0);
+    be.vars["y"] = 0.0;
+    EXPECT_TRUE(cache.execute(p, be, versions));
+    EXPECT_EQ(be.vars["y"], 12.0);
+    EXPECT_EQ(be.calls, 1);
+
+    // Recompiling the same text hits too.
+    EXPECT_TRUE(cache.execute(tsexpr::compile("y = slow(a) + b"), be, versions));
+
+    be.vars["b"] = 5.0;
+    versions.bump("b");
+    EXPECT_FALSE(cache.execute(p, be, versions));
+    EXPECT_EQ(be.vars["y"], 15.0);
+    EXPECT_EQ(be.calls, 2);
+
+    const auto s = cache.stats();
+    EXPECT_EQ(s.hits, 2u);
+    EXPECT_EQ(s.misses, 2u);
+    EXPECT_EQ(s.entries, 2u);
+    EXPECT_DOUBLE_EQ(s.hit_rate(), 0.5);
+}
+
+TEST(ResultCache, HitsRestoreOutputVersionsSoDownstreamHits) {
+    tsexpr::ResultCache<double> cache(1 << 20);
+    tsexpr::VersionTable versions;
+    const auto up = tsexpr::compile("y = slow(a)");
+    const auto down = tsexpr::compile("z = slow(y) + 1");
+    ScalarBackend be;
+    be.vars = {{"a", 1.0}};
+
+    EXPECT_FALSE(cache.execute(up, be, versions));
+    const std::uint64_t y1 = versions.get("y");
+    EXPECT_NE(y1, 0u);
+    EXPECT_FALSE(cache.execute(down, be, versions));
+    const std::uint64_t z1 = versions.get("z");
+
+    // A rerun of the pipeline hits at every stage and leaves the versions
+    // where the first run put them.
+    EXPECT_TRUE(cache.execute(up, be, versions));
+    EXPECT_EQ(versions.get("y"), y1);
+    EXPECT_TRUE(cache.execute(down, be, versions));
+    EXPECT_EQ(versions.get("z"), z1);
+    EXPECT_EQ(be.calls, 2);
+
+    // A changed input gives the output a new version, and the old one back
+    // once the input's old version is back.
+    const std::uint64_t a1 = versions.get("a");
+    be.vars["a"] = 2.0;
+    versions.bump("a");
+    EXPECT_FALSE(cache.execute(up, be, versions));
+    EXPECT_NE(versions.get("y"), y1);
+    EXPECT_FALSE(cache.execute(down, be, versions));
+    EXPECT_EQ(be.vars["z"], 201.0);
+
+    be.vars["a"] = 1.0;
+    versions.set("a", a1);
+    EXPECT_TRUE(cache.execute(up, be, versions));
+    EXPECT_TRUE(cache.execute(down, be, versions));
+    EXPECT_EQ(versions.get("z"), z1);
+    EXPECT_EQ(be.vars["z"], 101.0);
+    EXPECT_EQ(be.calls, 4);
+}
+
+TEST(ResultCache, ContentKeysAreCallerDefined) {
+    tsexpr::ResultCache<double> cache(1 << 20);
+    const auto p = tsexpr::compile("y = slow(a)");
+    ScalarBackend be;
+    be.vars = {{"a", 3.0}};
+    EXPECT_FALSE(cache.execute(p, be, {42}));
+    EXPECT_TRUE(cache.execute(p, be, {42}));
+    EXPECT_FALSE(cache.execute(p, be, {43}));
+    EXPECT_EQ(be.calls, 2);
+
+    // One key per input: a short or long key list would alias other entries.
+    EXPECT_THROW(cache.execute(p, be, {}), std::invalid_argument);
+    EXPECT_THROW(cache.execute(p, be, {42, 1}), std::invalid_argument);
+    EXPECT_EQ(be.calls, 2);
+    EXPECT_EQ(cache.stats().hits + cache.stats().misses, 3u);
+}
+
+TEST(ResultCache, EvictsLeastRecentlyUsedWithinBudget) {
+    // Each entry is charged 1 (name "y") + 8 (the value) = 9 bytes.
+    tsexpr::ResultCache<double> cache(20, [](const double&) { return std::size_t{8}; });
+    const auto p = tsexpr::compile("y = slow(a)");
+    ScalarBackend be;
+    be.vars = {{"a", 1.0}};
+
+    EXPECT_FALSE(cache.execute(p, be, {1}));
+    EXPECT_FALSE(cache.execute(p, be, {2}));
+    EXPECT_TRUE(cache.execute(p, be, {1})); // 1 is now the most recent
+    EXPECT_FALSE(cache.execute(p, be, {3})); // evicts 2
+
+    auto s = cache.stats();
+    EXPECT_EQ(s.evictions, 1u);
+    EXPECT_EQ(s.evicted_bytes, 9u);
+    EXPECT_EQ(s.entries, 2u);
+    EXPECT_EQ(s.bytes, 18u);
+    EXPECT_TRUE(cache.execute(p, be, {1}));
+    EXPECT_FALSE(cache.execute(p, be, {2}));
+
+    // Too large for the whole budget: evaluated, never kept.
+    tsexpr::ResultCache<double> tiny(4);
+    EXPECT_FALSE(tiny.execute(p, be, {1}));
+    EXPECT_FALSE(tiny.execute(p, be, {1}));
+    EXPECT_EQ(tiny.stats().entries, 0u);
+
+    cache.clear();
+    s = cache.stats();
+    EXPECT_EQ(s.entries, 0u);
+    EXPECT_EQ(s.hits + s.misses, 0u);
+}
+
+TEST(ResultCache, FailedRunsAreNotCached) {
+    tsexpr::ResultCache<double> cache(1 << 20);
+    const auto p = tsexpr::compile("y = check(a)");
+    ScalarBackend be;
+    be.vars = {{"a", -1.0}};
+    EXPECT_THROW(cache.execute(p, be, {7}), std::runtime_error);
+    EXPECT_EQ(cache.stats().entries, 0u);
+    be.vars["a"] = 2.0;
+    EXPECT_FALSE(cache.execute(p, be, {7}));
+    EXPECT_EQ(be.vars["y"], 2.0);
+}
+
+} // namespace
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/rolling.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <random>
+#include <vector>
+
+namespace {
+
+using tsexpr::RollingKind;
+using tsexpr::RollingWindow;
+using namespace ts::expr;
+
+// Brute-force statistic over rows (i - w, i] of x, skipping nulls.
+std::optional<double> naive(RollingKind kind, const std::vector<double>& x, const std::vector<bool>& ok,
+                            std::size_t i, std::size_t w) {
+    if (i + 1 < w) return std::nullopt;
+    std::vector<double> v;
+    for (std::size_t j = i + 1 - w; j <= i; ++j)
+        if (ok[j]) v.push_back(x[j]);
+    if (v.size() < (kind == RollingKind::Std ? 2u : 1u)) return std::nullopt;
+    double sum = 0;
+    for (double d : v) sum += d;
+    const double mean = sum / double(v.size());
+    switch (kind) {
+        case RollingKind::Sum: return sum;
+        case RollingKind::Mean: return mean;
+        case RollingKind::Std: {
+            double ss = 0;
+            for (double d : v) ss += (d - mean) * (d - mean);
+            return std::sqrt(ss / double(v.size() - 1));
+        }
+        case RollingKind::Min: return *std::min_element(v.begin(), v.end());
+        case RollingKind::Max: return *std::max_element(v.begin(), v.end());
+    }
+    return std::nullopt;
+}
+
+TEST(Rolling, MatchesBruteForceWithNulls) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> dist(100.0, 5.0);
+    std::vector<double> x(500);
+    std::vector<bool> ok(x.size());
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        x[i] = dist(rng);
+        ok[i] = i % 11 != 3 && !(i >= 200 && i < 230); // sparse nulls and one long gap
+    }
+    const TimeSeries s = TimeSeries{x}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+
+    for (RollingKind kind : {RollingKind::Sum, RollingKind::Mean, RollingKind::Std, RollingKind::Min, RollingKind::Max}) {
+        for (std::size_t w : {1u, 2u, 7u, 64u}) {
+            const TimeSeries r = rolling(kind, s, w);
+            ASSERT_EQ(r.size(), x.size());
+            for (std::size_t i = 0; i < x.size(); ++i) {
+                const std::optional<double> want = naive(kind, x, ok, i, w);
+                ASSERT_EQ(r.is_valid(i), want.has_value()) << int(kind) << " w=" << w << " i=" << i;
+                if (want) {
+                    ASSERT_NEAR(r[i], *want, 1e-9 * std::max(1.0, std::fabs(*want))) << int(kind) << " w=" << w << " i=" << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(Rolling, NonFiniteValuesOnlyAffectTheirWindows) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    auto run = [](RollingKind kind, const std::vector<double>& x, std::size_t w) {
+        std::vector<double> out;
+        RollingWindow win(kind, w);
+        for (double v : x) out.push_back(win.push(v).value_or(-999));
+        return out;
+    };
+    auto same = [](const std::vector<double>& got, const std::vector<double>& want) {
+        ASSERT_EQ(got.size(), want.size());
+        for (std::size_t i = 0; i < want.size(); ++i) {
+            if (std::isnan(want[i])) {
+                EXPECT_TRUE(std::isnan(got[i])) << i;
+            } else {
+                EXPECT_EQ(got[i], want[i]) << i;
+            }
+        }
+    };
+
+    same(run(RollingKind::Sum, {1, inf, 1, 2, 3}, 2), {-999, inf, inf, 3, 5});
+    same(run(RollingKind::Sum, {1, inf, -inf, 2, 3}, 2), {-999, inf, nan, -inf, 5});
+    same(run(RollingKind::Mean, {1, nan, 1, 2, 3}, 2), {-999, nan, nan, 1.5, 2.5});
+    same(run(RollingKind::Std, {1, 3, inf, 1, 3, 5}, 2), {-999, std::sqrt(2.0), nan, nan, std::sqrt(2.0), std::sqrt(2.0)});
+    same(run(RollingKind::Max, {1, inf, 2, nan, 3, 1}, 2), {-999, inf, inf, nan, nan, 3});
+    same(run(RollingKind::Min, {1, -inf, 2, 0, nan, 1}, 2), {-999, -inf, -inf, 0, nan, nan});
+
+    // Through the series kernel too.
+    const TimeSeries r = rolling(RollingKind::Sum, TimeSeries{std::vector<double>{1, inf, 1, 2, 3}}, 2);
+    EXPECT_FALSE(r.is_valid(0));
+    EXPECT_EQ(r[2], inf);
+    EXPECT_EQ(r[3], 3.0);
+    EXPECT_EQ(r[4], 5.0);
+}
+
+TEST(Rolling, StdStaysAccurateOnLargeOffsets) {
+    RollingWindow w(RollingKind::Std, 3);
+    std::optional<double> r;
+    for (double d : {1e9 + 4, 1e9 + 7, 1e9 + 13, 1e9 + 16, 1e9 + 10}) r = w.push(d);
+    ASSERT_TRUE(r);
+    EXPECT_NEAR(*r, 3.0, 1e-6); // {13, 16, 10}
+}
+
+TEST(Rolling, ExpressionsAndErrors) {
+    Env env{{"a", TimeSeries{TimeIndex{1, 2, 3, 4}, std::vector<double>{1, 5, 2, 8}}}};
+    execute_assignment("m = rolling_max(a, 2) - rolling_min(a, 2)", env);
+    const TimeSeries& m = env.at("m");
+    EXPECT_EQ(m.index(), env.at("a").index());
+    EXPECT_FALSE(m.is_valid(0));
+    EXPECT_EQ(m[1], 4.0);
+    EXPECT_EQ(m[2], 3.0);
+    EXPECT_EQ(m[3], 6.0);
+
+    execute_assignment("s = rolling_sum(a, 10)", env); // longer than the series
+    EXPECT_FALSE(env.at("s").is_valid(3));
+
+    EXPECT_THROW(execute_assignment("z = rolling_mean(a, 0)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = rolling_mean(a, 1.5)", env), EvalError);
+    EXPECT_THROW(execute_assignment("z = rolling_mean(2, 3)", env), EvalError);
+    EXPECT_THROW(RollingWindow(RollingKind::Sum, 0), std::invalid_argument);
+}
+
+} // namespace
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/parser.hpp>
+#include <tsexpr/row_kernel.hpp>
+
+#include "scalar_backend.hpp"
+
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using tsexpr::test::ScalarBackend;
+
+TEST(RowKernel, MatchesProgramExecution) {
+    tsexpr::CompileOptions forking;
+    forking.fork_threshold = 1;
+    const std::vector<std::string> statements = {
+        "z = a + b - c / 2",
+        "z = -(a - b) * (c + 1.5) / (a * a + 1)",
+        "z = a - (b - (c - (a - 2)))",
+        "z = 7",
+    };
+    for (const auto& src : statements) {
+        for (const auto& program : {tsexpr::compile(src), tsexpr::compile(src, forking)}) {
+            const tsexpr::RowKernel kernel(program);
+            EXPECT_EQ(kernel.target(), "z");
+            for (int row = 0; row < 20; ++row) {
+                ScalarBackend be;
+                be.vars = {{"a", std::sin(row) * 3}, {"b", row * 0.25 - 1}, {"c", std::cos(row * 0.7)}};
+                program.execute(be);
+                std::vector<double> slots;
+                for (const auto& name : kernel.inputs()) slots.push_back(be.vars.at(name));
+                EXPECT_EQ(kernel(slots.data()), be.vars.at("z")) << src << " row " << row;
+            }
+        }
+    }
+}
+
+TEST(RowKernel, Float32MatchesSeriesEvaluation) {
+    // Precision follows the TimeSeries rules, so every row is what
+    // execute_assignment stores for it.
+    const std::vector<std::string> statements = {
+        "z = float32(a) * 3 - float64(b - a)",
+        "z = float32(a) * float32(b) + 0.1",
+        "z = 0.1 / float32(c) - float32(a) / 7",
+        "z = -float32(a + b) * float32(c) + float32(2.5) * a",
+        "z = float64(float32(a) / 3) / 3",
+        "z = (1 / 3) * float32(b)",
+    };
+    ts::expr::Env env;
+    for (const char* name : {"a", "b", "c"}) {
+        std::vector<double> v(50);
+        for (std::size_t i = 0; i < v.size(); ++i) v[i] = std::sin(double(i) * (name[0] - 'a' + 1.3)) * 1e3 / 7;
+        env[name] = ts::expr::TimeSeries{std::move(v)};
+    }
+    for (const auto& src : statements) {
+        const tsexpr::RowKernel kernel(tsexpr::compile(src));
+        ts::expr::execute_assignment(src, env);
+        const ts::expr::TimeSeries& z = env.at("z");
+        ASSERT_EQ(z.size(), 50u) << src;
+        for (std::size_t row = 0; row < z.size(); ++row) {
+            std::vector<double> slots;
+            for (const auto& name : kernel.inputs()) slots.push_back(env.at(name)[row]);
+            EXPECT_EQ(kernel(slots.data()), z[row]) << src << " row " << row;
+        }
+    }
+}
+
+TEST(RowKernel, SlotsFollowFirstUse) {
+    const tsexpr::RowKernel kernel(tsexpr::compile("out = y * x + y"));
+    EXPECT_EQ(kernel.inputs(), (std::vector<std::string>{"y", "x"}));
+    const double slots[] = {2.0, 10.0};
+    EXPECT_EQ(kernel(slots), 22.0);
+
+    const double nan[] = {std::nan(""), 1.0};
+    EXPECT_TRUE(std::isnan(kernel(nan)));
+}
+
+TEST(RowKernel, RejectsNonRowLocalPrograms) {
+    EXPECT_THROW(tsexpr::RowKernel(tsexpr::compile("z = sumproduct(a, b)")), tsexpr::EvalError);
+    EXPECT_THROW(tsexpr::RowKernel(tsexpr::compile("z = rolling_mean(a, 3)")), tsexpr::EvalError);
+    EXPECT_THROW(tsexpr::RowKernel(tsexpr::Program{}), tsexpr::EvalError);
+
+    std::string deep = "z = a";
+    for (std::size_t i = 0; i < tsexpr::RowKernel::max_depth; ++i) deep += " + (a";
+    deep += std::string(tsexpr::RowKernel::max_depth, ')');
+    EXPECT_THROW(tsexpr::RowKernel(tsexpr::compile(deep)), tsexpr::EvalError);
+}
+
+} // namespace
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/parser.hpp>
+#include <tsexpr/scheduler.hpp>
+
+#include "scalar_backend.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using tsexpr::test::ScalarBackend;
+using tsexpr::test::compile_all;
+
+TEST(Scheduler, BuildsReadWriteDependencies) {
+    const auto progs = compile_all({
+        "a = x + 1",  // 0
+        "b = a * 2",  // 1: reads a (after 0)
+        "c = x - 1",  // 2: independent
+        "a = y",      // 3: rewrites a (after 0) once 1 has read it
+        "d = a + b",  // 4: reads the new a (after 3) and b (after 1)
+    });
+    const auto g = tsexpr::DependencyGraph::from_programs(progs);
+    ASSERT_EQ(g.size(), 5u);
+    EXPECT_EQ(g.successors(0), (std::vector<std::size_t>{1, 3}));
+    EXPECT_EQ(g.successors(1), (std::vector<std::size_t>{3, 4}));
+    EXPECT_TRUE(g.successors(2).empty());
+    EXPECT_EQ(g.successors(3), (std::vector<std::size_t>{4}));
+    EXPECT_EQ(g.predecessor_count(2), 0u);
+    EXPECT_EQ(g.predecessor_count(4), 2u);
+}
+
+TEST(Scheduler, ParallelExecutionMatchesSerialOrder) {
+    // Independent chains interleaved with rewrites of shared variables.
+    std::vector<std::string> src;
+    for (int k = 0; k < 40; ++k) {
+        const std::string v = "v" + std::to_string(k % 7);
+        src.push_back(v + " = " + v + " * 2 + acc");
+        src.push_back("acc = acc + " + std::to_string(k));
+        src.push_back("w" + std::to_string(k) + " = " + v + " - acc");
+    }
+    const auto progs = compile_all(src);
+
+    ScalarBackend serial, parallel;
+    for (int k = 0; k < 7; ++k) serial.vars["v" + std::to_string(k)] = k;
+    serial.vars["acc"] = 0.5;
+    parallel.vars = serial.vars;
+
+    for (const auto& p : progs) p.execute(serial);
+    tsexpr::ThreadPool pool(4);
+    tsexpr::execute_parallel(progs, parallel, pool);
+    EXPECT_EQ(parallel.vars, serial.vars);
+}
+
+TEST(Scheduler, RethrowsEarliestFailureAndStopsDependents) {
+    const auto progs = compile_all({"a = fail(1)", "b = a + 1", "c = fail(2)"});
+    ScalarBackend be;
+    tsexpr::ThreadPool pool(2);
+    try {
+        tsexpr::execute_parallel(progs, be, pool);
+        FAIL() << "expected an exception";
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ(std::string(e.what()), "fail(1.000000)");
+    }
+    EXPECT_EQ(be.vars.count("b"), 0u);
+}
+
+TEST(Scheduler, EnvBatchMatchesSerialAndFailsLikeSerial) {
+    using namespace ts::expr;
+    const std::vector<std::string> batch = {
+        "x = a + b", "y = a * 2", "z = x - y", "a = z / 2", "s = sumproduct(a, b)",
+    };
+    Env serial{{"a", TimeSeries{std::vector<double>{1, 2, 3}}}, {"b", TimeSeries{std::vector<double>{4, 5, 6}}}};
+    Env parallel = serial;
+    for (const auto& s : batch) execute_assignment(s, serial);
+    execute_assignments(batch, parallel);
+    ASSERT_EQ(parallel.size(), serial.size());
+    for (const auto& [name, ts] : serial) {
+        ASSERT_EQ(parallel.at(name).size(), ts.size()) << name;
+        for (std::size_t i = 0; i < ts.size(); ++i) EXPECT_EQ(parallel.at(name)[i], ts[i]) << name;
+    }
+
+    // An undefined read falls back to serial: earlier statements still land.
+    Env env{{"a", TimeSeries{std::vector<double>{1}}}};
+    EXPECT_THROW(execute_assignments({"p = a + 1", "q = missing", "r = a"}, env), EvalError);
+    EXPECT_EQ(env.count("p"), 1u);
+    EXPECT_EQ(env.count("q"), 0u);
+    EXPECT_EQ(env.count("r"), 0u);
+
+    // An evaluation error undoes the statements after it that ran anyway:
+    // existing variables keep their old values and new ones disappear.
+    for (int round = 0; round < 20; ++round) {
+        Env env2{{"a", TimeSeries{std::vector<double>{1, 2, 3}}},
+                 {"short", TimeSeries{std::vector<double>{1, 2}}},
+                 {"r", TimeSeries{std::vector<double>{7}}}};
+        EXPECT_THROW(execute_assignments({"p = a + 1", "q = a + short", "r = a * 3", "p = a", "t = r"}, env2),
+                     std::runtime_error);
+        ASSERT_EQ(env2.at("r").size(), 1u);
+        EXPECT_EQ(env2.at("r")[0], 7.0);
+        ASSERT_EQ(env2.at("p").size(), 3u);
+        EXPECT_EQ(env2.at("p")[0], 2.0);
+        EXPECT_EQ(env2.count("q"), 0u);
+        EXPECT_EQ(env2.count("t"), 0u);
+    }
+}
+
+} // namespace
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/parser.hpp>
+#include <tsexpr/snapshot_store.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ts::expr::TimeSeries;
+
+TEST(SnapshotStore, SnapshotsAreStableAcrossPublishes) {
+    tsexpr::SnapshotStore<double> store;
+    store.store("a", 1.0);
+    const auto before = store.snapshot();
+    EXPECT_EQ(store.publish({{"a", 2.0}, {"b", 3.0}}), 2u);
+    store.erase("a");
+
+    EXPECT_EQ(before.version(), 1u);
+    EXPECT_EQ(*before.find("a"), 1.0);
+    EXPECT_EQ(before.find("b"), nullptr);
+
+    const auto now = store.snapshot();
+    EXPECT_EQ(now.version(), 3u);
+    EXPECT_EQ(now.find("a"), nullptr);
+    EXPECT_EQ(*now.find("b"), 3.0);
+}
+
+TEST(SnapshotStore, ReadersSeeConsistentVersionsWhileWriterPublishes) {
+    // The writer keeps a + b == 0 in every version; readers evaluating
+    // a + b on a snapshot must never observe a half-applied update.
+    ts::expr::VariableStore store({{"a", TimeSeries{std::vector<double>{0, 0}}},
+                                   {"b", TimeSeries{std::vector<double>{0, 0}}}});
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int k = 1; k <= 2000; ++k) {
+            store.publish({{"a", TimeSeries{std::vector<double>{double(k), double(2 * k)}}},
+                           {"b", TimeSeries{std::vector<double>{double(-k), double(-2 * k)}}}});
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> readers;
+    std::atomic<int> bad{0};
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&] {
+            std::uint64_t last = 0;
+            while (!done) {
+                const auto snap = store.snapshot();
+                if (snap.version() < last) ++bad;
+                last = snap.version();
+                const ts::expr::Value v = ts::expr::eval_rpn(ts::expr::compile("s = a + b").rpn, snap.vars());
+                const auto& s = std::get<TimeSeries>(v);
+                if (s[0] != 0.0 || s[1] != 0.0) ++bad;
+            }
+        });
+    }
+    writer.join();
+    for (auto& t : readers) t.join();
+    EXPECT_EQ(bad.load(), 0);
+    EXPECT_EQ(store.version(), 2000u);
+
+    ts::expr::execute_assignment("c = a * 2", store);
+    EXPECT_EQ((*store.snapshot().find("c"))[1], 8000.0);
+}
+
+TEST(SnapshotStore, ProgramsRunAgainstASnapshot) {
+    struct Ops {
+        double make_number(double x) const { return x; }
+        double neg(double a) const { return -a; }
+        double binary(tsexpr::Op op, double a, double b) const { return op == tsexpr::Op::Add ? a + b : a * b; }
+        double call(std::string_view, const std::vector<double>&) const { throw std::runtime_error("no calls"); }
+    } ops;
+    tsexpr::SnapshotStore<double> store({{"x", 2.0}});
+    tsexpr::SnapshotBackend<double, Ops> be(store, ops);
+    store.store("x", 100.0); // after the snapshot: not seen
+    tsexpr::compile("y = x * x + 1").execute(be);
+    EXPECT_EQ(*store.snapshot().find("y"), 5.0);
+    EXPECT_THROW(tsexpr::compile("z = missing").execute(be), tsexpr::EvalError);
+}
+
+} // namespace
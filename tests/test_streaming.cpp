@@ -0,0 +1,395 @@
+#include <gtest/gtest.h>
+#include <tsexpr/streaming.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using namespace ts::expr;
+
+// Append one tick to a positional input in place.
+void tick(Env& env, const std::string& name, double x) {
+    env.at(name).append(TimeSeries{std::vector<double>{x}});
+}
+
+void expect_same(const TimeSeries& got, const TimeSeries& want) {
+    ASSERT_EQ(got.size(), want.size());
+    for (std::size_t i = 0; i < want.size(); ++i) {
+        ASSERT_EQ(got.is_valid(i), want.is_valid(i)) << i;
+        if (want.is_valid(i)) {
+            ASSERT_EQ(got[i], want[i]) << i;
+        }
+    }
+}
+
+TEST(Streaming, AppendsOnlyNewRows) {
+    Env env{{"a", TimeSeries{std::vector<double>{1, 2, 3}}},
+            {"b", TimeSeries{std::vector<double>{10, 20, 30}}},
+            {"c", TimeSeries{std::vector<double>{4, 4, 4}}}};
+    StreamingAssignment z("z = a + b - c / 2");
+    EXPECT_EQ(z.update(env), 3u);
+    EXPECT_EQ(z.update(env), 0u);
+
+    for (int t = 0; t < 5; ++t) {
+        tick(env, "a", t);
+        tick(env, "b", 100 + t);
+        tick(env, "c", 2 * t);
+        EXPECT_EQ(z.update(env), 1u);
+    }
+    EXPECT_EQ(z.high_water(), 8u);
+
+    Env full = env;
+    execute_assignment("z = a + b - c / 2", full);
+    expect_same(env.at("z"), full.at("z"));
+}
+
+TEST(Streaming, RecomputesWhenHistoryIsRewritten) {
+    Env env{{"a", TimeSeries{std::vector<double>{1, 2, 3, 4}}}};
+    StreamingAssignment z("z = a * 2");
+    z.update(env);
+
+    env["a"] = TimeSeries{std::vector<double>{5, 6}}; // shorter: history replaced
+    EXPECT_EQ(z.update(env), 2u);
+    expect_same(env.at("z"), TimeSeries{std::vector<double>{10, 12}});
+
+    env["z"] = TimeSeries{std::vector<double>{0}}; // target overwritten
+    tick(env, "a", 7);
+    EXPECT_EQ(z.update(env), 3u);
+    expect_same(env.at("z"), TimeSeries{std::vector<double>{10, 12, 14}});
+
+    env["z"] = TimeSeries{std::vector<double>{0, 0, 0}}; // same length, foreign rows
+    tick(env, "a", 8);
+    EXPECT_EQ(z.update(env), 4u);
+    expect_same(env.at("z"), TimeSeries{std::vector<double>{10, 12, 14, 16}});
+
+    env.at("a").mutable_values()[0] = 1; // input edited in place
+    tick(env, "a", 9);
+    EXPECT_EQ(z.update(env), 5u);
+    expect_same(env.at("z"), TimeSeries{std::vector<double>{2, 12, 14, 16, 18}});
+
+    EXPECT_THROW(StreamingAssignment("s = sumproduct(a, a)"), ParseError);
+}
+
+TEST(Streaming, RollingWindowsUseLookback) {
+    const char* stmt = "z = rolling_mean(a, 3) - rolling_std(rolling_sum(a, 2), 4)";
+    Env env{{"a", TimeSeries{std::vector<double>{3, 1, 4, 1, 5}}}};
+    StreamingAssignment z(stmt);
+    z.update(env);
+    for (int t = 0; t < 8; ++t) {
+        tick(env, "a", t % 3 == 0 ? -t : 2.5 * t);
+        EXPECT_EQ(z.update(env), 1u);
+        Env full = env;
+        execute_assignment(stmt, full);
+        expect_same(env.at("z"), full.at("z"));
+    }
+    EXPECT_THROW(StreamingAssignment("z = rolling_sum(a, b)"), ParseError);
+}
+
+TEST(Streaming, RecursiveFiltersCarryState) {
+    const char* stmt = "vol = ewvar(r, 5) - ewma(r * r, 5) + rolling_mean(r, 3) * filter(r, 0.2)";
+    Env env{{"r", TimeSeries{std::vector<double>{0.01, -0.02, 0.015}}}};
+    StreamingAssignment z(stmt);
+    z.update(env);
+    for (int t = 0; t < 10; ++t) {
+        tick(env, "r", 0.001 * (t % 4) - 0.0015);
+        EXPECT_EQ(z.update(env), 1u);
+    }
+    Env full = env;
+    execute_assignment(stmt, full);
+    const TimeSeries& got = env.at("vol");
+    const TimeSeries& want = full.at("vol");
+    ASSERT_EQ(got.size(), want.size());
+    for (std::size_t i = 0; i < want.size(); ++i) {
+        ASSERT_EQ(got.is_valid(i), want.is_valid(i)) << i;
+        if (want.is_valid(i)) {
+            EXPECT_NEAR(got[i], want[i], 1e-15) << i;
+        }
+    }
+
+    env["r"] = TimeSeries{std::vector<double>{1, 2}}; // rewritten: the filters restart
+    EXPECT_EQ(z.update(env), 2u);
+    Env again = env;
+    execute_assignment(stmt, again);
+    EXPECT_DOUBLE_EQ(env.at("vol")[1], again.at("vol")[1]);
+
+    EXPECT_THROW(StreamingAssignment("z = rolling_sum(ewma(a, 3), 2)"), ParseError);
+    EXPECT_THROW(StreamingAssignment("z = ewma(rolling_sum(a, 2), 3)"), ParseError);
+    EXPECT_THROW(StreamingAssignment("z = ewma(a, h)"), ParseError);
+    EXPECT_THROW(StreamingAssignment("z = filter(a, 2)"), ParseError);
+}
+
+TEST(Streaming, RowsAppendedAfterAPartialBitmapWordStayValid) {
+    auto nulls = [](std::vector<double> v, std::vector<bool> ok) {
+        return TimeSeries{std::move(v)}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+    };
+    Env env{{"a", nulls({1, 2, 3}, {true, false, true})}};
+    StreamingAssignment z("z = a * 2");
+    z.update(env);
+
+    env["a"].append(TimeSeries{std::vector<double>{4, 5}});
+    EXPECT_EQ(z.update(env), 2u);
+    expect_same(env.at("z"), nulls({2, 4, 6, 8, 10}, {true, false, true, true, true}));
+}
+
+TEST(Streaming, TimestampedInputsWithNulls) {
+    auto series = [](std::vector<std::int64_t> ts, std::vector<double> v, std::vector<bool> ok) {
+        return TimeSeries{TimeIndex(ts), std::move(v)}.with_validity(
+            std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+    };
+    Env env{{"a", series({1, 2, 3}, {1, 2, 3}, {true, false, true})},
+            {"b", series({1, 2, 3}, {4, 5, 6}, {true, true, true})}};
+    StreamingAssignment z("z = a - b");
+    z.update(env);
+
+    env.at("a").append(series({4}, {9}, {false}));
+    env.at("b").append(series({4}, {1}, {true}));
+    EXPECT_EQ(z.update(env), 1u);
+    const TimeSeries& out = env.at("z");
+    EXPECT_EQ(*out.index(), *env.at("a").index());
+    expect_same(out, series({1, 2, 3, 4}, {-3, 0, -3, 0}, {true, false, true, false}));
+
+    // The target now owns its bitmap and index and grows them in place.
+    const ValidityBitmap* valid = out.validity().get();
+    const TimeIndex* index = out.index().get();
+    env.at("a").append(series({5}, {1}, {true}));
+    env.at("b").append(series({5}, {2}, {false}));
+    EXPECT_EQ(z.update(env), 1u);
+    EXPECT_EQ(env.at("z").validity().get(), valid);
+    EXPECT_EQ(env.at("z").index().get(), index);
+    expect_same(env.at("z"), series({1, 2, 3, 4, 5}, {-3, 0, -3, 0, 0}, {true, false, true, false, false}));
+
+    env["b"] = series({1, 2, 3, 5}, {4, 5, 6, 1}, {true, true, true, true});
+    env["a"] = series({1, 2, 3, 4}, {1, 2, 3, 9}, {true, true, true, true});
+    z.reset();
+    EXPECT_THROW(z.update(env), EvalError);
+}
+
+TEST(StreamingReduction, FoldsOnlyAppendedRows) {
+    Env env{{"x", TimeSeries{std::vector<double>{1, 2, 3}}},
+            {"y", TimeSeries{std::vector<double>{2, 4, 7}}}};
+    StreamingReduction beta("beta = sumproduct(x, y) / sumproduct(x, x)");
+    EXPECT_EQ(beta.update(env), 3u);
+    EXPECT_EQ(beta.update(env), 0u);
+
+    for (int t = 0; t < 6; ++t) {
+        tick(env, "x", 0.5 * t);
+        tick(env, "y", 1.0 + t);
+        EXPECT_EQ(beta.update(env), 1u);
+    }
+    EXPECT_EQ(beta.recomputes(), 1u);
+
+    Env full = env;
+    execute_assignment("beta = sumproduct(x, y) / sumproduct(x, x)", full);
+    ASSERT_EQ(env.at("beta").size(), 1u);
+    EXPECT_EQ(env.at("beta")[0], full.at("beta")[0]);
+}
+
+TEST(StreamingReduction, RowLocalArgumentsAndNulls) {
+    auto series = [](std::vector<double> v, std::vector<bool> ok) {
+        return TimeSeries{std::move(v)}.with_validity(
+            std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+    };
+    Env env{{"a", series({1, 2, 3}, {true, false, true})},
+            {"b", TimeSeries{std::vector<double>{4, 5, 6}}}};
+    const char* stmt = "s = 2 * sumproduct(a - 1, b) + 1";
+    StreamingReduction s(stmt);
+    s.update(env);
+
+    env.at("a").append(series({7, 0}, {true, false}));
+    env.at("b").append(TimeSeries{std::vector<double>{2, 9}});
+    EXPECT_EQ(s.update(env), 2u);
+    EXPECT_EQ(s.recomputes(), 1u);
+
+    Env full = env;
+    execute_assignment(stmt, full);
+    EXPECT_EQ(env.at("s")[0], full.at("s")[0]);
+}
+
+TEST(StreamingReduction, RecomputesWhenHistoryIsRewritten) {
+    Env env{{"a", TimeSeries{std::vector<double>{1, 2, 3, 4, 5}}}};
+    StreamingReduction s("s = sumproduct(a, 1)");
+    s.update(env);
+    EXPECT_EQ(env.at("s")[0], 15.0);
+
+    env.at("a").mutable_values()[2] = 10; // middle row edited in place
+    tick(env, "a", 6);
+    EXPECT_EQ(s.update(env), 6u);
+    EXPECT_EQ(env.at("s")[0], 28.0);
+
+    // Same length, one unremarkable row changed.
+    env["a"] = TimeSeries{std::vector<double>{1, 2, 10, 4, 5, 7}};
+    EXPECT_EQ(s.update(env), 6u);
+    EXPECT_EQ(env.at("s")[0], 29.0);
+
+    env["a"] = TimeSeries{std::vector<double>{1, 1}}; // shorter
+    EXPECT_EQ(s.update(env), 2u);
+    EXPECT_EQ(env.at("s")[0], 2.0);
+    EXPECT_EQ(s.recomputes(), 4u);
+
+    s.reset();
+    EXPECT_EQ(s.update(env), 2u);
+}
+
+TEST(StreamingReduction, MatchesOneShotBitForBit) {
+    // Rows of mixed magnitudes, some null and some float32, arriving in
+    // uneven batches across several reduction leaves.
+    const std::size_t n = 3 * tsexpr::reduce_leaf_rows + 123;
+    std::vector<double> xv(n), yv(n);
+    std::vector<bool> ok(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        xv[i] = std::sin(double(i)) * std::pow(10.0, double(i % 13) - 6);
+        yv[i] = std::cos(double(i) * 0.37) + 1e-3 * double(i);
+        ok[i] = i % 97 != 5 && (i < 5000 || i >= 5200); // and some all-null words
+    }
+    const TimeSeries x = TimeSeries{xv}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+    const TimeSeries y = TimeSeries{yv};
+    const char* stmt = "s = sumproduct(x, float32(y)) - 3 * sumproduct(x * 0.5, 2)";
+
+    Env full{{"x", x}, {"y", y}};
+    execute_assignment(stmt, full);
+
+    for (std::size_t batch : {std::size_t{1}, std::size_t{1000}, std::size_t{4096}, std::size_t{5000}}) {
+        Env env{{"x", x.slice(0, 0).compact()}, {"y", y.slice(0, 0).compact()}};
+        StreamingReduction s(stmt);
+        for (std::size_t i = 0; i < n;) {
+            const std::size_t e = std::min(n, i + (batch == 1 ? 1 + i % 7 : batch));
+            env.at("x").append(x.slice(i, e));
+            env.at("y").append(y.slice(i, e));
+            EXPECT_EQ(s.update(env), e - i);
+            i = e;
+            Env now = env;
+            execute_assignment(stmt, now);
+            ASSERT_EQ(env.at("s")[0], now.at("s")[0]) << batch << " " << i;
+        }
+        EXPECT_EQ(s.recomputes(), 1u) << batch;
+        EXPECT_EQ(env.at("s")[0], full.at("s")[0]) << batch;
+    }
+}
+
+TEST(StreamingReduction, RejectsNonIncrementalStatements) {
+    EXPECT_THROW(StreamingReduction("s = a + b"), ParseError);
+    EXPECT_THROW(StreamingReduction("s = a * sumproduct(a, b)"), ParseError);
+    EXPECT_THROW(StreamingReduction("s = sumproduct(sumproduct(a, b), a)"), ParseError);
+    EXPECT_THROW(StreamingReduction("s = sumproduct(2, 3)"), ParseError);
+    EXPECT_NO_THROW(StreamingReduction("s = -sumproduct(float32(a), b) * 0.5"));
+}
+
+// A reader handing out `s` in chunks of the given sizes (the last repeated).
+ChunkReader chunks_of(const TimeSeries& s, std::vector<std::size_t> sizes) {
+    return [s, sizes, pos = std::size_t{0}, k = std::size_t{0}]() mutable -> std::optional<TimeSeries> {
+        if (pos == s.size()) return std::nullopt;
+        const std::size_t n = std::min(sizes[std::min(k++, sizes.size() - 1)], s.size() - pos);
+        TimeSeries out = s.slice(pos, pos + n).compact();
+        pos += n;
+        return out;
+    };
+}
+
+TEST(Chunked, ElementwiseMatchesOneShot) {
+    const char* stmt = "z = rolling_mean(a, 3) - ewma(b, 4) * rolling_max(a - b, 5) + a / 2";
+    std::vector<double> a, b;
+    for (int i = 0; i < 200; ++i) {
+        a.push_back(std::sin(0.1 * i) * 10);
+        b.push_back(i % 7 == 0 ? -i : 0.5 * i);
+    }
+    Env env{{"a", TimeSeries{a}}, {"b", TimeSeries{b}}};
+    std::vector<bool> ok(200, true);
+    ok[3] = ok[50] = ok[51] = false;
+    env["a"] = env["a"].with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)));
+
+    ChunkedEvaluation chunked(stmt, 16);
+    EXPECT_FALSE(chunked.is_reduction());
+    const ChunkSource source = [&](const std::string& name) {
+        return name == "a" ? chunks_of(env.at("a"), {7, 30, 1}) : chunks_of(env.at("b"), {64});
+    };
+    std::vector<TimeSeries> out;
+    EXPECT_EQ(chunked.run(source, [&](TimeSeries rows) {
+        EXPECT_LE(rows.size(), 16u);
+        out.push_back(std::move(rows));
+    }), 200u);
+
+    execute_assignment(stmt, env);
+    const TimeSeries& want = env.at("z");
+    std::size_t row = 0;
+    for (const TimeSeries& piece : out) {
+        for (std::size_t i = 0; i < piece.size(); ++i, ++row) {
+            ASSERT_EQ(piece.is_valid(i), want.is_valid(row)) << row;
+            if (want.is_valid(row)) {
+                ASSERT_NEAR(piece[i], want[row], 1e-12) << row;
+            }
+        }
+    }
+    EXPECT_EQ(row, 200u);
+
+    // Running again starts over.
+    std::size_t rows = 0;
+    chunked.run(source, [&](TimeSeries r) { rows += r.size(); });
+    EXPECT_EQ(rows, 200u);
+}
+
+TEST(Chunked, ReductionsMatchOneShotBitForBit) {
+    const std::size_t n = 2 * tsexpr::reduce_leaf_rows + 300;
+    std::vector<double> x, y;
+    std::vector<bool> ok;
+    for (std::size_t i = 0; i < n; ++i) {
+        x.push_back(0.01 * double(i) * std::pow(10.0, double(i % 11) - 5));
+        y.push_back(3.0 - 0.002 * double(i));
+        ok.push_back(i % 89 != 1);
+    }
+    Env env{{"x", TimeSeries{x}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(ok)))},
+            {"y", TimeSeries{y}}};
+    const char* stmt = "beta = sumproduct(x, y - 1) / sumproduct(x, x)";
+    Env full = env;
+    execute_assignment(stmt, full);
+
+    for (std::size_t size : {std::size_t{1}, std::size_t{7}, std::size_t{4096}}) {
+        ChunkedEvaluation chunked(stmt, 5000);
+        EXPECT_TRUE(chunked.is_reduction());
+        std::vector<TimeSeries> out;
+        EXPECT_EQ(chunked.run([&](const std::string& name) { return chunks_of(env.at(name), {size}); },
+                              [&](TimeSeries r) { out.push_back(std::move(r)); }),
+                  n);
+        ASSERT_EQ(out.size(), 1u);
+        EXPECT_EQ(out[0][0], full.at("beta")[0]) << size;
+    }
+}
+
+TEST(Chunked, TimestampedChunksKeepTheirIndex) {
+    const TimeSeries a{TimeIndex{1, 2, 3, 5, 8}, std::vector<double>{1, 2, 3, 4, 5}};
+    const TimeSeries b{TimeIndex{1, 2, 3, 5, 8}, std::vector<double>{5, 4, 3, 2, 1}};
+    ChunkedEvaluation chunked("z = a * b");
+    std::vector<std::int64_t> stamps;
+    std::vector<double> values;
+    chunked.run([&](const std::string& name) { return chunks_of(name == "a" ? a : b, {2, 3}); },
+                [&](TimeSeries r) {
+                    ASSERT_TRUE(r.has_index());
+                    for (std::size_t i = 0; i < r.size(); ++i) {
+                        stamps.push_back((*r.index())[i]);
+                        values.push_back(r[i]);
+                    }
+                });
+    EXPECT_EQ(stamps, (std::vector<std::int64_t>{1, 2, 3, 5, 8}));
+    EXPECT_EQ(values, (std::vector<double>{5, 8, 9, 8, 5}));
+
+    const TimeSeries late{TimeIndex{1, 2, 4, 5, 8}, std::vector<double>{5, 4, 3, 2, 1}};
+    EXPECT_THROW(chunked.run([&](const std::string& name) { return chunks_of(name == "a" ? a : late, {5}); },
+                             [](TimeSeries) {}),
+                 EvalError);
+}
+
+TEST(Chunked, InputsMustEndTogether) {
+    const TimeSeries a{std::vector<double>{1, 2, 3}};
+    const TimeSeries b{std::vector<double>{1, 2}};
+    ChunkedEvaluation chunked("z = a + b");
+    EXPECT_THROW(chunked.run([&](const std::string& name) { return chunks_of(name == "a" ? a : b, {1}); },
+                             [](TimeSeries) {}),
+                 EvalError);
+    EXPECT_THROW(ChunkedEvaluation("z = a + b", 0), std::invalid_argument);
+    EXPECT_THROW(ChunkedEvaluation("z = lag(a, 1)"), ParseError);
+}
+
+} // namespace
@@ -0,0 +1,452 @@
+#include <gtest/gtest.h>
+#include <tsexpr/expr.hpp>
+#include <tsexpr/reduce.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+using ts::expr::Env;
+using ts::expr::TimeSeries;
+using ts::expr::JoinKind;
+using ts::expr::AlignmentPlan;
+
+TEST(TimeSeries, CopySharesBufferUntilWritten) {
+    TimeSeries a{std::vector<double>{1, 2, 3}};
+    TimeSeries b = a;
+    EXPECT_TRUE(b.shares_buffer_with(a));
+
+    b.mutable_values()[0] = 42.0;
+    EXPECT_FALSE(b.shares_buffer_with(a));
+    EXPECT_DOUBLE_EQ(a[0], 1.0);
+    EXPECT_DOUBLE_EQ(b[0], 42.0);
+}
+
+TEST(TimeSeries, AppendGrowsInPlaceAndKeepsTheGeneration) {
+    using ts::expr::TimeIndex;
+    using ts::expr::ValidityBitmap;
+    TimeSeries a{TimeIndex{1, 2}, std::vector<double>{1, 2}};
+    const std::uint64_t g = a.generation();
+    EXPECT_EQ(TimeSeries(a).generation(), g);
+
+    a.append(TimeSeries{TimeIndex{3, 4}, std::vector<double>{3, 4}}.with_validity(
+        std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools({false, true}))));
+    ASSERT_EQ(a.size(), 4u);
+    EXPECT_EQ(*a.index(), (TimeIndex{1, 2, 3, 4}));
+    EXPECT_EQ(a.null_count(), 1u);
+    EXPECT_FALSE(a.is_valid(2));
+    EXPECT_EQ(a.generation(), g);
+
+    // Once the series holds its own index and bitmap, they grow in place.
+    const auto* index = a.index().get();
+    const auto* valid = a.validity().get();
+    for (std::int64_t t = 5; t < 200; ++t) a.append(TimeSeries{TimeIndex{t}, std::vector<double>{double(t)}});
+    EXPECT_EQ(a.index().get(), index);
+    EXPECT_EQ(a.validity().get(), valid);
+    EXPECT_EQ(a.size(), 199u);
+    EXPECT_EQ(a[198], 199.0);
+    EXPECT_EQ(a.generation(), g);
+
+    // Appending to a shared buffer forks: the other owner keeps g.
+    TimeSeries b = a;
+    a.append(TimeSeries{TimeIndex{300}, std::vector<double>{0}});
+    EXPECT_NE(a.generation(), g);
+    EXPECT_EQ(b.generation(), g);
+    EXPECT_EQ(b.size(), 199u);
+    EXPECT_EQ(b.index()->size(), 199u);
+
+    // Bad rows leave the series alone.
+    EXPECT_THROW(b.append(TimeSeries{TimeIndex{199}, std::vector<double>{0}}), std::runtime_error);
+    EXPECT_THROW(b.append(TimeSeries{std::vector<double>{0}}), std::runtime_error);
+    EXPECT_THROW(b.append(TimeSeries{TimeIndex{400}, std::vector<float>{0}}), std::runtime_error);
+    EXPECT_EQ(b.size(), 199u);
+    EXPECT_EQ(b.generation(), g);
+
+    // Any other change starts a new generation.
+    b.mutable_values()[0] = 5;
+    EXPECT_NE(b.generation(), g);
+    EXPECT_NE(a.with_validity(nullptr).generation(), a.generation());
+    EXPECT_NE(a.slice(0, 1).generation(), a.generation());
+}
+
+TEST(TimeSeries, EnvLoadAndStoreDoNotCopy) {
+    Env env;
+    env["a"] = TimeSeries{std::vector<double>{1, 2, 3}};
+
+    ts::expr::execute_assignment("z = a", env);
+    EXPECT_TRUE(env["z"].shares_buffer_with(env["a"]));
+
+    ts::expr::execute_assignment("w = a * 2 + a", env);
+    const auto& w = env["w"].values();
+    ASSERT_EQ(w.size(), 3u);
+    EXPECT_DOUBLE_EQ(w[0], 3.0);
+    EXPECT_DOUBLE_EQ(w[2], 9.0);
+}
+
+TEST(TimeSeries, StubSumproduct) {
+    Env env;
+    env["a"] = TimeSeries{std::vector<double>{1, 2, 3}};
+    env["b"] = TimeSeries{std::vector<double>{10, 20, 30}};
+
+    ts::expr::execute_assignment("s = sumproduct(a, b)", env);
+    ASSERT_EQ(env["s"].size(), 1u);
+    EXPECT_DOUBLE_EQ(env["s"][0], 140.0);
+}
+
+TEST(TimeSeries, Float32PromotionRules) {
+    std::vector<float> xf(13);
+    std::vector<double> yd(13);
+    for (std::size_t i = 0; i < xf.size(); ++i) { xf[i] = float(i) + 0.5f; yd[i] = double(i); }
+    TimeSeries x{xf};
+    TimeSeries y{yd};
+
+    TimeSeries xx = x + x;
+    EXPECT_EQ(xx.dtype(), ts::expr::DType::F32);
+    EXPECT_FLOAT_EQ(xx.values_f32()[12], 25.0f);
+
+    TimeSeries xy = x * y;
+    EXPECT_EQ(xy.dtype(), ts::expr::DType::F64);
+    EXPECT_DOUBLE_EQ(xy[12], 12.5 * 12.0);
+
+    TimeSeries xs = 1.0 - x;
+    EXPECT_EQ(xs.dtype(), ts::expr::DType::F32);
+    EXPECT_FLOAT_EQ(xs.values_f32()[3], -2.5f);
+}
+
+TEST(TimeSeries, Float32SumproductAccumulatesInDouble) {
+    // 0.1f summed 1e6 times drifts visibly in a float accumulator.
+    std::vector<float> ones(1000000, 1.0f);
+    std::vector<float> tenths(1000000, 0.1f);
+    double expect = 1000000.0 * double(0.1f);
+    EXPECT_NEAR(ts::expr::sumproduct(TimeSeries{ones}, TimeSeries{tenths}), expect, 1e-6);
+}
+
+TEST(TimeSeries, StorageTypeSelectablePerVariable) {
+    Env env;
+    env["a"] = TimeSeries{std::vector<double>{1, 2, 3}};
+    ts::expr::execute_assignment("a32 = float32(a)", env);
+    EXPECT_EQ(env["a32"].dtype(), ts::expr::DType::F32);
+    EXPECT_EQ(env["a"].dtype(), ts::expr::DType::F64);
+
+    ts::expr::execute_assignment("z = a32 * 2", env);
+    EXPECT_EQ(env["z"].dtype(), ts::expr::DType::F32);
+    EXPECT_FLOAT_EQ(env["z"].values_f32()[2], 6.0f);
+}
+
+TEST(Alignment, InnerOuterAsOf) {
+    auto a = std::make_shared<const ts::expr::TimeIndex>(ts::expr::TimeIndex{1, 3, 5, 7});
+    auto b = std::make_shared<const ts::expr::TimeIndex>(ts::expr::TimeIndex{2, 3, 7, 8});
+    constexpr auto npos = AlignmentPlan::npos;
+
+    auto inner = ts::expr::build_alignment(a, b, JoinKind::Inner);
+    EXPECT_EQ(*inner->index, (ts::expr::TimeIndex{3, 7}));
+    EXPECT_EQ(inner->left, (std::vector<std::size_t>{1, 3}));
+    EXPECT_EQ(inner->right, (std::vector<std::size_t>{1, 2}));
+
+    auto outer = ts::expr::build_alignment(a, b, JoinKind::Outer);
+    EXPECT_EQ(*outer->index, (ts::expr::TimeIndex{1, 2, 3, 5, 7, 8}));
+    EXPECT_EQ(outer->left, (std::vector<std::size_t>{0, npos, 1, 2, 3, npos}));
+    EXPECT_EQ(outer->right, (std::vector<std::size_t>{npos, 0, 1, npos, 2, 3}));
+
+    auto asof = ts::expr::build_alignment(a, b, JoinKind::AsOf);
+    EXPECT_TRUE(asof->left_identity);
+    EXPECT_EQ(asof->index, a);
+    EXPECT_EQ(asof->right, (std::vector<std::size_t>{npos, 1, 1, 2}));
+}
+
+TEST(Alignment, GallopingMatchesNaiveJoin) {
+    std::mt19937 rng(7);
+    auto make = [&](int n, int gap) {
+        ts::expr::TimeIndex v;
+        std::int64_t t = 0;
+        for (int i = 0; i < n; ++i) v.push_back(t += 1 + std::int64_t(rng() % gap));
+        return std::make_shared<const ts::expr::TimeIndex>(std::move(v));
+    };
+    auto a = make(5000, 3);
+    auto b = make(300, 50); // sparse side forces long gallops on `a`
+
+    auto plan = ts::expr::build_alignment(a, b, JoinKind::Inner);
+    std::vector<std::int64_t> naive;
+    for (auto t : *a)
+        if (std::binary_search(b->begin(), b->end(), t)) naive.push_back(t);
+    EXPECT_EQ(*plan->index, naive);
+    for (std::size_t k = 0; k < plan->size(); ++k) {
+        EXPECT_EQ((*a)[plan->left[k]], (*plan->index)[k]);
+        EXPECT_EQ((*b)[plan->right[k]], (*plan->index)[k]);
+    }
+}
+
+TEST(Alignment, OpsJoinOnTimestampsAndCachePlans) {
+    ts::expr::alignment_cache().clear();
+    TimeSeries a{ts::expr::TimeIndex{10, 20, 30, 40}, std::vector<double>{1, 2, 3, 4}};
+    TimeSeries b{ts::expr::TimeIndex{20, 40, 50}, std::vector<double>{10, 20, 30}};
+
+    TimeSeries c = a + b;
+    ASSERT_TRUE(c.has_index());
+    EXPECT_EQ(*c.index(), (ts::expr::TimeIndex{20, 40}));
+    EXPECT_DOUBLE_EQ(c[0], 12.0);
+    EXPECT_DOUBLE_EQ(c[1], 24.0);
+
+    TimeSeries d = a * b;
+    EXPECT_EQ(d.index(), c.index()); // same cached plan, same index buffer
+    auto st = ts::expr::alignment_cache().stats();
+    EXPECT_EQ(st.misses, 1u);
+    EXPECT_EQ(st.hits, 1u);
+
+    // Same index buffer: no join at all.
+    TimeSeries e = c - d;
+    EXPECT_EQ(ts::expr::alignment_cache().stats().misses, 1u);
+    EXPECT_DOUBLE_EQ(e[1], 24.0 - 80.0);
+
+    EXPECT_DOUBLE_EQ(ts::expr::sumproduct(a, b), 2 * 10 + 4 * 20);
+
+    auto [oa, ob] = ts::expr::align(a, b, JoinKind::Outer);
+    EXPECT_EQ(oa.size(), 5u);
+    EXPECT_TRUE(std::isnan(oa[4]));
+    EXPECT_TRUE(std::isnan(ob[0]));
+}
+
+TEST(Alignment, CachedPlansFollowIndexLength) {
+    ts::expr::alignment_cache().clear();
+    auto a = std::make_shared<ts::expr::TimeIndex>(ts::expr::TimeIndex{1, 2, 3});
+    auto b = std::make_shared<ts::expr::TimeIndex>(ts::expr::TimeIndex{2, 3});
+    EXPECT_EQ(ts::expr::alignment_cache().get(a, b, JoinKind::Inner)->size(), 2u);
+
+    // Same buffers, grown: the old plan must not be reused.
+    a->push_back(4);
+    b->push_back(4);
+    EXPECT_EQ(ts::expr::alignment_cache().get(a, b, JoinKind::Inner)->size(), 3u);
+    EXPECT_EQ(ts::expr::alignment_cache().stats().misses, 2u);
+}
+
+TEST(Validity, ElementwiseAndsBitmaps) {
+    using ts::expr::ValidityBitmap;
+    TimeSeries a = TimeSeries{std::vector<double>{1, 2, 3, 4}}
+        .with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools({true, false, true, true})));
+    TimeSeries b = TimeSeries{std::vector<double>{1, 1, 1, 1}}
+        .with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools({true, true, true, false})));
+
+    TimeSeries c = a + b;
+    EXPECT_EQ(c.null_count(), 2u);
+    EXPECT_TRUE(c.is_valid(0));
+    EXPECT_FALSE(c.is_valid(1));
+    EXPECT_FALSE(c.is_valid(3));
+
+    TimeSeries d = a * 2.0;
+    EXPECT_EQ(d.validity(), a.validity()); // shared, not recomputed
+
+    for (ts::expr::DType t : {ts::expr::DType::F32, ts::expr::DType::F64}) {
+        const TimeSeries cast = a.astype(ts::expr::DType::F32).astype(t);
+        EXPECT_EQ(cast.validity(), a.validity());
+        EXPECT_EQ(ts::expr::sumproduct(cast, 1.0), 8.0);
+    }
+
+    // An all-set bitmap is dropped so the no-nulls fast path is a pointer test.
+    TimeSeries e = a.with_validity(std::make_shared<ValidityBitmap>(4));
+    EXPECT_FALSE(e.has_validity());
+}
+
+TEST(Validity, MaskedSumproductSkipsNullRows) {
+    std::mt19937 rng(11);
+    const std::size_t n = 1000; // not a multiple of 64 or of any SIMD width
+    std::vector<double> x(n), y(n);
+    std::vector<bool> vx(n), vy(n);
+    double expect = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        x[i] = double(rng() % 100) / 7.0;
+        y[i] = double(rng() % 100) / 3.0;
+        // long valid runs exercise the dense per-word path too
+        vx[i] = (i / 128) % 3 != 1 || rng() % 2;
+        vy[i] = rng() % 8 != 0;
+        if (vx[i] && vy[i]) expect += x[i] * y[i];
+        else if (!vx[i]) x[i] = std::nan("");
+    }
+    using ts::expr::ValidityBitmap;
+    TimeSeries a = TimeSeries{x}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(vx)));
+    TimeSeries b = TimeSeries{y}.with_validity(std::make_shared<ValidityBitmap>(ValidityBitmap::from_bools(vy)));
+    EXPECT_NEAR(ts::expr::sumproduct(a, b), expect, 1e-9 * std::abs(expect));
+
+    double expect_s = 0.0;
+    for (std::size_t i = 0; i < n; ++i)
+        if (vx[i]) expect_s += x[i] * 2.0;
+    EXPECT_NEAR(ts::expr::sumproduct(a, 2.0), expect_s, 1e-9 * std::abs(expect_s));
+}
+
+TEST(Validity, BitmapResizeKeepsBitsAndClearsTheTail) {
+    using ts::expr::ValidityBitmap;
+    ValidityBitmap bm = ValidityBitmap::from_bools({true, false, true});
+    bm.resize(70);
+    EXPECT_EQ(bm.size(), 70u);
+    EXPECT_EQ(bm.count(), 69u);
+    EXPECT_FALSE(bm.get(1));
+    bm.resize(130, false);
+    EXPECT_EQ(bm.count(), 69u);
+    bm.resize(2);
+    EXPECT_EQ(bm.count(), 1u);
+    bm.resize(64);
+    EXPECT_EQ(bm.count(), 63u); // bits cut off come back valid
+}
+
+TEST(Validity, AllValidLeafSumsLikeDense) {
+    // The first leaf is zeros with one null; the second leaf's rows are all
+    // valid but end in a partial bitmap word. It must sum exactly like its
+    // dense slice.
+    const std::size_t leaf = tsexpr::reduce_leaf_rows;
+    for (std::size_t tail_rows : {1u, 37u, 100u, 200u}) {
+        const std::size_t n = leaf + tail_rows;
+        std::mt19937 rng{unsigned(tail_rows)};
+        std::uniform_real_distribution<double> u{-1.0, 1.0};
+        std::vector<double> x(n, 0.0);
+        for (std::size_t i = leaf; i < n; ++i) x[i] = std::ldexp(u(rng), int(rng() % 40));
+        std::vector<bool> ok(n, true);
+        ok[0] = false;
+        const TimeSeries a = TimeSeries{x}.with_validity(
+            std::make_shared<ts::expr::ValidityBitmap>(ts::expr::ValidityBitmap::from_bools(ok)));
+        const TimeSeries tail = a.slice(leaf, n);
+        EXPECT_FALSE(tail.has_validity());
+        EXPECT_EQ(ts::expr::sumproduct(a, 1.0), ts::expr::sumproduct(tail, 1.0)) << tail_rows;
+    }
+}
+
+TEST(Validity, OuterJoinMarksMissingRowsNull) {
+    TimeSeries a{ts::expr::TimeIndex{1, 2, 3}, std::vector<double>{1, 2, 3}};
+    TimeSeries b{ts::expr::TimeIndex{2, 3, 4}, std::vector<double>{10, 20, 30}};
+    auto [oa, ob] = ts::expr::align(a, b, JoinKind::Outer);
+    EXPECT_EQ(oa.null_count(), 1u);
+    EXPECT_FALSE(oa.is_valid(3));
+    EXPECT_FALSE(ob.is_valid(0));
+    EXPECT_DOUBLE_EQ(ts::expr::sumproduct(oa, ob), 2 * 10 + 3 * 20);
+}
+
+TEST(Views, SliceSharesTheBufferUntilWritten) {
+    TimeSeries a{std::vector<double>{1, 2, 3, 4, 5}};
+    TimeSeries v = a.slice(1, 4);
+    EXPECT_TRUE(v.is_view());
+    EXPECT_TRUE(v.shares_buffer_with(a));
+    EXPECT_EQ(v.size(), 3u);
+    EXPECT_EQ(v.f64(), a.f64() + 1);
+    EXPECT_EQ(v.origin(), 1);
+    EXPECT_THROW(v.values(), std::logic_error);
+
+    const TimeSeries c = v.compact();
+    EXPECT_FALSE(c.is_view());
+    EXPECT_EQ(c.values(), (std::vector<double>{2, 3, 4}));
+
+    v.mutable_values()[0] = 42; // detaches with just its own rows
+    EXPECT_FALSE(v.is_view());
+    EXPECT_EQ(v.values(), (std::vector<double>{42, 3, 4}));
+    EXPECT_DOUBLE_EQ(a[1], 2.0);
+}
+
+TEST(Views, BitmapSliceAtAnyOffset) {
+    using ts::expr::ValidityBitmap;
+    std::mt19937 rng(3);
+    std::vector<bool> bits(300);
+    for (std::size_t i = 0; i < bits.size(); ++i) bits[i] = rng() % 3 != 0;
+    const ValidityBitmap bm = ValidityBitmap::from_bools(bits);
+    for (std::size_t b : {0u, 1u, 63u, 64u, 65u, 130u}) {
+        for (std::size_t e : {b, b + 1, b + 64, std::size_t{300}}) {
+            if (e > 300) continue;
+            const ValidityBitmap s = bm.slice(b, e);
+            ASSERT_EQ(s.size(), e - b);
+            std::size_t expect = 0;
+            for (std::size_t i = b; i < e; ++i) {
+                ASSERT_EQ(s.get(i - b), bits[i]) << b << " " << e;
+                expect += bits[i];
+            }
+            EXPECT_EQ(s.count(), expect); // bits past the end stay clear
+        }
+    }
+}
+
+TEST(Views, LagIsAViewAndDiffMatchesIt) {
+    Env env{{"x", TimeSeries{std::vector<double>{10, 11, 13, 12, 15}}}};
+    ts::expr::execute_assignment("l = lag(x, 2)", env);
+    const TimeSeries& l = env.at("l");
+    EXPECT_TRUE(l.shares_buffer_with(env.at("x")));
+    EXPECT_EQ(l.size(), 3u);
+    EXPECT_EQ(l.origin(), 0);
+    EXPECT_EQ(ts::expr::lag(env.at("x"), 2).origin(), 2);
+    EXPECT_TRUE(ts::expr::lag(env.at("x"), 2).shifted());
+
+    ts::expr::execute_assignment("d1 = x - lag(x, 1)", env);
+    ts::expr::execute_assignment("d2 = diff(x)", env);
+    ts::expr::execute_assignment("p = pct_change(x)", env);
+    ts::expr::execute_assignment("e = x - lag(x, -1)", env); // lead
+    const TimeSeries& d1 = env.at("d1");
+    const TimeSeries& d2 = env.at("d2");
+    ASSERT_EQ(d1.size(), 4u);
+    ASSERT_EQ(d2.size(), 4u);
+    EXPECT_EQ(d1.origin(), 0); // stored results drop the shift
+    EXPECT_FALSE(d2.shifted());
+    for (std::size_t i = 0; i < 4; ++i) {
+        EXPECT_DOUBLE_EQ(d1[i], d2[i]);
+        EXPECT_DOUBLE_EQ(env.at("p")[i], env.at("x")[i + 1] / env.at("x")[i] - 1);
+        EXPECT_DOUBLE_EQ(env.at("e")[i], -d2[i]);
+    }
+    EXPECT_EQ(env.at("e").origin(), 0);
+
+    // Shifted results keep lining up by position within an expression.
+    ts::expr::execute_assignment("z = diff(x) + lag(x, 2)", env);
+    ASSERT_EQ(env.at("z").size(), 3u);
+    EXPECT_DOUBLE_EQ(env.at("z")[0], (13 - 11) + 10);
+    ts::expr::execute_assignment("z = (x - lag(x, 1)) * 2 + x", env);
+    ASSERT_EQ(env.at("z").size(), 4u);
+    EXPECT_DOUBLE_EQ(env.at("z")[0], (11 - 10) * 2 + 11);
+    EXPECT_THROW(ts::expr::execute_assignment("z = lag(x, 0.5)", env), ts::expr::EvalError);
+}
+
+TEST(Views, StoredLagsFollowTheSameSizeRule) {
+    Env env{{"a", TimeSeries{std::vector<double>{1, 2, 3, 4, 5}}},
+            {"c", TimeSeries{std::vector<double>{10, 20, 30, 40}}}};
+    ts::expr::execute_assignment("z = lag(a, 1)", env);
+    EXPECT_EQ(env.at("z").origin(), 0);
+    ts::expr::execute_assignment("w = z + c", env);
+    ASSERT_EQ(env.at("w").size(), 4u);
+    EXPECT_DOUBLE_EQ(env.at("w")[0], 1 + 10);
+    EXPECT_DOUBLE_EQ(ts::expr::sumproduct(env.at("z"), env.at("c")), 300.0);
+
+    // Unshifted series of different sizes never line up by position.
+    EXPECT_THROW(ts::expr::execute_assignment("w = a + c", env), std::runtime_error);
+    EXPECT_THROW(ts::expr::execute_assignment("w = z + a", env), std::runtime_error);
+    const TimeSeries& a = env.at("a");
+    EXPECT_THROW(a.slice(0, 4) + a, std::runtime_error);
+}
+
+TEST(Views, TimestampedLagWithNulls) {
+    using ts::expr::ValidityBitmap;
+    TimeSeries x = TimeSeries{ts::expr::TimeIndex{100, 200, 300, 400, 500}, std::vector<float>{1, 2, 4, 8, 16}}
+                       .with_validity(std::make_shared<ValidityBitmap>(
+                           ValidityBitmap::from_bools({true, true, false, true, true})));
+    const TimeSeries l = ts::expr::lag(x, 1);
+    EXPECT_TRUE(l.shares_buffer_with(x));
+    EXPECT_EQ(*l.index(), (ts::expr::TimeIndex{200, 300, 400, 500}));
+    EXPECT_EQ(l.origin(), x.origin());
+    EXPECT_FALSE(l.is_valid(2));
+
+    const TimeSeries lead = ts::expr::lag(x, -2);
+    EXPECT_TRUE(lead.shares_buffer_with(x));
+    EXPECT_EQ(*lead.index(), (ts::expr::TimeIndex{100, 200, 300}));
+    EXPECT_EQ(lead[0], 4.0);
+    EXPECT_FALSE(lead.is_valid(0));
+
+    const TimeSeries joined = x - l;
+    const TimeSeries fused = ts::expr::diff(x);
+    EXPECT_EQ(fused.dtype(), ts::expr::DType::F32);
+    ASSERT_EQ(joined.size(), fused.size());
+    EXPECT_EQ(*fused.index(), *l.index());
+    for (std::size_t i = 0; i < fused.size(); ++i) {
+        ASSERT_EQ(joined.is_valid(i), fused.is_valid(i)) << i;
+        if (fused.is_valid(i)) {
+            EXPECT_EQ(joined[i], fused[i]) << i;
+        }
+    }
+    EXPECT_FALSE(fused.is_valid(1));
+    EXPECT_FALSE(fused.is_valid(2));
+    EXPECT_DOUBLE_EQ(fused[3], 8.0);
+}
+
+} // namespace